@@ -0,0 +1,89 @@
+/*
+ * thp-shm:
+ *
+ * Test that a Sys V shared memory segment is mapped with transparent huge
+ * pages.  The segment is created without SHM_HUGETLB, so it lives on the
+ * internal tmpfs mount, whose huge= policy must allow huge pages:
+ *
+ * echo always > /sys/kernel/mm/transparent_hugepage/shmem_enabled
+ *
+ * Every huge pmd mapped at fault time bumps thp_file_mapped in
+ * /proc/vmstat.  Writing to each huge page sized extent of the segment
+ * must therefore raise it by at least the number of extents.
+ *
+ * The huge page size is that of x86: 2MB.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+
+#define HPAGE_SIZE (2UL*1024*1024)
+#define NR_HPAGES 8
+#define LENGTH (NR_HPAGES * HPAGE_SIZE)
+
+static long read_thp_file_mapped(void)
+{
+	char name[64];
+	long val;
+	FILE *f;
+
+	f = fopen("/proc/vmstat", "r");
+	if (!f) {
+		perror("/proc/vmstat");
+		exit(1);
+	}
+	while (fscanf(f, "%63s %ld", name, &val) == 2) {
+		if (!strcmp(name, "thp_file_mapped")) {
+			fclose(f);
+			return val;
+		}
+	}
+	fclose(f);
+	fprintf(stderr, "thp_file_mapped not in /proc/vmstat\n");
+	exit(1);
+}
+
+int main(void)
+{
+	int shmid;
+	unsigned long i;
+	long before, after;
+	char *shmaddr;
+
+	if ((shmid = shmget(IPC_PRIVATE, LENGTH,
+			    IPC_CREAT | SHM_R | SHM_W)) < 0) {
+		perror("shmget");
+		exit(1);
+	}
+
+	shmaddr = shmat(shmid, NULL, 0);
+	if (shmaddr == (char *)-1) {
+		perror("Shared memory attach failure");
+		shmctl(shmid, IPC_RMID, NULL);
+		exit(2);
+	}
+	printf("shmaddr: %p\n", shmaddr);
+	if ((unsigned long)shmaddr & (HPAGE_SIZE - 1))
+		printf("segment is not huge page aligned\n");
+
+	before = read_thp_file_mapped();
+	for (i = 0; i < LENGTH; i += HPAGE_SIZE)
+		shmaddr[i] = 1;
+	after = read_thp_file_mapped();
+
+	shmdt((const void *)shmaddr);
+	shmctl(shmid, IPC_RMID, NULL);
+
+	printf("thp_file_mapped: +%ld for %d huge pages\n",
+	       after - before, NR_HPAGES);
+	if (after - before < NR_HPAGES) {
+		printf("FAIL: segment not mapped with huge pmds\n");
+		return 3;
+	}
+	printf("PASS\n");
+	return 0;
+}
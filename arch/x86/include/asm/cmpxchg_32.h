@@ -280,4 +280,35 @@ static inline unsigned long cmpxchg_386(volatile void *ptr, unsigned long old,
 
 #endif
 
+/*
+ * Compare and exchange two adjacent, 8 byte aligned words at once:
+ * returns true, and stores @n1 and @n2, only if @p1 held @o1 and @p2
+ * held @o2.  The 486 lacks cmpxchg8b, so check
+ * system_has_cmpxchg_double() first.
+ */
+#define __cmpxchg_double(pfx, p1, p2, o1, o2, n1, n2)			\
+({									\
+	bool __ret;							\
+	__typeof__(*(p1)) __old1 = (o1), __new1 = (n1);			\
+	__typeof__(*(p2)) __old2 = (o2), __new2 = (n2);			\
+	BUILD_BUG_ON(sizeof(*(p1)) != 4);				\
+	BUILD_BUG_ON(sizeof(*(p2)) != 4);				\
+	VM_BUG_ON((unsigned long)(p1) % 8);				\
+	VM_BUG_ON((unsigned long)((p1) + 1) != (unsigned long)(p2));	\
+	asm volatile(pfx "cmpxchg8b %2; sete %0"			\
+		     : "=a" (__ret), "+d" (__old2),			\
+		       "+m" (*(p1)), "+m" (*(p2))			\
+		     : "a" (__old1), "b" (__new1), "c" (__new2)		\
+		     : "memory");					\
+	__ret;								\
+})
+
+#define cmpxchg_double(p1, p2, o1, o2, n1, n2)				\
+	__cmpxchg_double(LOCK_PREFIX, p1, p2, o1, o2, n1, n2)
+
+#define cmpxchg_double_local(p1, p2, o1, o2, n1, n2)			\
+	__cmpxchg_double(, p1, p2, o1, o2, n1, n2)
+
+#define system_has_cmpxchg_double() cpu_has_cx8
+
 #endif /* _ASM_X86_CMPXCHG_32_H */
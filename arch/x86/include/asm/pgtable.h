@@ -102,6 +102,11 @@ static inline int pmd_young(pmd_t pmd)
 	return pmd_flags(pmd) & _PAGE_ACCESSED;
 }
 
+static inline int pmd_dirty(pmd_t pmd)
+{
+	return pmd_flags(pmd) & _PAGE_DIRTY;
+}
+
 static inline int pte_write(pte_t pte)
 {
 	return pte_flags(pte) & _PAGE_RW;
@@ -350,6 +355,8 @@ static inline pgprot_t pgprot_modify(pgprot_t oldprot, pgprot_t newprot)
 }
 
 #define pte_pgprot(x) __pgprot(pte_flags(x) & PTE_FLAGS_MASK)
+/* the protection of a huge pmd, as for the ptes it is split into */
+#define pmd_pgprot(x) __pgprot(pmd_flags(x) & ~(_PAGE_PSE | _PAGE_SPLITTING))
 
 #define canon_pgprot(p) __pgprot(massage_pgprot(p))
 
@@ -0,0 +1,26 @@
+#ifndef _ASM_X86_QSPINLOCK_H
+#define _ASM_X86_QSPINLOCK_H
+
+#include <asm-generic/qspinlock_types.h>
+
+#if !defined(CONFIG_X86_OOSTORE) && !defined(CONFIG_X86_PPRO_FENCE)
+/*
+ * Loads are not reordered with other loads, nor stores with older loads
+ * or stores, so handing the lock over only needs the compiler to keep
+ * the critical section in place, and unlock is a plain store to the
+ * locked byte.
+ */
+#define queued_spin_acquire_barrier()	barrier()
+#define queued_spin_release_barrier()	barrier()
+
+#define	queued_spin_unlock queued_spin_unlock
+static inline void queued_spin_unlock(struct qspinlock *lock)
+{
+	barrier();
+	ACCESS_ONCE(*(u8 *)&lock->val) = 0;
+}
+#endif
+
+#include <asm-generic/qspinlock.h>
+
+#endif /* _ASM_X86_QSPINLOCK_H */
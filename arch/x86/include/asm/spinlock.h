@@ -13,8 +13,8 @@
  * Simple spin lock operations.  There are two variants, one clears IRQ's
  * on the local processor, one does not.
  *
- * These are fair FIFO ticket locks, which are currently limited to 256
- * CPUs.
+ * These are fair FIFO ticket locks, or with CONFIG_QUEUED_SPINLOCKS
+ * queued spinlocks, see kernel/qspinlock.c.
  *
  * (the type definitions are in asm/spinlock_types.h)
  */
@@ -38,6 +38,10 @@
 # define UNLOCK_LOCK_PREFIX
 #endif
 
+#ifdef CONFIG_QUEUED_SPINLOCKS
+#include <asm/qspinlock.h>
+#else
+
 /*
  * Ticket locks are conceptually two parts, one indicating the current head of
  * the queue, and the other indicating the current tail. The lock is acquired
@@ -179,6 +183,15 @@ static inline int arch_spin_is_locked(arch_spinlock_t *lock)
 	return __ticket_spin_is_locked(lock);
 }
 
+/*
+ * Tests a copy of the lock rather than the lock itself, for lockref.
+ */
+static __always_inline int arch_spin_value_unlocked(arch_spinlock_t lock)
+{
+	return !(((lock.slock >> TICKET_SHIFT) ^ lock.slock) &
+		 ((1 << TICKET_SHIFT) - 1));
+}
+
 static inline int arch_spin_is_contended(arch_spinlock_t *lock)
 {
 	return __ticket_spin_is_contended(lock);
@@ -208,6 +221,8 @@ static __always_inline void arch_spin_lock_flags(arch_spinlock_t *lock,
 
 #endif	/* CONFIG_PARAVIRT_SPINLOCKS */
 
+#endif	/* CONFIG_QUEUED_SPINLOCKS */
+
 static inline void arch_spin_unlock_wait(arch_spinlock_t *lock)
 {
 	while (arch_spin_is_locked(lock))
@@ -563,10 +563,9 @@ void __cpuinit get_cpu_cap(struct cpuinfo_x86 *c)
 	if (c->cpuid_level >= 0x00000007) {
 		u32 eax, ebx, ecx, edx;
 
+		/* EAX is the highest subleaf: 0 on most CPUs with leaf 7 */
 		cpuid_count(0x00000007, 0, &eax, &ebx, &ecx, &edx);
-
-		if (eax > 0)
-			c->x86_capability[9] = ebx;
+		c->x86_capability[9] = ebx;
 	}
 
 	/* AMD-defined flags: level 0x80000001 */
@@ -0,0 +1,108 @@
+/*
+ * CRC32 and CRC32c using the PCLMULQDQ carry-less multiply instruction.
+ *
+ * Registered as one of the candidates of the boot time algorithm selection
+ * in lib/crc32.c. Short buffers and the unaligned head and tail of long
+ * ones are left to the table driven code.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation.
+ */
+
+#include <linux/crc32.h>
+#include <linux/kernel.h>
+#include <linux/types.h>
+#include <asm/cpufeature.h>
+#include <asm/i387.h>
+
+#define PCLMUL_MIN_LEN		64L	/* minimum size of buffer
+					 * for crc32_pclmul_le_16 */
+#define PCLMUL_ALIGN		16L
+#define PCLMUL_ALIGN_MASK	15L
+
+/*
+ * Folding constants of a bit-reflected polynomial P, in the layout that
+ * crc32_pclmul_le_16 loads them: R1 = x^(4*128+32) mod P,
+ * R2 = x^(4*128-32) mod P, R3 = x^(128+32) mod P, R4 = x^(128-32) mod P,
+ * R5 = x^64 mod P, all reflected and shifted left by one, then P itself and
+ * mu = x^64 / P for the final Barrett reduction.
+ */
+struct crc32_pclmul_consts {
+	u64 r1, r2;
+	u64 r3, r4;
+	u64 r5, pad;
+	u64 poly, mu;
+} __aligned(16);
+
+static const struct crc32_pclmul_consts crc32_consts = {
+	.r1	= 0x154442bd4ULL,	.r2	= 0x1c6e41596ULL,
+	.r3	= 0x1751997d0ULL,	.r4	= 0x0ccaa009eULL,
+	.r5	= 0x163cd6124ULL,
+	.poly	= 0x1db710641ULL,	.mu	= 0x1f7011641ULL,
+};
+
+static const struct crc32_pclmul_consts crc32c_consts = {
+	.r1	= 0x0740eef02ULL,	.r2	= 0x09e4addf8ULL,
+	.r3	= 0x0f20c0dfeULL,	.r4	= 0x14cd00bd6ULL,
+	.r5	= 0x0dd45aab8ULL,
+	.poly	= 0x105ec76f1ULL,	.mu	= 0x0dea713f1ULL,
+};
+
+asmlinkage u32 crc32_pclmul_le_16(unsigned char const *buf, size_t len,
+				  u32 crc, const struct crc32_pclmul_consts *k);
+
+static u32 crc32_pclmul_common(u32 crc, unsigned char const *p, size_t len,
+			       const struct crc32_pclmul_consts *k,
+			       u32 (*fallback)(u32, unsigned char const *,
+					       size_t))
+{
+	size_t prealign, iquotient, iremainder;
+
+	if (len < PCLMUL_MIN_LEN + PCLMUL_ALIGN_MASK || !irq_fpu_usable())
+		return fallback(crc, p, len);
+
+	if ((long)p & PCLMUL_ALIGN_MASK) {
+		/* align p to 16 byte */
+		prealign = PCLMUL_ALIGN - ((long)p & PCLMUL_ALIGN_MASK);
+
+		crc = fallback(crc, p, prealign);
+		len -= prealign;
+		p += prealign;
+	}
+	iquotient = len & ~PCLMUL_ALIGN_MASK;
+	iremainder = len & PCLMUL_ALIGN_MASK;
+
+	kernel_fpu_begin();
+	crc = crc32_pclmul_le_16(p, iquotient, crc, k);
+	kernel_fpu_end();
+
+	if (iremainder)
+		crc = fallback(crc, p + iquotient, iremainder);
+
+	return crc;
+}
+
+static u32 crc32_pclmul_le(u32 crc, unsigned char const *p, size_t len)
+{
+	return crc32_pclmul_common(crc, p, len, &crc32_consts,
+				   crc32_le_generic);
+}
+
+static u32 crc32c_pclmul_le(u32 crc, unsigned char const *p, size_t len)
+{
+	return crc32_pclmul_common(crc, p, len, &crc32c_consts,
+				   __crc32c_le_generic);
+}
+
+static int crc32_pclmul_valid(void)
+{
+	return cpu_has_pclmulqdq;
+}
+
+const struct crc32_calls crc32_pclmul = {
+	.crc32_le	= crc32_pclmul_le,
+	.crc32c_le	= crc32c_pclmul_le,
+	.valid		= crc32_pclmul_valid,
+	.name		= "pclmul",
+};
@@ -0,0 +1,88 @@
+/*
+ * CPU to hardware queue mapping for the multi-queue block layer.
+ */
+#include <linux/kernel.h>
+#include <linux/threads.h>
+#include <linux/module.h>
+#include <linux/mm.h>
+#include <linux/smp.h>
+#include <linux/cpu.h>
+#include <linux/slab.h>
+#include <linux/topology.h>
+#include <linux/blk-mq.h>
+
+#include "blk-mq.h"
+
+static unsigned int cpu_to_queue_index(unsigned int nr_cpus,
+				       unsigned int nr_queues,
+				       const int cpu)
+{
+	return cpu * nr_queues / nr_cpus;
+}
+
+static int get_first_sibling(unsigned int cpu)
+{
+	unsigned int ret;
+
+	ret = cpumask_first(topology_thread_cpumask(cpu));
+	if (ret < nr_cpu_ids)
+		return ret;
+
+	return cpu;
+}
+
+/*
+ * Spread the possible cpus evenly over the hardware queues, keeping
+ * hyperthread siblings on the same queue.
+ */
+static void blk_mq_update_queue_map(unsigned int *map, unsigned int nr_queues)
+{
+	unsigned int i, nr_cpus, nr_uniq_cpus, queue, first_sibling;
+
+	nr_cpus = nr_uniq_cpus = 0;
+	for_each_possible_cpu(i) {
+		nr_cpus++;
+		if (get_first_sibling(i) == i)
+			nr_uniq_cpus++;
+	}
+
+	queue = 0;
+	for_each_possible_cpu(i) {
+		/*
+		 * Easy case - we have equal or more hardware queues. Or
+		 * there are no thread siblings to take into account. Do
+		 * 1:1 if enough, or sequential mapping if less.
+		 */
+		if (nr_queues >= nr_cpus || nr_cpus == nr_uniq_cpus) {
+			map[i] = cpu_to_queue_index(nr_cpus, nr_queues, queue);
+			queue++;
+			continue;
+		}
+
+		/*
+		 * Less then nr_cpus queues, and we have some number of
+		 * threads per cores. Map sibling threads to the same
+		 * queue.
+		 */
+		first_sibling = get_first_sibling(i);
+		if (first_sibling == i) {
+			map[i] = cpu_to_queue_index(nr_uniq_cpus, nr_queues,
+						    queue);
+			queue++;
+		} else
+			map[i] = map[first_sibling];
+	}
+}
+
+unsigned int *blk_mq_make_queue_map(struct blk_mq_reg *reg)
+{
+	unsigned int *map;
+
+	map = kzalloc_node(sizeof(*map) * nr_cpu_ids, GFP_KERNEL,
+			   reg->numa_node);
+	if (!map)
+		return NULL;
+
+	blk_mq_update_queue_map(map, reg->nr_hw_queues);
+	return map;
+}
@@ -0,0 +1,114 @@
+/*
+ * Tag allocation for the multi-queue block layer. Each hardware queue
+ * owns a bitmap of tags; a tag is the index of a preallocated request.
+ */
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/sched.h>
+#include <linux/wait.h>
+#include <linux/blk-mq.h>
+
+#include "blk-mq.h"
+
+struct blk_mq_tags {
+	unsigned int		nr_tags;
+	unsigned long		*tag_map;
+	wait_queue_head_t	wait;
+};
+
+bool blk_mq_has_free_tags(struct blk_mq_tags *tags)
+{
+	return find_first_zero_bit(tags->tag_map, tags->nr_tags) <
+		tags->nr_tags;
+}
+
+/*
+ * Start searching at the last tag this software queue handed out, so that
+ * cpus sharing a hardware queue don't all hammer the same bitmap word.
+ */
+static unsigned int __blk_mq_get_tag(struct blk_mq_tags *tags,
+				     unsigned int *last_tag)
+{
+	unsigned int tag, start = *last_tag;
+	bool wrapped = false;
+
+	if (start >= tags->nr_tags)
+		start = 0;
+
+	for (;;) {
+		tag = find_next_zero_bit(tags->tag_map, tags->nr_tags, start);
+		if (tag >= tags->nr_tags) {
+			if (wrapped || !*last_tag)
+				return BLK_MQ_TAG_FAIL;
+			wrapped = true;
+			start = 0;
+			continue;
+		}
+		if (!test_and_set_bit_lock(tag, tags->tag_map))
+			break;
+		start = tag + 1;
+	}
+
+	*last_tag = tag + 1;
+	return tag;
+}
+
+unsigned int blk_mq_get_tag(struct blk_mq_tags *tags, unsigned int *last_tag,
+			    gfp_t gfp)
+{
+	unsigned int tag;
+	DEFINE_WAIT(wait);
+
+	tag = __blk_mq_get_tag(tags, last_tag);
+	if (tag != BLK_MQ_TAG_FAIL || !(gfp & __GFP_WAIT))
+		return tag;
+
+	for (;;) {
+		prepare_to_wait_exclusive(&tags->wait, &wait,
+					  TASK_UNINTERRUPTIBLE);
+		tag = __blk_mq_get_tag(tags, last_tag);
+		if (tag != BLK_MQ_TAG_FAIL)
+			break;
+		io_schedule();
+	}
+	finish_wait(&tags->wait, &wait);
+
+	return tag;
+}
+
+void blk_mq_put_tag(struct blk_mq_tags *tags, unsigned int tag)
+{
+	BUG_ON(tag >= tags->nr_tags);
+
+	clear_bit_unlock(tag, tags->tag_map);
+	smp_mb__after_clear_bit();
+	if (waitqueue_active(&tags->wait))
+		wake_up(&tags->wait);
+}
+
+struct blk_mq_tags *blk_mq_init_tags(unsigned int nr_tags, int node)
+{
+	struct blk_mq_tags *tags;
+
+	tags = kzalloc_node(sizeof(*tags), GFP_KERNEL, node);
+	if (!tags)
+		return NULL;
+
+	tags->tag_map = kzalloc_node(BITS_TO_LONGS(nr_tags) * sizeof(long),
+				     GFP_KERNEL, node);
+	if (!tags->tag_map) {
+		kfree(tags);
+		return NULL;
+	}
+
+	tags->nr_tags = nr_tags;
+	init_waitqueue_head(&tags->wait);
+	return tags;
+}
+
+void blk_mq_free_tags(struct blk_mq_tags *tags)
+{
+	kfree(tags->tag_map);
+	kfree(tags);
+}
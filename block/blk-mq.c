@@ -0,0 +1,919 @@
+/*
+ * Block multiqueue core code
+ *
+ * Requests are queued on per-cpu software queues and dispatched to the
+ * driver through one or more hardware contexts, without ever touching
+ * the legacy queue_lock or the elevator. Requests and their tags are
+ * preallocated per hardware context.
+ */
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/backing-dev.h>
+#include <linux/bio.h>
+#include <linux/blkdev.h>
+#include <linux/mm.h>
+#include <linux/init.h>
+#include <linux/slab.h>
+#include <linux/workqueue.h>
+#include <linux/smp.h>
+#include <linux/cpu.h>
+#include <linux/cache.h>
+#include <linux/sched.h>
+#include <linux/random.h>
+
+#include <trace/events/block.h>
+
+#include <linux/blk-mq.h>
+#include "blk.h"
+#include "blk-mq.h"
+
+static struct blk_mq_ctx *__blk_mq_get_ctx(struct request_queue *q,
+					   unsigned int cpu)
+{
+	return per_cpu_ptr(q->queue_ctx, cpu);
+}
+
+/*
+ * The software queue of the submitting cpu. It is only used to spread
+ * the load: a request stays with the ctx it was allocated from even if
+ * the task migrates before it is queued.
+ */
+static struct blk_mq_ctx *blk_mq_get_ctx(struct request_queue *q)
+{
+	struct blk_mq_ctx *ctx = __blk_mq_get_ctx(q, get_cpu());
+
+	put_cpu();
+	return ctx;
+}
+
+/*
+ * Check if any of the ctx's have pending work in this hardware queue
+ */
+static bool blk_mq_hctx_has_pending(struct blk_mq_hw_ctx *hctx)
+{
+	return !list_empty_careful(&hctx->dispatch) ||
+		!bitmap_empty(hctx->ctx_map, hctx->nr_ctx);
+}
+
+/*
+ * Mark this ctx as having pending work in this hardware queue
+ */
+static void blk_mq_hctx_mark_pending(struct blk_mq_hw_ctx *hctx,
+				     struct blk_mq_ctx *ctx)
+{
+	if (!test_bit(ctx->index_hw, hctx->ctx_map))
+		set_bit(ctx->index_hw, hctx->ctx_map);
+}
+
+static struct request *__blk_mq_alloc_request(struct blk_mq_hw_ctx *hctx,
+					      struct blk_mq_ctx *ctx,
+					      int rw, gfp_t gfp)
+{
+	struct request *rq;
+	unsigned int tag;
+
+	tag = blk_mq_get_tag(hctx->tags, &ctx->last_tag, gfp);
+	if (tag == BLK_MQ_TAG_FAIL)
+		return NULL;
+
+	rq = hctx->rqs[tag];
+	blk_rq_init(hctx->queue, rq);
+	rq->tag = tag;
+	rq->mq_ctx = ctx;
+	rq->cmd_flags = rw;
+	ctx->rq_dispatched[rw_is_sync(rw)]++;
+
+	return rq;
+}
+
+static struct request *blk_mq_alloc_rq(struct request_queue *q, int rw,
+				       gfp_t gfp)
+{
+	struct blk_mq_ctx *ctx = blk_mq_get_ctx(q);
+	struct blk_mq_hw_ctx *hctx = q->mq_ops->map_queue(q, ctx->cpu);
+	struct request *rq;
+
+	rq = __blk_mq_alloc_request(hctx, ctx, rw, gfp & ~__GFP_WAIT);
+	if (rq || !(gfp & __GFP_WAIT))
+		return rq;
+
+	/*
+	 * Out of tags. Make sure what is sitting in the software queues
+	 * gets to the driver before we go to sleep waiting for a tag.
+	 */
+	blk_mq_run_hw_queue(hctx, false);
+	return __blk_mq_alloc_request(hctx, ctx, rw, gfp);
+}
+
+struct request *blk_mq_alloc_request(struct request_queue *q, int rw,
+				     gfp_t gfp)
+{
+	return blk_mq_alloc_rq(q, rw, gfp);
+}
+EXPORT_SYMBOL(blk_mq_alloc_request);
+
+void blk_mq_free_request(struct request *rq)
+{
+	struct blk_mq_ctx *ctx = rq->mq_ctx;
+	struct request_queue *q = rq->q;
+	struct blk_mq_hw_ctx *hctx = q->mq_ops->map_queue(q, ctx->cpu);
+
+	/*
+	 * Completion may run on any cpu, so count it in the local ctx
+	 * rather than racing with other cpus on the submitting one.
+	 */
+	this_cpu_inc(q->queue_ctx->rq_completed[rq_is_sync(rq)]);
+	blk_mq_put_tag(hctx->tags, rq->tag);
+}
+EXPORT_SYMBOL(blk_mq_free_request);
+
+/**
+ * blk_mq_end_io - end I/O on a multiqueue request
+ * @rq:		the request being completed
+ * @error:	%0 for success, < %0 for error
+ *
+ * Description:
+ *     Ends I/O on all of @rq and frees it, or hands it to its ->end_io
+ *     callback. Unlike the legacy completion helpers no queue lock is
+ *     needed, and partial completions are not supported.
+ */
+void blk_mq_end_io(struct request *rq, int error)
+{
+	struct request_queue *q = rq->q;
+
+	blk_update_request(rq, error, blk_rq_bytes(rq));
+
+	if (blk_queue_add_random(q))
+		add_disk_randomness(rq->rq_disk);
+
+	blk_account_io_done(rq);
+
+	if (rq->end_io)
+		rq->end_io(rq, error);
+	else
+		blk_mq_free_request(rq);
+}
+EXPORT_SYMBOL(blk_mq_end_io);
+
+#if defined(CONFIG_SMP) && defined(CONFIG_USE_GENERIC_SMP_HELPERS)
+static void blk_mq_end_io_remote(void *data)
+{
+	struct request *rq = data;
+
+	blk_mq_end_io(rq, rq->errors);
+}
+#endif
+
+/**
+ * blk_mq_complete_request - end I/O on a request from interrupt context
+ * @rq:		the request being completed
+ * @error:	%0 for success, < %0 for error
+ *
+ * Description:
+ *     Like blk_mq_end_io(), but if the queue asks for it (QUEUE_FLAG_SAME_COMP)
+ *     the completion of a file system request is moved to the cpu that
+ *     submitted it, so that its caches stay warm.
+ */
+void blk_mq_complete_request(struct request *rq, int error)
+{
+#if defined(CONFIG_SMP) && defined(CONFIG_USE_GENERIC_SMP_HELPERS)
+	struct blk_mq_ctx *ctx = rq->mq_ctx;
+	int cpu;
+
+	if (rq->cmd_type == REQ_TYPE_FS &&
+	    test_bit(QUEUE_FLAG_SAME_COMP, &rq->q->queue_flags)) {
+		cpu = get_cpu();
+		if (cpu != ctx->cpu && cpu_online(ctx->cpu)) {
+			rq->errors = error;
+			rq->csd.func = blk_mq_end_io_remote;
+			rq->csd.info = rq;
+			rq->csd.flags = 0;
+			__smp_call_function_single(ctx->cpu, &rq->csd, 0);
+			put_cpu();
+			return;
+		}
+		put_cpu();
+	}
+#endif
+	blk_mq_end_io(rq, error);
+}
+EXPORT_SYMBOL(blk_mq_complete_request);
+
+static void blk_mq_start_request(struct request *rq)
+{
+	trace_block_rq_issue(rq->q, rq);
+	rq->cmd_flags |= REQ_STARTED;
+}
+
+/*
+ * Run this hardware queue, pulling in any software queues mapped to it.
+ * Requests left on hctx->dispatch by an earlier busy run go out first.
+ */
+static void __blk_mq_run_hw_queue(struct blk_mq_hw_ctx *hctx)
+{
+	struct request_queue *q = hctx->queue;
+	struct blk_mq_ctx *ctx;
+	struct request *rq;
+	LIST_HEAD(rq_list);
+	int bit, queued;
+
+	if (unlikely(test_bit(BLK_MQ_S_STOPPED, &hctx->state)))
+		return;
+
+	hctx->run++;
+
+	/*
+	 * Touch any software queue that has pending entries.
+	 */
+	for_each_set_bit(bit, hctx->ctx_map, hctx->nr_ctx) {
+		clear_bit(bit, hctx->ctx_map);
+		ctx = hctx->ctxs[bit];
+		BUG_ON(bit != ctx->index_hw);
+
+		spin_lock(&ctx->lock);
+		list_splice_tail_init(&ctx->rq_list, &rq_list);
+		spin_unlock(&ctx->lock);
+	}
+
+	/*
+	 * If we have previous entries on our dispatch list, grab them
+	 * and stuff them at the front for more fair dispatch.
+	 */
+	if (!list_empty_careful(&hctx->dispatch)) {
+		spin_lock(&hctx->lock);
+		if (!list_empty(&hctx->dispatch))
+			list_splice_init(&hctx->dispatch, &rq_list);
+		spin_unlock(&hctx->lock);
+	}
+
+	/*
+	 * Now process all the entries, sending them to the driver.
+	 */
+	queued = 0;
+	while (!list_empty(&rq_list)) {
+		int ret;
+
+		rq = list_first_entry(&rq_list, struct request, queuelist);
+		list_del_init(&rq->queuelist);
+		blk_mq_start_request(rq);
+
+		ret = q->mq_ops->queue_rq(hctx, rq);
+		switch (ret) {
+		case BLK_MQ_RQ_QUEUE_OK:
+			queued++;
+			break;
+		case BLK_MQ_RQ_QUEUE_BUSY:
+			/*
+			 * The driver is out of resources and should have
+			 * stopped the queue; it restarts it once they free up.
+			 */
+			list_add(&rq->queuelist, &rq_list);
+			break;
+		default:
+			pr_err("blk-mq: bad return on queue: %d\n", ret);
+		case BLK_MQ_RQ_QUEUE_ERROR:
+			blk_mq_end_io(rq, -EIO);
+			break;
+		}
+
+		if (ret == BLK_MQ_RQ_QUEUE_BUSY)
+			break;
+	}
+
+	hctx->queued += queued;
+
+	/*
+	 * Any items that need requeuing? Stuff them into hctx->dispatch,
+	 * that is where we will continue on next queue run.
+	 */
+	if (!list_empty(&rq_list)) {
+		spin_lock(&hctx->lock);
+		list_splice(&rq_list, &hctx->dispatch);
+		spin_unlock(&hctx->lock);
+
+		/*
+		 * The driver may have restarted the queue before the
+		 * requests above were visible on the dispatch list, in
+		 * which case nobody else is going to run it again.
+		 * Pairs with the barrier in blk_mq_start_stopped_hw_queues().
+		 */
+		smp_mb();
+		if (!test_bit(BLK_MQ_S_STOPPED, &hctx->state))
+			blk_mq_run_hw_queue(hctx, true);
+	}
+}
+
+/**
+ * blk_mq_run_hw_queue - dispatch requests pending on a hardware queue
+ * @hctx:	the hardware queue to run
+ * @async:	punt the work to kblockd instead of running it inline
+ *
+ * Description:
+ *     ->queue_rq is only ever called from process context, so from
+ *     interrupt context the run is always deferred to kblockd.
+ */
+void blk_mq_run_hw_queue(struct blk_mq_hw_ctx *hctx, bool async)
+{
+	if (unlikely(test_bit(BLK_MQ_S_STOPPED, &hctx->state)))
+		return;
+
+	if (!async && !in_interrupt())
+		__blk_mq_run_hw_queue(hctx);
+	else
+		kblockd_schedule_work(hctx->queue, &hctx->run_work);
+}
+EXPORT_SYMBOL(blk_mq_run_hw_queue);
+
+void blk_mq_run_queues(struct request_queue *q, bool async)
+{
+	struct blk_mq_hw_ctx *hctx;
+	int i;
+
+	queue_for_each_hw_ctx(q, hctx, i) {
+		if (!blk_mq_hctx_has_pending(hctx) ||
+		    test_bit(BLK_MQ_S_STOPPED, &hctx->state))
+			continue;
+
+		blk_mq_run_hw_queue(hctx, async);
+	}
+}
+EXPORT_SYMBOL(blk_mq_run_queues);
+
+/*
+ * Drivers stop a hardware queue when they run out of resources, and
+ * restart it with blk_mq_start_stopped_hw_queues() once some are freed.
+ */
+void blk_mq_stop_hw_queue(struct blk_mq_hw_ctx *hctx)
+{
+	set_bit(BLK_MQ_S_STOPPED, &hctx->state);
+}
+EXPORT_SYMBOL(blk_mq_stop_hw_queue);
+
+void blk_mq_start_stopped_hw_queues(struct request_queue *q)
+{
+	struct blk_mq_hw_ctx *hctx;
+	int i;
+
+	queue_for_each_hw_ctx(q, hctx, i) {
+		if (!test_bit(BLK_MQ_S_STOPPED, &hctx->state))
+			continue;
+
+		clear_bit(BLK_MQ_S_STOPPED, &hctx->state);
+		smp_mb__after_clear_bit();
+		blk_mq_run_hw_queue(hctx, true);
+	}
+}
+EXPORT_SYMBOL(blk_mq_start_stopped_hw_queues);
+
+static void blk_mq_run_work_fn(struct work_struct *work)
+{
+	struct blk_mq_hw_ctx *hctx;
+
+	hctx = container_of(work, struct blk_mq_hw_ctx, run_work);
+	__blk_mq_run_hw_queue(hctx);
+}
+
+static void blk_mq_unplug(struct request_queue *q)
+{
+	blk_mq_run_queues(q, false);
+}
+
+static void __blk_mq_insert_request(struct blk_mq_hw_ctx *hctx,
+				    struct request *rq, bool at_head)
+{
+	struct blk_mq_ctx *ctx = rq->mq_ctx;
+
+	trace_block_rq_insert(hctx->queue, rq);
+
+	if (at_head)
+		list_add(&rq->queuelist, &ctx->rq_list);
+	else
+		list_add_tail(&rq->queuelist, &ctx->rq_list);
+	blk_mq_hctx_mark_pending(hctx, ctx);
+}
+
+void blk_mq_insert_request(struct request *rq, bool at_head, bool run_queue)
+{
+	struct request_queue *q = rq->q;
+	struct blk_mq_ctx *ctx = rq->mq_ctx;
+	struct blk_mq_hw_ctx *hctx = q->mq_ops->map_queue(q, ctx->cpu);
+
+	spin_lock(&ctx->lock);
+	__blk_mq_insert_request(hctx, rq, at_head);
+	spin_unlock(&ctx->lock);
+
+	if (run_queue)
+		blk_mq_run_hw_queue(hctx, false);
+}
+EXPORT_SYMBOL(blk_mq_insert_request);
+
+/*
+ * Only the request queued last on this cpu is considered for merging,
+ * which is enough to catch sequential streams without an elevator.
+ */
+static bool blk_mq_attempt_merge(struct request_queue *q,
+				 struct blk_mq_ctx *ctx, struct bio *bio)
+{
+	struct request *rq;
+	bool merged = false;
+
+	spin_lock(&ctx->lock);
+	if (list_empty(&ctx->rq_list))
+		goto out;
+
+	rq = list_entry(ctx->rq_list.prev, struct request, queuelist);
+	if (!elv_rq_merge_ok(rq, bio))
+		goto out;
+
+	if (blk_rq_pos(rq) + blk_rq_sectors(rq) == bio->bi_sector)
+		merged = bio_attempt_back_merge(q, rq, bio);
+	else if (blk_rq_pos(rq) - bio_sectors(bio) == bio->bi_sector)
+		merged = bio_attempt_front_merge(q, rq, bio);
+
+	if (merged)
+		ctx->rq_merged++;
+out:
+	spin_unlock(&ctx->lock);
+	return merged;
+}
+
+static void blk_mq_queue_bio(struct request_queue *q, struct bio *bio)
+{
+	const bool is_sync = rw_is_sync(bio->bi_rw);
+	const bool unplug = !!(bio->bi_rw & REQ_UNPLUG);
+	const int rw = bio_data_dir(bio);
+	struct blk_mq_hw_ctx *hctx;
+	struct blk_mq_ctx *ctx;
+	struct request *rq;
+
+	ctx = blk_mq_get_ctx(q);
+	hctx = q->mq_ops->map_queue(q, ctx->cpu);
+
+	if ((hctx->flags & BLK_MQ_F_SHOULD_MERGE) && !blk_queue_nomerges(q) &&
+	    !(bio->bi_rw & (REQ_FLUSH | REQ_FUA)) &&
+	    blk_mq_attempt_merge(q, ctx, bio))
+		goto run_queue;
+
+	trace_block_getrq(q, bio, rw);
+	rq = __blk_mq_alloc_request(hctx, ctx, rw | (is_sync ? REQ_SYNC : 0),
+				    GFP_NOIO & ~__GFP_WAIT);
+	if (unlikely(!rq)) {
+		trace_block_sleeprq(q, bio, rw);
+		blk_mq_run_hw_queue(hctx, false);
+		rq = __blk_mq_alloc_request(hctx, ctx,
+					    rw | (is_sync ? REQ_SYNC : 0),
+					    GFP_NOIO);
+	}
+
+	init_request_from_bio(rq, bio);
+	if (blk_queue_io_stat(q))
+		rq->cmd_flags |= REQ_IO_STAT;
+	drive_stat_acct(rq, 1);
+
+	spin_lock(&ctx->lock);
+	__blk_mq_insert_request(hctx, rq, false);
+	spin_unlock(&ctx->lock);
+
+run_queue:
+	/*
+	 * Sync IO goes out right away. Async IO is left for kblockd, which
+	 * gives the following bios a chance to merge with it.
+	 */
+	blk_mq_run_hw_queue(hctx, !is_sync && !unplug);
+}
+
+struct blk_mq_sync {
+	struct completion	done;
+	int			error;
+};
+
+static void blk_mq_end_sync_rq(struct request *rq, int error)
+{
+	struct blk_mq_sync *sync = rq->end_io_data;
+
+	sync->error = error;
+	blk_mq_free_request(rq);
+	complete(&sync->done);
+}
+
+static int blk_mq_issue_flush(struct request_queue *q, struct gendisk *disk)
+{
+	struct blk_mq_sync sync;
+	struct request *rq;
+
+	rq = blk_mq_alloc_rq(q, WRITE_SYNC, GFP_NOIO);
+	rq->cmd_type = REQ_TYPE_FS;
+	rq->cmd_flags |= REQ_FLUSH;
+	rq->rq_disk = disk;
+	rq->end_io = blk_mq_end_sync_rq;
+	rq->end_io_data = &sync;
+
+	init_completion(&sync.done);
+	blk_mq_insert_request(rq, false, true);
+	wait_for_completion(&sync.done);
+
+	return sync.error;
+}
+
+static void blk_mq_bio_end_sync(struct bio *bio, int error)
+{
+	complete(bio->bi_private);
+}
+
+/*
+ * There is no flush state machine for multiqueue devices; flushes are
+ * sequenced synchronously by the submitter instead. A preflush is sent as
+ * an empty REQ_FLUSH request ahead of the data, and FUA on a device that
+ * doesn't support it is emulated by waiting for the data and flushing
+ * afterwards. Returns true if the bio was completed here.
+ */
+static bool blk_mq_flush_bio(struct request_queue *q, struct bio *bio)
+{
+	struct gendisk *disk = bio->bi_bdev->bd_disk;
+	DECLARE_COMPLETION_ONSTACK(wait);
+	bio_end_io_t *end_io;
+	void *private;
+	int err;
+
+	/* an empty flush is passed down as a request of its own */
+	if (!bio->bi_size) {
+		bio->bi_rw &= ~REQ_FUA;
+		return false;
+	}
+
+	if (bio->bi_rw & REQ_FLUSH) {
+		bio->bi_rw &= ~REQ_FLUSH;
+		err = blk_mq_issue_flush(q, disk);
+		if (err) {
+			bio_endio(bio, err);
+			return true;
+		}
+	}
+
+	if (!(bio->bi_rw & REQ_FUA) || (q->flush_flags & REQ_FUA))
+		return false;
+
+	bio->bi_rw &= ~REQ_FUA;
+	end_io = bio->bi_end_io;
+	private = bio->bi_private;
+	bio->bi_end_io = blk_mq_bio_end_sync;
+	bio->bi_private = &wait;
+
+	blk_mq_queue_bio(q, bio);
+	wait_for_completion(&wait);
+
+	bio->bi_end_io = end_io;
+	bio->bi_private = private;
+
+	err = test_bit(BIO_UPTODATE, &bio->bi_flags) ? 0 : -EIO;
+	if (!err)
+		err = blk_mq_issue_flush(q, disk);
+	bio_endio(bio, err);
+	return true;
+}
+
+static int blk_mq_make_request(struct request_queue *q, struct bio *bio)
+{
+	/*
+	 * low level driver can indicate that it wants pages above a
+	 * certain limit bounced to low memory (ie for highmem, or even
+	 * ISA dma in theory)
+	 */
+	blk_queue_bounce(q, &bio);
+
+	if (unlikely(bio->bi_rw & (REQ_FLUSH | REQ_FUA)) &&
+	    blk_mq_flush_bio(q, bio))
+		return 0;
+
+	blk_mq_queue_bio(q, bio);
+	return 0;
+}
+
+/*
+ * Default mapping to a software queue, since we use one per CPU.
+ */
+struct blk_mq_hw_ctx *blk_mq_map_queue(struct request_queue *q, const int cpu)
+{
+	return q->queue_hw_ctx[q->mq_map[cpu]];
+}
+EXPORT_SYMBOL(blk_mq_map_queue);
+
+static size_t order_to_size(unsigned int order)
+{
+	return (size_t)PAGE_SIZE << order;
+}
+
+static void blk_mq_free_rq_map(struct blk_mq_hw_ctx *hctx)
+{
+	struct page *page;
+
+	while (!list_empty(&hctx->page_list)) {
+		page = list_first_entry(&hctx->page_list, struct page, lru);
+		list_del_init(&page->lru);
+		__free_pages(page, page->private);
+	}
+
+	kfree(hctx->rqs);
+
+	if (hctx->tags)
+		blk_mq_free_tags(hctx->tags);
+}
+
+/*
+ * Preallocate queue_depth requests, each followed by cmd_size bytes of
+ * driver data, in chunks of up to 16 pages.
+ */
+static int blk_mq_init_rq_map(struct blk_mq_hw_ctx *hctx)
+{
+	const unsigned int max_order = 4;
+	unsigned int i, j, entries_per_page;
+	size_t rq_size, left;
+
+	hctx->rqs = kmalloc_node(hctx->queue_depth * sizeof(struct request *),
+				 GFP_KERNEL, hctx->numa_node);
+	if (!hctx->rqs)
+		goto fail;
+
+	rq_size = ALIGN(sizeof(struct request) + hctx->cmd_size,
+			cache_line_size());
+	if (rq_size > order_to_size(max_order))
+		goto fail;
+
+	left = rq_size * hctx->queue_depth;
+
+	for (i = 0; i < hctx->queue_depth;) {
+		unsigned int this_order = max_order;
+		struct page *page;
+		int to_do;
+		void *p;
+
+		while (this_order && left < order_to_size(this_order - 1))
+			this_order--;
+
+		for (;;) {
+			page = alloc_pages_node(hctx->numa_node,
+						GFP_KERNEL | __GFP_NOWARN,
+						this_order);
+			if (page || !this_order ||
+			    order_to_size(this_order - 1) < rq_size)
+				break;
+			this_order--;
+		}
+
+		if (!page)
+			goto fail;
+
+		page->private = this_order;
+		list_add_tail(&page->lru, &hctx->page_list);
+
+		p = page_address(page);
+		entries_per_page = order_to_size(this_order) / rq_size;
+		to_do = min(entries_per_page, hctx->queue_depth - i);
+		left -= to_do * rq_size;
+		for (j = 0; j < to_do; j++) {
+			hctx->rqs[i] = p;
+			blk_rq_init(hctx->queue, hctx->rqs[i]);
+			p += rq_size;
+			i++;
+		}
+	}
+
+	hctx->tags = blk_mq_init_tags(hctx->queue_depth, hctx->numa_node);
+	if (!hctx->tags)
+		goto fail;
+
+	return 0;
+fail:
+	pr_warn("%s: failed to allocate requests\n", __func__);
+	return -ENOMEM;
+}
+
+static void blk_mq_free_hw_queues(struct blk_mq_hw_ctx **hctxs,
+				  unsigned int nr_hw_queues)
+{
+	struct blk_mq_hw_ctx *hctx;
+	unsigned int i;
+
+	for (i = 0; i < nr_hw_queues; i++) {
+		hctx = hctxs[i];
+		if (!hctx)
+			continue;
+
+		blk_mq_free_rq_map(hctx);
+		kfree(hctx->ctxs);
+		kfree(hctx->ctx_map);
+		free_cpumask_var(hctx->cpumask);
+		kfree(hctx);
+	}
+	kfree(hctxs);
+}
+
+static int blk_mq_init_hw_queues(struct request_queue *q,
+				 struct blk_mq_reg *reg, void *driver_data)
+{
+	struct blk_mq_hw_ctx *hctx;
+	unsigned int i;
+
+	/*
+	 * Initialize hardware queues
+	 */
+	queue_for_each_hw_ctx(q, hctx, i) {
+		spin_lock_init(&hctx->lock);
+		INIT_LIST_HEAD(&hctx->dispatch);
+		INIT_WORK(&hctx->run_work, blk_mq_run_work_fn);
+		hctx->queue = q;
+		hctx->flags = reg->flags;
+		hctx->queue_depth = reg->queue_depth;
+		hctx->cmd_size = reg->cmd_size;
+
+		if (blk_mq_init_rq_map(hctx))
+			return -ENOMEM;
+
+		/*
+		 * Allocate space for all possible cpus to avoid allocation in
+		 * runtime
+		 */
+		hctx->ctxs = kmalloc_node(nr_cpu_ids * sizeof(void *),
+					  GFP_KERNEL, hctx->numa_node);
+		if (!hctx->ctxs)
+			return -ENOMEM;
+
+		hctx->ctx_map = kzalloc_node(BITS_TO_LONGS(nr_cpu_ids) *
+					     sizeof(unsigned long),
+					     GFP_KERNEL, hctx->numa_node);
+		if (!hctx->ctx_map)
+			return -ENOMEM;
+
+		if (reg->ops->init_hctx &&
+		    reg->ops->init_hctx(hctx, driver_data, i))
+			return -ENODEV;
+	}
+
+	return 0;
+}
+
+static void blk_mq_init_cpu_queues(struct request_queue *q,
+				   struct blk_mq_reg *reg)
+{
+	struct blk_mq_hw_ctx *hctx;
+	unsigned int i, j;
+
+	for_each_possible_cpu(i) {
+		struct blk_mq_ctx *ctx = __blk_mq_get_ctx(q, i);
+
+		memset(ctx, 0, sizeof(*ctx));
+		ctx->cpu = i;
+		spin_lock_init(&ctx->lock);
+		INIT_LIST_HEAD(&ctx->rq_list);
+		ctx->queue = q;
+
+		hctx = reg->ops->map_queue(q, i);
+		cpumask_set_cpu(i, hctx->cpumask);
+		ctx->index_hw = hctx->nr_ctx;
+		hctx->ctxs[hctx->nr_ctx++] = ctx;
+	}
+
+	/*
+	 * Spread the tag search start points of the cpus sharing a
+	 * hardware queue over its tag space.
+	 */
+	queue_for_each_hw_ctx(q, hctx, i) {
+		struct blk_mq_ctx *ctx;
+
+		hctx_for_each_ctx(hctx, ctx, j)
+			ctx->last_tag = j * hctx->queue_depth / hctx->nr_ctx;
+	}
+}
+
+/**
+ * blk_mq_init_queue - allocate a multiqueue request queue
+ * @reg:	describes the hardware queues and the driver operations
+ * @driver_data: passed to ->init_hctx for every hardware queue
+ *
+ * Description:
+ *    Sets up a request queue that bypasses the legacy request_fn and
+ *    elevator path. Bios are turned into preallocated, tagged requests
+ *    queued on per-cpu software queues, which are mapped onto
+ *    @reg->nr_hw_queues hardware queues and dispatched through
+ *    @reg->ops->queue_rq. The driver completes requests with
+ *    blk_mq_end_io() or blk_mq_complete_request().
+ *
+ *    Returns %NULL on failure.
+ */
+struct request_queue *blk_mq_init_queue(struct blk_mq_reg *reg,
+					void *driver_data)
+{
+	struct blk_mq_hw_ctx **hctxs;
+	struct blk_mq_ctx __percpu *ctx;
+	struct request_queue *q;
+	unsigned int i;
+
+	if (!reg->nr_hw_queues || !reg->ops->queue_rq ||
+	    !reg->ops->map_queue || !reg->queue_depth ||
+	    reg->queue_depth > BLK_MQ_MAX_DEPTH)
+		return NULL;
+
+	ctx = alloc_percpu(struct blk_mq_ctx);
+	if (!ctx)
+		return NULL;
+
+	hctxs = kzalloc_node(reg->nr_hw_queues * sizeof(*hctxs), GFP_KERNEL,
+			     reg->numa_node);
+	if (!hctxs)
+		goto err_percpu;
+
+	for (i = 0; i < reg->nr_hw_queues; i++) {
+		hctxs[i] = kzalloc_node(sizeof(struct blk_mq_hw_ctx),
+					GFP_KERNEL, reg->numa_node);
+		if (!hctxs[i])
+			goto err_hctxs;
+
+		INIT_LIST_HEAD(&hctxs[i]->page_list);
+		if (!zalloc_cpumask_var(&hctxs[i]->cpumask, GFP_KERNEL)) {
+			kfree(hctxs[i]);
+			hctxs[i] = NULL;
+			goto err_hctxs;
+		}
+
+		hctxs[i]->numa_node = reg->numa_node;
+		hctxs[i]->queue_num = i;
+	}
+
+	q = blk_alloc_queue_node(GFP_KERNEL, reg->numa_node);
+	if (!q)
+		goto err_hctxs;
+
+	q->mq_map = blk_mq_make_queue_map(reg);
+	if (!q->mq_map)
+		goto err_map;
+
+	q->queue_ctx = ctx;
+	q->nr_queues = nr_cpu_ids;
+	q->queue_hw_ctx = hctxs;
+	q->nr_hw_queues = reg->nr_hw_queues;
+
+	q->queue_flags |= QUEUE_FLAG_MQ_DEFAULT;
+
+	blk_queue_make_request(q, blk_mq_make_request);
+	q->unplug_fn = blk_mq_unplug;
+	q->nr_requests = reg->queue_depth;
+
+	if (blk_mq_init_hw_queues(q, reg, driver_data))
+		goto err_hw;
+
+	blk_mq_init_cpu_queues(q, reg);
+
+	/*
+	 * Only now is the queue fully set up; blk_release_queue() relies on
+	 * ->mq_ops to know there is multiqueue state to tear down.
+	 */
+	q->mq_ops = reg->ops;
+
+	return q;
+
+err_hw:
+	kfree(q->mq_map);
+	q->mq_map = NULL;
+	q->queue_ctx = NULL;
+	q->queue_hw_ctx = NULL;
+	q->nr_hw_queues = 0;
+err_map:
+	blk_cleanup_queue(q);
+err_hctxs:
+	blk_mq_free_hw_queues(hctxs, reg->nr_hw_queues);
+err_percpu:
+	free_percpu(ctx);
+	return NULL;
+}
+EXPORT_SYMBOL(blk_mq_init_queue);
+
+/*
+ * Make sure no hardware queue run is pending. Called from blk_sync_queue().
+ */
+void blk_mq_sync_queue(struct request_queue *q)
+{
+	struct blk_mq_hw_ctx *hctx;
+	unsigned int i;
+
+	if (!q->mq_ops)
+		return;
+
+	queue_for_each_hw_ctx(q, hctx, i)
+		cancel_work_sync(&hctx->run_work);
+}
+
+/*
+ * Called from blk_release_queue() when the last reference is dropped.
+ */
+void blk_mq_free_queue(struct request_queue *q)
+{
+	blk_mq_free_hw_queues(q->queue_hw_ctx, q->nr_hw_queues);
+	q->queue_hw_ctx = NULL;
+	q->nr_hw_queues = 0;
+
+	free_percpu(q->queue_ctx);
+	kfree(q->mq_map);
+
+	q->queue_ctx = NULL;
+	q->mq_map = NULL;
+}
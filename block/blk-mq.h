@@ -0,0 +1,41 @@
+#ifndef INT_BLK_MQ_H
+#define INT_BLK_MQ_H
+
+struct blk_mq_ctx {
+	struct {
+		spinlock_t		lock;
+		struct list_head	rq_list;
+	}  ____cacheline_aligned_in_smp;
+
+	unsigned int		cpu;
+	unsigned int		index_hw;
+	unsigned int		last_tag;
+
+	/* incremented at dispatch time */
+	unsigned long		rq_dispatched[2];
+	unsigned long		rq_merged;
+
+	/* incremented at completion time, on the completing cpu */
+	unsigned long		____cacheline_aligned_in_smp rq_completed[2];
+
+	struct request_queue	*queue;
+};
+
+/*
+ * CPU -> queue mappings
+ */
+unsigned int *blk_mq_make_queue_map(struct blk_mq_reg *reg);
+
+/*
+ * Tag allocation
+ */
+#define BLK_MQ_TAG_FAIL		((unsigned int) -1)
+
+struct blk_mq_tags *blk_mq_init_tags(unsigned int nr_tags, int node);
+void blk_mq_free_tags(struct blk_mq_tags *tags);
+unsigned int blk_mq_get_tag(struct blk_mq_tags *tags, unsigned int *last_tag,
+			    gfp_t gfp);
+void blk_mq_put_tag(struct blk_mq_tags *tags, unsigned int tag);
+bool blk_mq_has_free_tags(struct blk_mq_tags *tags);
+
+#endif
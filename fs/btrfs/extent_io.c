@@ -10,6 +10,7 @@
 #include <linux/swap.h>
 #include <linux/writeback.h>
 #include <linux/pagevec.h>
+#include <linux/cleancache.h>
 #include "extent_io.h"
 #include "extent_map.h"
 #include "compat.h"
@@ -1771,6 +1772,8 @@ static void end_bio_extent_readpage(struct bio *bio, int err)
 		if (whole_page) {
 			if (uptodate) {
 				SetPageUptodate(page);
+				/* the page matches the disk, see cleancache */
+				SetPageMappedToDisk(page);
 			} else {
 				ClearPageUptodate(page);
 				SetPageError(page);
@@ -1981,6 +1984,14 @@ static int __extent_read_full_page(struct extent_io_tree *tree,
 
 	set_page_extent_mapped(page);
 
+	if (!PageUptodate(page)) {
+		if (cleancache_get_page(page) == 0) {
+			BUG_ON(blocksize != PAGE_SIZE);
+			SetPageMappedToDisk(page);
+			goto out;
+		}
+	}
+
 	end = page_end;
 	while (1) {
 		lock_extent(tree, start, end, GFP_NOFS);
@@ -2108,6 +2119,7 @@ static int __extent_read_full_page(struct extent_io_tree *tree,
 		cur = cur + iosize;
 		page_offset += iosize;
 	}
+out:
 	if (!nr) {
 		if (!PageError(page))
 			SetPageUptodate(page);
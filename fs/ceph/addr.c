@@ -1159,6 +1159,7 @@ out:
 
 static struct vm_operations_struct ceph_vmops = {
 	.fault		= filemap_fault,
+	.map_pages	= filemap_map_pages,
 	.page_mkwrite	= ceph_page_mkwrite,
 };
 
@@ -494,10 +494,10 @@ struct inode *diReadSpecial(struct super_block *sb, ino_t inum, int secondary)
 	/*
 	 * __mark_inode_dirty expects inodes to be hashed.  Since we don't
 	 * want special inodes in the fileset inode space, we make them
-	 * appear hashed, but do not put on any lists.  hlist_del()
-	 * will work fine and require no locking.
+	 * appear hashed, but do not put on any lists.
+	 * remove_inode_hash() copes with that.
 	 */
-	hlist_add_fake(&ip->i_hash);
+	inode_fake_hash(ip);
 
 	return (ip);
 }
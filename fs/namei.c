@@ -480,8 +480,8 @@ static int nameidata_dentry_drop_rcu(struct nameidata *nd, struct dentry *dentry
 	 * be valid and able to take a reference at this point.
 	 */
 	BUG_ON(!IS_ROOT(dentry) && dentry->d_parent != parent);
-	BUG_ON(!parent->d_count);
-	parent->d_count++;
+	BUG_ON(!parent->d_lockref.count);
+	parent->d_lockref.count++;
 	spin_unlock(&dentry->d_lock);
 	spin_unlock(&parent->d_lock);
 	if (nd->root.mnt) {
@@ -2823,7 +2823,7 @@ void dentry_unhash(struct dentry *dentry)
 	dget(dentry);
 	shrink_dcache_parent(dentry);
 	spin_lock(&dentry->d_lock);
-	if (dentry->d_count == 2)
+	if (dentry->d_lockref.count == 2)
 		__d_drop(dentry);
 	spin_unlock(&dentry->d_lock);
 }
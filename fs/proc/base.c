@@ -362,6 +362,28 @@ static int proc_pid_schedstat(struct task_struct *task, char *buffer)
 }
 #endif
 
+#ifdef CONFIG_NUMA_BALANCING
+/*
+ * Provides /proc/PID/numa_faults: the node the task prefers to run on, and
+ * its NUMA hinting faults by the node the memory was on, see
+ * Documentation/filesystems/proc.txt.
+ */
+static int proc_pid_numa_faults(struct seq_file *m, struct pid_namespace *ns,
+				struct pid *pid, struct task_struct *task)
+{
+	unsigned long *faults = ACCESS_ONCE(task->numa_faults);
+	int nid;
+
+	seq_printf(m, "preferred_node: %d\n", task->numa_preferred_nid);
+	seq_printf(m, "scan_period_ms: %u\n", task->numa_scan_period);
+	for_each_online_node(nid)
+		seq_printf(m, "node%d: %lu %lu\n", nid,
+			   faults ? faults[nid] : 0,
+			   faults ? faults[nr_node_ids + nid] : 0);
+	return 0;
+}
+#endif
+
 #ifdef CONFIG_LATENCYTOP
 static int lstats_show_proc(struct seq_file *m, void *v)
 {
@@ -2841,6 +2863,9 @@ static const struct pid_entry tgid_base_stuff[] = {
 #ifdef CONFIG_SCHEDSTATS
 	INF("schedstat",  S_IRUGO, proc_pid_schedstat),
 #endif
+#ifdef CONFIG_NUMA_BALANCING
+	ONE("numa_faults", S_IRUGO, proc_pid_numa_faults),
+#endif
 #ifdef CONFIG_LATENCYTOP
 	REG("latency",  S_IRUGO, proc_lstats_operations),
 #endif
@@ -3177,6 +3202,9 @@ static const struct pid_entry tid_base_stuff[] = {
 #ifdef CONFIG_SCHEDSTATS
 	INF("schedstat", S_IRUGO, proc_pid_schedstat),
 #endif
+#ifdef CONFIG_NUMA_BALANCING
+	ONE("numa_faults", S_IRUGO, proc_pid_numa_faults),
+#endif
 #ifdef CONFIG_LATENCYTOP
 	REG("latency",  S_IRUGO, proc_lstats_operations),
 #endif
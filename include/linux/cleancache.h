@@ -0,0 +1,138 @@
+#ifndef _LINUX_CLEANCACHE_H
+#define _LINUX_CLEANCACHE_H
+/*
+ * Cleancache: a second chance for clean page cache pages.
+ *
+ * When a clean page of a filesystem that opted in is evicted from the
+ * page cache, it is offered to a backend, which may keep a copy of it
+ * somewhere cheaper than the disk, e.g. compressed in RAM.  Reading the
+ * page asks the backend first.  The backend can drop any page at any
+ * time, and the VFS invalidates pages, inodes and filesystems whenever
+ * their data may change behind its back.
+ */
+
+#include <linux/fs.h>
+#include <linux/exportfs.h>
+#include <linux/mm.h>
+
+#define CLEANCACHE_KEY_MAX 6
+
+/* Identifies a file: the inode number, or a file handle where exportable */
+struct cleancache_filekey {
+	union {
+		ino_t ino;
+		__u32 fh[CLEANCACHE_KEY_MAX];
+	} u;
+};
+
+struct cleancache_ops {
+	int (*init_fs)(size_t pagesize);
+	int (*get_page)(int pool, struct cleancache_filekey key,
+			pgoff_t index, struct page *page);
+	void (*put_page)(int pool, struct cleancache_filekey key,
+			 pgoff_t index, struct page *page);
+	void (*invalidate_page)(int pool, struct cleancache_filekey key,
+				pgoff_t index);
+	void (*invalidate_inode)(int pool, struct cleancache_filekey key);
+	void (*invalidate_fs)(int pool);
+};
+
+#ifdef CONFIG_CLEANCACHE
+extern int cleancache_enabled;
+
+extern struct cleancache_ops *
+	cleancache_register_ops(struct cleancache_ops *ops);
+
+extern void __cleancache_init_fs(struct super_block *sb);
+extern int __cleancache_get_page(struct page *page);
+extern void __cleancache_put_page(struct page *page);
+extern void __cleancache_invalidate_page(struct address_space *mapping,
+					 struct page *page);
+extern void __cleancache_invalidate_inode(struct address_space *mapping);
+extern void __cleancache_invalidate_fs(struct super_block *sb);
+
+static inline bool cleancache_fs_enabled(struct page *page)
+{
+	return page->mapping->host->i_sb->cleancache_poolid >= 0;
+}
+
+static inline bool cleancache_fs_enabled_mapping(struct address_space *mapping)
+{
+	return mapping->host->i_sb->cleancache_poolid >= 0;
+}
+
+/*
+ * Filesystems opt in by calling cleancache_init_fs() when mounting: they
+ * must guarantee that any change to a file's blocks that bypasses the page
+ * cache also invalidates the page cache.
+ */
+static inline void cleancache_init_fs(struct super_block *sb)
+{
+	if (cleancache_enabled)
+		__cleancache_init_fs(sb);
+}
+
+/* Returns 0 if the locked @page was filled from the cache */
+static inline int cleancache_get_page(struct page *page)
+{
+	if (cleancache_enabled && cleancache_fs_enabled(page))
+		return __cleancache_get_page(page);
+	return -1;
+}
+
+static inline void cleancache_put_page(struct page *page)
+{
+	if (cleancache_enabled && cleancache_fs_enabled(page))
+		__cleancache_put_page(page);
+}
+
+static inline void cleancache_invalidate_page(struct address_space *mapping,
+					      struct page *page)
+{
+	/* careful... page->mapping is NULL sometimes when this is called */
+	if (cleancache_enabled && cleancache_fs_enabled_mapping(mapping))
+		__cleancache_invalidate_page(mapping, page);
+}
+
+static inline void cleancache_invalidate_inode(struct address_space *mapping)
+{
+	if (cleancache_enabled && cleancache_fs_enabled_mapping(mapping))
+		__cleancache_invalidate_inode(mapping);
+}
+
+static inline void cleancache_invalidate_fs(struct super_block *sb)
+{
+	if (cleancache_enabled && sb->cleancache_poolid >= 0)
+		__cleancache_invalidate_fs(sb);
+}
+#else
+#define cleancache_enabled (0)
+
+static inline void cleancache_init_fs(struct super_block *sb)
+{
+}
+
+static inline int cleancache_get_page(struct page *page)
+{
+	return -1;
+}
+
+static inline void cleancache_put_page(struct page *page)
+{
+}
+
+static inline void cleancache_invalidate_page(struct address_space *mapping,
+					      struct page *page)
+{
+}
+
+static inline void cleancache_invalidate_inode(struct address_space *mapping)
+{
+}
+
+static inline void cleancache_invalidate_fs(struct super_block *sb)
+{
+}
+#endif /* CONFIG_CLEANCACHE */
+
+#endif /* _LINUX_CLEANCACHE_H */
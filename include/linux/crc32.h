@@ -10,6 +10,25 @@
 
 extern u32  crc32_le(u32 crc, unsigned char const *p, size_t len);
 extern u32  crc32_be(u32 crc, unsigned char const *p, size_t len);
+extern u32  __crc32c_le(u32 crc, unsigned char const *p, size_t len);
+
+/*
+ * One implementation of crc32_le() and __crc32c_le(). lib/crc32.c
+ * benchmarks those that are valid on the running CPU at boot and then
+ * uses the fastest.
+ */
+struct crc32_calls {
+	u32 (*crc32_le)(u32 crc, unsigned char const *p, size_t len);
+	u32 (*crc32c_le)(u32 crc, unsigned char const *p, size_t len);
+	int (*valid)(void);	/* Returns 1 if this routine set is usable */
+	const char *name;	/* Name of this routine set */
+};
+
+/* Table driven versions, also the fallback of the CPU specific ones */
+extern u32  crc32_le_generic(u32 crc, unsigned char const *p, size_t len);
+extern u32  __crc32c_le_generic(u32 crc, unsigned char const *p, size_t len);
+
+extern const struct crc32_calls crc32_pclmul;
 
 #define crc32(seed, data, length)  crc32_le(seed, (unsigned char const *)data, length)
 
@@ -0,0 +1,96 @@
+#ifndef _LINUX_FRONTSWAP_H
+#define _LINUX_FRONTSWAP_H
+/*
+ * Frontswap: a hook in the swap path for a backend that keeps swap pages
+ * somewhere faster than the swap device, e.g. compressed in RAM.
+ *
+ * A page that the backend accepts on swap-out is not written to the swap
+ * device, and swap-in asks the backend first.  The swap slot stays
+ * allocated on the device all along, so the backend may give up any page
+ * at any time by writing it back there.
+ */
+
+#include <linux/mm.h>
+#include <linux/swap.h>
+
+struct frontswap_ops {
+	void (*init)(unsigned type);
+	int (*store)(unsigned type, pgoff_t offset, struct page *page);
+	int (*load)(unsigned type, pgoff_t offset, struct page *page);
+	void (*invalidate_page)(unsigned type, pgoff_t offset);
+	void (*invalidate_area)(unsigned type);
+};
+
+#ifdef CONFIG_FRONTSWAP
+extern int frontswap_enabled;
+
+extern struct frontswap_ops *
+	frontswap_register_ops(struct frontswap_ops *ops);
+
+extern void __frontswap_init(unsigned type);
+extern int __frontswap_store(struct page *page);
+extern int __frontswap_load(struct page *page);
+extern void __frontswap_invalidate_page(unsigned type, pgoff_t offset);
+extern void __frontswap_invalidate_area(unsigned type);
+
+/*
+ * store and load return 0 if the backend took care of the page, or -1
+ * if it has to go to (or come from) the swap device as usual.
+ */
+static inline int frontswap_store(struct page *page)
+{
+	if (frontswap_enabled)
+		return __frontswap_store(page);
+	return -1;
+}
+
+static inline int frontswap_load(struct page *page)
+{
+	if (frontswap_enabled)
+		return __frontswap_load(page);
+	return -1;
+}
+
+static inline void frontswap_invalidate_page(unsigned type, pgoff_t offset)
+{
+	if (frontswap_enabled)
+		__frontswap_invalidate_page(type, offset);
+}
+
+/* Called on swapon and swapoff, so the backend can come and go */
+static inline void frontswap_init(unsigned type)
+{
+	__frontswap_init(type);
+}
+
+static inline void frontswap_invalidate_area(unsigned type)
+{
+	__frontswap_invalidate_area(type);
+}
+#else
+#define frontswap_enabled (0)
+
+static inline int frontswap_store(struct page *page)
+{
+	return -1;
+}
+
+static inline int frontswap_load(struct page *page)
+{
+	return -1;
+}
+
+static inline void frontswap_invalidate_page(unsigned type, pgoff_t offset)
+{
+}
+
+static inline void frontswap_init(unsigned type)
+{
+}
+
+static inline void frontswap_invalidate_area(unsigned type)
+{
+}
+#endif /* CONFIG_FRONTSWAP */
+
+#endif /* _LINUX_FRONTSWAP_H */
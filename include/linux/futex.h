@@ -177,6 +177,9 @@ union futex_key {
 extern void exit_robust_list(struct task_struct *curr);
 extern void exit_pi_state_list(struct task_struct *curr);
 extern int futex_cmpxchg_enabled;
+extern int futex_set_private_hash(unsigned long hashsize);
+extern unsigned long futex_get_private_hash(void);
+extern void futex_mm_release(struct mm_struct *mm);
 #else
 static inline void exit_robust_list(struct task_struct *curr)
 {
@@ -184,6 +187,17 @@ static inline void exit_robust_list(struct task_struct *curr)
 static inline void exit_pi_state_list(struct task_struct *curr)
 {
 }
+static inline int futex_set_private_hash(unsigned long hashsize)
+{
+	return -EINVAL;
+}
+static inline unsigned long futex_get_private_hash(void)
+{
+	return 0;
+}
+static inline void futex_mm_release(struct mm_struct *mm)
+{
+}
 #endif
 #endif /* __KERNEL__ */
 
@@ -343,6 +343,43 @@ extern struct page *alloc_pages_vma(gfp_t gfp_mask, int order,
 #define alloc_page_vma(gfp_mask, vma, addr)	\
 	alloc_pages_vma(gfp_mask, 0, vma, addr)
 
+unsigned long
+__alloc_pages_bulk_nodemask(gfp_t gfp_mask, struct zonelist *zonelist,
+			    nodemask_t *nodemask, unsigned long nr_pages,
+			    struct list_head *page_list,
+			    struct page **page_array);
+
+static inline unsigned long
+alloc_pages_bulk_node(int nid, gfp_t gfp_mask, unsigned long nr_pages,
+		      struct list_head *page_list, struct page **page_array)
+{
+	/* Unknown node is current node */
+	if (nid < 0)
+		nid = numa_node_id();
+
+	return __alloc_pages_bulk_nodemask(gfp_mask,
+			node_zonelist(nid, gfp_mask), NULL, nr_pages,
+			page_list, page_array);
+}
+
+#ifdef CONFIG_NUMA
+extern unsigned long alloc_pages_bulk_current(gfp_t gfp_mask,
+			unsigned long nr_pages, struct list_head *page_list,
+			struct page **page_array);
+
+static inline unsigned long
+alloc_pages_bulk(gfp_t gfp_mask, unsigned long nr_pages,
+		 struct list_head *page_list, struct page **page_array)
+{
+	return alloc_pages_bulk_current(gfp_mask, nr_pages, page_list,
+					page_array);
+}
+#else
+#define alloc_pages_bulk(gfp_mask, nr_pages, page_list, page_array) \
+	alloc_pages_bulk_node(numa_node_id(), gfp_mask, nr_pages, \
+			      page_list, page_array)
+#endif
+
 extern unsigned long __get_free_pages(gfp_t gfp_mask, unsigned int order);
 extern unsigned long get_zeroed_page(gfp_t gfp_mask);
 
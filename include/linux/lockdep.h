@@ -137,6 +137,7 @@ struct lock_class_stats {
 	struct lock_time		read_holdtime;
 	struct lock_time		write_holdtime;
 	unsigned long			bounces[nr_bounce_types];
+	unsigned long			spin_acquisitions[2]; /* write, read */
 };
 
 struct lock_class_stats lock_stats(struct lock_class *class);
@@ -398,6 +399,7 @@ struct lock_class_key { };
 
 extern void lock_contended(struct lockdep_map *lock, unsigned long ip);
 extern void lock_acquired(struct lockdep_map *lock, unsigned long ip);
+extern void lock_spin_acquired(struct lockdep_map *lock);
 
 #define LOCK_CONTENDED(_lock, try, lock)			\
 do {								\
@@ -412,6 +414,7 @@ do {								\
 
 #define lock_contended(lockdep_map, ip) do {} while (0)
 #define lock_acquired(lockdep_map, ip) do {} while (0)
+#define lock_spin_acquired(lockdep_map) do {} while (0)
 
 #define LOCK_CONTENDED(_lock, try, lock) \
 	lock(_lock)
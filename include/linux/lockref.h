@@ -0,0 +1,38 @@
+#ifndef __LINUX_LOCKREF_H
+#define __LINUX_LOCKREF_H
+
+/*
+ * Locked reference counts.
+ *
+ * A reference count and the spinlock that protects it, which can be
+ * changed without taking the lock when it is not held: with
+ * CONFIG_CMPXCHG_LOCKREF, the lock and the count share one 64-bit word,
+ * and the count is changed with a cmpxchg() of the whole word that only
+ * succeeds if the lock was free.  The result is the same as if the lock
+ * had been taken around the change, so that the lock holder still sees
+ * a stable count, but the common get and put no longer bounce the lock
+ * between CPUs.
+ *
+ * Without CONFIG_CMPXCHG_LOCKREF, or while the lock is held, the
+ * helpers fall back to taking the lock.
+ */
+
+#include <linux/spinlock.h>
+
+struct lockref {
+	union {
+#ifdef CONFIG_CMPXCHG_LOCKREF
+		aligned_u64 lock_count;
+#endif
+		struct {
+			spinlock_t lock;
+			unsigned int count;
+		};
+	};
+};
+
+extern void lockref_get(struct lockref *);
+extern int lockref_get_not_zero(struct lockref *);
+extern int lockref_put_or_lock(struct lockref *);
+
+#endif /* __LINUX_LOCKREF_H */
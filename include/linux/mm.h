@@ -189,6 +189,10 @@ struct vm_fault {
 					 * is set (which is also implied by
 					 * VM_FAULT_ERROR).
 					 */
+	/* for ->map_pages() only */
+	pgoff_t max_pgoff;		/* map pages for offset from pgoff till
+					 * max_pgoff inclusive */
+	pte_t *pte;			/* pte entry associated with ->pgoff */
 };
 
 /*
@@ -201,6 +205,21 @@ struct vm_operations_struct {
 	void (*close)(struct vm_area_struct * area);
 	int (*fault)(struct vm_area_struct *vma, struct vm_fault *vmf);
 
+	/*
+	 * Optionally map the pages of vmf->pgoff..vmf->max_pgoff that are
+	 * readily available, around a read fault: called with the page
+	 * table lock held, it must not sleep and may map none of them.
+	 */
+	void (*map_pages)(struct vm_area_struct *vma, struct vm_fault *vmf);
+
+	/*
+	 * Optionally map a huge page with the pmd, when that is still none;
+	 * returns VM_FAULT_FALLBACK to have the fault handled by ->fault
+	 * one pte at a time instead.
+	 */
+	int (*pmd_fault)(struct vm_area_struct *vma, unsigned long address,
+			 pmd_t *pmd, unsigned int flags);
+
 	/* notification that a previously read-only page is about to become
 	 * writable, if an error is returned it will cause a SIGBUS */
 	int (*page_mkwrite)(struct vm_area_struct *vma, struct vm_fault *vmf);
@@ -835,6 +854,7 @@ static inline int page_mapped(struct page *page)
 #define VM_FAULT_NOPAGE	0x0100	/* ->fault installed the pte, not return page */
 #define VM_FAULT_LOCKED	0x0200	/* ->fault locked the returned page */
 #define VM_FAULT_RETRY	0x0400	/* ->fault blocked, must retry */
+#define VM_FAULT_FALLBACK 0x0800	/* ->pmd_fault declined, use ptes */
 
 #define VM_FAULT_HWPOISON_LARGE_MASK 0xf000 /* encodes hpage index for large hwpoison */
 
@@ -962,6 +982,41 @@ static inline int handle_mm_fault(struct mm_struct *mm,
 }
 #endif
 
+#ifdef CONFIG_SPECULATIVE_PAGE_FAULT
+extern int handle_speculative_fault(struct mm_struct *mm,
+			unsigned long address, unsigned int flags);
+
+/*
+ * Changes to the vma tree, or to the vma fields a page fault depends on,
+ * are made under mmap_sem held for write and inside a vma_seq_write_begin()
+ * and vma_seq_write_end() pair, so that speculative page faults, which
+ * don't take mmap_sem, can tell they raced with them.
+ */
+static inline void vma_seq_write_begin(struct mm_struct *mm)
+{
+	write_seqcount_begin(&mm->vma_seq);
+}
+
+static inline void vma_seq_write_end(struct mm_struct *mm)
+{
+	write_seqcount_end(&mm->vma_seq);
+}
+#else
+static inline int handle_speculative_fault(struct mm_struct *mm,
+			unsigned long address, unsigned int flags)
+{
+	return VM_FAULT_RETRY;
+}
+
+static inline void vma_seq_write_begin(struct mm_struct *mm)
+{
+}
+
+static inline void vma_seq_write_end(struct mm_struct *mm)
+{
+}
+#endif
+
 extern int make_pages_present(unsigned long addr, unsigned long end);
 extern int access_process_vm(struct task_struct *tsk, unsigned long addr, void *buf, int len, int write);
 
@@ -997,6 +1052,9 @@ extern unsigned long move_page_tables(struct vm_area_struct *vma,
 extern unsigned long do_mremap(unsigned long addr,
 			       unsigned long old_len, unsigned long new_len,
 			       unsigned long flags, unsigned long new_addr);
+extern void change_protection(struct vm_area_struct *vma, unsigned long start,
+			      unsigned long end, pgprot_t newprot,
+			      int dirty_accountable);
 extern int mprotect_fixup(struct vm_area_struct *vma,
 			  struct vm_area_struct **pprev, unsigned long start,
 			  unsigned long end, unsigned long newflags);
@@ -1442,6 +1500,8 @@ extern void truncate_inode_pages_range(struct address_space *,
 
 /* generic vm_area_ops exported for stackable file systems */
 extern int filemap_fault(struct vm_area_struct *, struct vm_fault *);
+extern void filemap_map_pages(struct vm_area_struct *vma,
+		struct vm_fault *vmf);
 
 /* mm/page-writeback.c */
 int write_one_page(struct page *page, int wait);
@@ -1484,6 +1544,10 @@ extern int expand_stack_downwards(struct vm_area_struct *vma,
 
 /* Look up the first VMA which satisfies  addr < vm_end,  NULL if none. */
 extern struct vm_area_struct * find_vma(struct mm_struct * mm, unsigned long addr);
+#ifdef CONFIG_SPECULATIVE_PAGE_FAULT
+extern struct vm_area_struct *find_vma_rcu(struct mm_struct *mm,
+					   unsigned long addr);
+#endif
 extern struct vm_area_struct * find_vma_prev(struct mm_struct * mm, unsigned long addr,
 					     struct vm_area_struct **pprev);
 
@@ -1512,10 +1576,56 @@ static inline pgprot_t vm_get_page_prot(unsigned long vm_flags)
 }
 #endif
 
+#ifdef CONFIG_NUMA_BALANCING
+/*
+ * The NUMA balancing scanner revokes access to ranges of the address space
+ * by giving their ptes the protections of a PROT_NONE mapping, so that the
+ * next access takes a NUMA hinting fault.  Such a pte is told apart from a
+ * real PROT_NONE mapping by its vma, which does allow access.
+ */
+static inline pgprot_t vma_prot_none(struct vm_area_struct *vma)
+{
+	return vm_get_page_prot(vma->vm_flags & ~(VM_READ | VM_WRITE | VM_EXEC));
+}
+
+static inline int pte_numa(struct vm_area_struct *vma, pte_t pte)
+{
+	if (pte_same(pte, pte_modify(pte, vma->vm_page_prot)))
+		return 0;
+	return pte_same(pte, pte_modify(pte, vma_prot_none(vma)));
+}
+
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+static inline int pmd_numa(struct vm_area_struct *vma, pmd_t pmd)
+{
+	if (pmd_same(pmd, pmd_modify(pmd, vma->vm_page_prot)))
+		return 0;
+	return pmd_same(pmd, pmd_modify(pmd, vma_prot_none(vma)));
+}
+#else
+static inline int pmd_numa(struct vm_area_struct *vma, pmd_t pmd)
+{
+	return 0;
+}
+#endif
+#else
+static inline int pte_numa(struct vm_area_struct *vma, pte_t pte)
+{
+	return 0;
+}
+
+static inline int pmd_numa(struct vm_area_struct *vma, pmd_t pmd)
+{
+	return 0;
+}
+#endif
+
 struct vm_area_struct *find_extend_vma(struct mm_struct *, unsigned long addr);
 int remap_pfn_range(struct vm_area_struct *, unsigned long addr,
 			unsigned long pfn, unsigned long size, pgprot_t);
 int vm_insert_page(struct vm_area_struct *, unsigned long addr, struct page *);
+void do_set_pte(struct vm_area_struct *vma, unsigned long address,
+		struct page *page, pte_t *pte, bool write, bool anon);
 int vm_insert_pfn(struct vm_area_struct *vma, unsigned long addr,
 			unsigned long pfn);
 int vm_insert_mixed(struct vm_area_struct *vma, unsigned long addr,
@@ -1579,6 +1689,9 @@ int in_gate_area_no_task(unsigned long addr);
 
 int drop_caches_sysctl_handler(struct ctl_table *, int,
 					void __user *, size_t *, loff_t *);
+extern unsigned long sysctl_fault_around_bytes;
+int fault_around_bytes_handler(struct ctl_table *, int,
+					void __user *, size_t *, loff_t *);
 unsigned long shrink_slab(unsigned long scanned, gfp_t gfp_mask,
 			unsigned long lru_pages);
 
@@ -9,6 +9,8 @@
 #include <linux/prio_tree.h>
 #include <linux/rbtree.h>
 #include <linux/rwsem.h>
+#include <linux/seqlock.h>
+#include <linux/rcupdate.h>
 #include <linux/completion.h>
 #include <linux/cpumask.h>
 #include <linux/page-debug-flags.h>
@@ -183,6 +185,9 @@ struct vm_area_struct {
 #ifdef CONFIG_NUMA
 	struct mempolicy *vm_policy;	/* NUMA policy for the VMA */
 #endif
+#ifdef CONFIG_SPECULATIVE_PAGE_FAULT
+	struct rcu_head vm_rcu;		/* speculative faults may still see us */
+#endif
 };
 
 struct core_thread {
@@ -238,6 +243,9 @@ struct mm_struct {
 	atomic_t mm_count;			/* How many references to "struct mm_struct" (users count as 1) */
 	int map_count;				/* number of VMAs */
 	struct rw_semaphore mmap_sem;
+#ifdef CONFIG_SPECULATIVE_PAGE_FAULT
+	seqcount_t vma_seq;			/* vma changes, see vma_seq_write_begin() */
+#endif
 	spinlock_t page_table_lock;		/* Protects page tables and some counters */
 
 	struct list_head mmlist;		/* List of maybe swapped mm's.	These are globally strung
@@ -310,8 +318,25 @@ struct mm_struct {
 #ifdef CONFIG_MMU_NOTIFIER
 	struct mmu_notifier_mm *mmu_notifier_mm;
 #endif
+#ifdef CONFIG_FUTEX
+	/* own table for the private futexes, see PR_SET_FUTEX_HASH */
+	struct futex_private_hash *futex_hash;
+#endif
 #ifdef CONFIG_TRANSPARENT_HUGEPAGE
 	pgtable_t pmd_huge_pte; /* protected by page_table_lock */
+#endif
+#ifdef CONFIG_NUMA_BALANCING
+	/* NUMA balancing scanner state, see task_numa_work() */
+	unsigned long numa_next_scan;	/* jiffies */
+	unsigned long numa_scan_offset;	/* address to resume the scan at */
+	int numa_scan_seq;		/* completed scans of the mm */
+#endif
+#ifdef CONFIG_ARCH_WANT_BATCHED_UNMAP_TLB_FLUSH
+	/*
+	 * Set when reclaim cleared ptes of this mm and has yet to flush
+	 * the TLBs, see flush_tlb_batched_pending().
+	 */
+	bool tlb_flush_batched;
 #endif
 	/* How many tasks sharing this mm are OOM_DISABLE */
 	atomic_t oom_disable_count;
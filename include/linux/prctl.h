@@ -102,4 +102,13 @@
 
 #define PR_MCE_KILL_GET 34
 
+/*
+ * Get/set the number of buckets of the process's own hash table for its
+ * private futexes, 0 meaning the global table.  It can only be set while
+ * the process is single-threaded, and more than 256 buckets needs
+ * CAP_SYS_RESOURCE.
+ */
+#define PR_SET_FUTEX_HASH 35
+#define PR_GET_FUTEX_HASH 36
+
 #endif /* _LINUX_PRCTL_H */
@@ -68,6 +68,12 @@ extern __u32 secure_tcpv6_sequence_number(__be32 *saddr, __be32 *daddr,
 extern u64 secure_dccp_sequence_number(__be32 saddr, __be32 daddr,
 				       __be16 sport, __be16 dport);
 
+/* Pseudo random number generator from numerical recipes. */
+static inline u32 next_pseudo_random32(u32 seed)
+{
+	return seed * 1664525 + 1013904223;
+}
+
 #ifndef MODULE
 extern const struct file_operations random_fops, urandom_fops;
 #endif
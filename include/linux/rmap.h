@@ -195,6 +195,9 @@ enum ttu_flags {
 	TTU_IGNORE_MLOCK = (1 << 8),	/* ignore mlock */
 	TTU_IGNORE_ACCESS = (1 << 9),	/* don't age */
 	TTU_IGNORE_HWPOISON = (1 << 10),/* corrupted page is recoverable */
+	TTU_LAZYFREE = (1 << 11),	/* drop clean MADV_FREE pages */
+	TTU_BATCH_FLUSH = (1 << 12),	/* batch TLB flushes where possible,
+					 * see try_to_unmap_flush() */
 };
 #define TTU_ACTION(x) ((x) & TTU_ACTION_MASK)
 
@@ -360,6 +360,8 @@ extern signed long schedule_timeout_killable(signed long timeout);
 extern signed long schedule_timeout_uninterruptible(signed long timeout);
 asmlinkage void schedule(void);
 extern int mutex_spin_on_owner(struct mutex *lock, struct thread_info *owner);
+extern int rwsem_spin_on_owner(struct rw_semaphore *sem,
+			       struct task_struct *owner);
 
 struct nsproxy;
 struct user_namespace;
@@ -721,6 +723,18 @@ extern struct user_struct root_user;
 struct backing_dev_info;
 struct reclaim_state;
 
+#ifdef CONFIG_ARCH_WANT_BATCHED_UNMAP_TLB_FLUSH
+/*
+ * The CPUs whose TLBs may still cache ptes that reclaim cleared, to be
+ * flushed by try_to_unmap_flush() before the pages are freed or written.
+ */
+struct tlbflush_unmap_batch {
+	struct cpumask cpumask;
+	bool flush_required;	/* some ptes were cleared without a flush */
+	bool writable;		/* some of them were dirty */
+};
+#endif
+
 #if defined(CONFIG_SCHEDSTATS) || defined(CONFIG_TASK_DELAY_ACCT)
 struct sched_info {
 	/* cumulative counters */
@@ -1431,6 +1445,9 @@ struct task_struct {
 
 /* VM state */
 	struct reclaim_state *reclaim_state;
+#ifdef CONFIG_ARCH_WANT_BATCHED_UNMAP_TLB_FLUSH
+	struct tlbflush_unmap_batch tlb_ubc;
+#endif
 
 	struct backing_dev_info *backing_dev_info;
 
@@ -1472,6 +1489,21 @@ struct task_struct {
 #ifdef CONFIG_NUMA
 	struct mempolicy *mempolicy;	/* Protected by alloc_lock */
 	short il_next;
+#endif
+#ifdef CONFIG_NUMA_BALANCING
+	int numa_scan_seq;		/* mm->numa_scan_seq last accounted */
+	int numa_work_pending;		/* task_numa_work() on return to user */
+	unsigned int numa_scan_period;	/* msecs of runtime between scans */
+	u64 node_stamp;			/* runtime at the last scan */
+	int numa_preferred_nid;		/* node most NUMA faults were on */
+	unsigned long numa_pages_migrated; /* since the last placement */
+	/*
+	 * NUMA hinting faults, indexed by the node the memory was on: a
+	 * decaying average over the scans of the mm, and the faults of the
+	 * scan in progress.  Allocated on the first fault.
+	 */
+	unsigned long *numa_faults;
+	unsigned long *numa_faults_buffer;
 #endif
 	atomic_t fs_excl;	/* holding fs exclusive resources */
 	struct rcu_head rcu;
@@ -1965,6 +1997,22 @@ static inline void sched_autogroup_fork(struct signal_struct *sig) { }
 static inline void sched_autogroup_exit(struct signal_struct *sig) { }
 #endif
 
+#ifdef CONFIG_NUMA_BALANCING
+extern unsigned int sysctl_numa_balancing;
+extern unsigned int sysctl_numa_balancing_scan_delay;
+extern unsigned int sysctl_numa_balancing_scan_period_min;
+extern unsigned int sysctl_numa_balancing_scan_period_max;
+extern unsigned int sysctl_numa_balancing_scan_size;
+
+extern void task_numa_fault(int node, int pages, bool migrated);
+extern void task_numa_work(void);
+extern void task_numa_free(struct task_struct *p);
+#else
+static inline void task_numa_fault(int node, int pages, bool migrated) { }
+static inline void task_numa_work(void) { }
+static inline void task_numa_free(struct task_struct *p) { }
+#endif
+
 #ifdef CONFIG_RT_MUTEXES
 extern int rt_mutex_getprio(struct task_struct *p);
 extern void rt_mutex_setprio(struct task_struct *p, int prio);
@@ -32,6 +32,7 @@ struct shmem_sb_info {
 	gid_t gid;		    /* Mount gid for root directory */
 	mode_t mode;		    /* Mount mode for root directory */
 	struct mempolicy *mpol;     /* default memory policy for mappings */
+	int huge;		    /* Whether to allocate huge pages */
 };
 
 static inline struct shmem_inode_info *SHMEM_I(struct inode *inode)
@@ -42,4 +43,25 @@ static inline struct shmem_inode_info *SHMEM_I(struct inode *inode)
 extern int init_tmpfs(void);
 extern int shmem_fill_super(struct super_block *sb, void *data, int silent);
 
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+extern unsigned long shmem_get_unmapped_area(struct file *file,
+		unsigned long addr, unsigned long len, unsigned long pgoff,
+		unsigned long flags);
+#endif
+
+#if defined(CONFIG_SHMEM) && defined(CONFIG_TRANSPARENT_HUGEPAGE)
+extern struct kobj_attribute shmem_enabled_attr;
+extern bool shmem_huge_enabled(struct vm_area_struct *vma);
+extern bool shmem_collapse_huge(struct file *file, pgoff_t index);
+#else
+static inline bool shmem_huge_enabled(struct vm_area_struct *vma)
+{
+	return false;
+}
+static inline bool shmem_collapse_huge(struct file *file, pgoff_t index)
+{
+	return false;
+}
+#endif
+
 #endif
@@ -11,6 +11,7 @@
 #include <linux/init.h>
 #include <linux/jiffies.h>
 #include <linux/spinlock.h>
+#include <linux/tcp.h>
 #include <net/ipv6.h>
 #include <asm/atomic.h>
 
@@ -33,7 +34,7 @@ struct inet_peer {
 	atomic_t		refcnt;
 	/*
 	 * Once inet_peer is queued for deletion (refcnt == -1), following fields
-	 * are not available: rid, ip_id_count, tcp_ts, tcp_ts_stamp
+	 * are not available: rid, ip_id_count, tcp_ts, tcp_ts_stamp, tcp_fastopen_*
 	 * We can share memory with rcu_head to keep inet_peer small
 	 */
 	union {
@@ -42,6 +43,11 @@ struct inet_peer {
 			atomic_t	ip_id_count;	/* IP ID for the next packet */
 			__u32		tcp_ts;
 			__u32		tcp_ts_stamp;
+			/* TCP Fast Open client state, see tcp_fastopen.c */
+			__u16		tcp_fastopen_mss;
+			__u16		tcp_fastopen_syn_loss;
+			unsigned long	tcp_fastopen_syn_loss_ts;
+			struct tcp_fastopen_cookie tcp_fastopen_cookie;
 		};
 		struct rcu_head         rcu;
 	};
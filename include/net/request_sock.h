@@ -128,6 +128,27 @@ struct request_sock_queue {
 	u8			rskq_defer_accept;
 	/* 3 bytes hole, try to pack */
 	struct listen_sock	*listen_opt;
+	struct fastopen_queue	*fastopenq; /* This is non-NULL iff TFO has been
+					     * enabled on this listener. Check
+					     * max_qlen != 0 to determine if
+					     * TFO is enabled right now.
+					     */
+};
+
+/** struct fastopen_queue - queue of TCP Fast Open children
+ *
+ * @lock - protects qlen and the listener pointer of the request socks
+ * @qlen - # of children still in TCP_SYN_RECV
+ * @max_qlen - upper bound on @qlen, 0 disables Fast Open on the listener
+ *
+ * A Fast Open child is created and queued for accept() right on the SYN.
+ * Its request_sock stays alive until the 3WHS completes (see
+ * reqsk_fastopen_remove()), possibly after the child has been accepted.
+ */
+struct fastopen_queue {
+	spinlock_t	lock;
+	int		qlen;
+	int		max_qlen;
 };
 
 extern int reqsk_queue_alloc(struct request_sock_queue *queue,
@@ -135,6 +156,8 @@ extern int reqsk_queue_alloc(struct request_sock_queue *queue,
 
 extern void __reqsk_queue_destroy(struct request_sock_queue *queue);
 extern void reqsk_queue_destroy(struct request_sock_queue *queue);
+extern void reqsk_fastopen_remove(struct sock *sk,
+				  struct request_sock *req);
 
 static inline struct request_sock *
 	reqsk_queue_yank_acceptq(struct request_sock_queue *queue)
@@ -59,6 +59,9 @@
 #include <linux/magic.h>
 #include <linux/pid.h>
 #include <linux/nsproxy.h>
+#include <linux/bootmem.h>
+#include <linux/vmalloc.h>
+#include <linux/log2.h>
 
 #include <asm/futex.h>
 
@@ -66,8 +69,6 @@
 
 int __read_mostly futex_cmpxchg_enabled;
 
-#define FUTEX_HASHBITS (CONFIG_BASE_SMALL ? 4 : 8)
-
 /*
  * Futex flags used to encode options to functions and preserve them across
  * restarts.
@@ -141,13 +142,96 @@ static const struct futex_q futex_q_init = {
  * Hash buckets are shared by all the futex_keys that hash to the same
  * location.  Each key may have multiple futex_q structures, one for each task
  * waiting on a futex.
+ *
+ * waiters counts the tasks queued or about to queue on the bucket, so that
+ * futex_wake() can tell there is nobody to wake without taking the lock.
+ * A waiter increments it before it takes the lock and reads the futex
+ * value, and a waker reads it after the futex value was changed:
+ *
+ * waiter				waker
+ *
+ * waiters++				*futex = newval;
+ * smp_mb(); (A)			sys_futex(WAKE, futex);
+ * lock(hb->lock);			  smp_mb(); (B)
+ * uval = *futex;			  if (!waiters)
+ * if (uval == val)			    return;
+ *   queue_me(); sleep;			  lock(hb->lock); wake
+ *
+ * With the barriers, either the waker sees the waiter, or the waiter
+ * sees the new value and does not sleep.
  */
 struct futex_hash_bucket {
+	atomic_t waiters;
 	spinlock_t lock;
 	struct plist_head chain;
+} ____cacheline_aligned_in_smp;
+
+static unsigned long __read_mostly futex_hashsize;
+static struct futex_hash_bucket *futex_queues __read_mostly;
+
+/*
+ * The table a process can ask for with prctl(PR_SET_FUTEX_HASH), to hash
+ * its private futexes in, instead of sharing the buckets of the global
+ * table with every other process.
+ */
+struct futex_private_hash {
+	unsigned long hashsize;
+	struct futex_hash_bucket queues[0];
 };
 
-static struct futex_hash_bucket futex_queues[1<<FUTEX_HASHBITS];
+/*
+ * The private table is not charged to anyone: without CAP_SYS_RESOURCE,
+ * keep it to a few pages.  Larger tables, up to the size of the global
+ * one, are for the administrator to hand out.
+ */
+#define FUTEX_PRIVATE_HASH_MAX	256
+
+static inline void hb_waiters_inc(struct futex_hash_bucket *hb)
+{
+#ifdef CONFIG_SMP
+	atomic_inc(&hb->waiters);
+	/*
+	 * Full barrier (A), see the ordering comment above.
+	 */
+	smp_mb__after_atomic_inc();
+#endif
+}
+
+/*
+ * Reflects a waiter being removed from the waitqueue by wakeup
+ * paths, or giving up before it queued.
+ */
+static inline void hb_waiters_dec(struct futex_hash_bucket *hb)
+{
+#ifdef CONFIG_SMP
+	atomic_dec(&hb->waiters);
+#endif
+}
+
+static inline int hb_waiters_pending(struct futex_hash_bucket *hb)
+{
+#ifdef CONFIG_SMP
+	/*
+	 * Full barrier (B), see the ordering comment above.
+	 */
+	smp_mb();
+	return atomic_read(&hb->waiters);
+#else
+	return 1;
+#endif
+}
+
+static void futex_hash_init(struct futex_hash_bucket *queues,
+			    unsigned long hashsize)
+{
+	unsigned long i;
+
+	for (i = 0; i < hashsize; i++) {
+		atomic_set(&queues[i].waiters, 0);
+		plist_head_init(&queues[i].chain, &queues[i].lock);
+		spin_lock_init(&queues[i].lock);
+	}
+}
 
 /*
  * We hash on the keys returned from get_futex_key (see below).
@@ -157,7 +241,18 @@ static struct futex_hash_bucket *hash_futex(union futex_key *key)
 	u32 hash = jhash2((u32*)&key->both.word,
 			  (sizeof(key->both.word)+sizeof(key->both.ptr))/4,
 			  key->both.offset);
-	return &futex_queues[hash & ((1 << FUTEX_HASHBITS)-1)];
+
+	/*
+	 * Private futexes go to the table of their process, if it has one.
+	 */
+	if (!(key->both.offset & (FUT_OFF_INODE|FUT_OFF_MMSHARED)) &&
+	    key->private.mm && key->private.mm->futex_hash) {
+		struct futex_private_hash *fph = key->private.mm->futex_hash;
+
+		return &fph->queues[hash & (fph->hashsize - 1)];
+	}
+
+	return &futex_queues[hash & (futex_hashsize - 1)];
 }
 
 /*
@@ -775,6 +870,24 @@ retry:
 	return ret;
 }
 
+/**
+ * __unqueue_futex() - Remove the futex_q from its futex_hash_bucket
+ * @q:	The futex_q to unqueue
+ *
+ * The q->lock_ptr must not be NULL and must be held by the caller.
+ */
+static void __unqueue_futex(struct futex_q *q)
+{
+	struct futex_hash_bucket *hb;
+
+	if (WARN_ON(!q->lock_ptr) || WARN_ON(plist_node_empty(&q->list)))
+		return;
+
+	hb = container_of(q->lock_ptr, struct futex_hash_bucket, lock);
+	plist_del(&q->list, &hb->chain);
+	hb_waiters_dec(hb);
+}
+
 /*
  * The hash bucket lock must be held when this is called.
  * Afterwards, the futex_q must not be accessed.
@@ -792,7 +905,7 @@ static void wake_futex(struct futex_q *q)
 	 */
 	get_task_struct(p);
 
-	plist_del(&q->list, &q->list.plist);
+	__unqueue_futex(q);
 	/*
 	 * The waiting task can free the futex_q as soon as
 	 * q->lock_ptr = NULL is written, without taking any locks. A
@@ -934,6 +1047,11 @@ futex_wake(u32 __user *uaddr, unsigned int flags, int nr_wake, u32 bitset)
 		goto out;
 
 	hb = hash_futex(&key);
+
+	/* Make sure we really have tasks to wakeup */
+	if (!hb_waiters_pending(hb))
+		goto out_put_key;
+
 	spin_lock(&hb->lock);
 	head = &hb->chain;
 
@@ -955,6 +1073,7 @@ futex_wake(u32 __user *uaddr, unsigned int flags, int nr_wake, u32 bitset)
 	}
 
 	spin_unlock(&hb->lock);
+out_put_key:
 	put_futex_key(&key);
 out:
 	return ret;
@@ -1069,6 +1188,8 @@ void requeue_futex(struct futex_q *q, struct futex_hash_bucket *hb1,
 	 */
 	if (likely(&hb1->chain != &hb2->chain)) {
 		plist_del(&q->list, &hb1->chain);
+		hb_waiters_dec(hb1);
+		hb_waiters_inc(hb2);
 		plist_add(&q->list, &hb2->chain);
 		q->lock_ptr = &hb2->lock;
 #ifdef CONFIG_DEBUG_PI_LIST
@@ -1100,8 +1221,7 @@ void requeue_pi_wake_futex(struct futex_q *q, union futex_key *key,
 	get_futex_key_refs(key);
 	q->key = *key;
 
-	WARN_ON(plist_node_empty(&q->list));
-	plist_del(&q->list, &q->list.plist);
+	__unqueue_futex(q);
 
 	WARN_ON(!q->rt_waiter);
 	q->rt_waiter = NULL;
@@ -1416,6 +1536,17 @@ static inline struct futex_hash_bucket *queue_lock(struct futex_q *q)
 	struct futex_hash_bucket *hb;
 
 	hb = hash_futex(&q->key);
+
+	/*
+	 * Increment the counter before taking the lock so that
+	 * a potential waker won't miss a to-be-slept task that is
+	 * waiting for the spinlock. This is safe as all queue_lock()
+	 * users end up calling queue_me(). Similarly, for housekeeping,
+	 * decrement the counter at queue_unlock() when some error has
+	 * occurred and we don't end up adding the task to the list.
+	 */
+	hb_waiters_inc(hb);
+
 	q->lock_ptr = &hb->lock;
 
 	spin_lock(&hb->lock);
@@ -1427,6 +1558,7 @@ queue_unlock(struct futex_q *q, struct futex_hash_bucket *hb)
 	__releases(&hb->lock)
 {
 	spin_unlock(&hb->lock);
+	hb_waiters_dec(hb);
 }
 
 /**
@@ -1504,8 +1636,7 @@ retry:
 			spin_unlock(lock_ptr);
 			goto retry;
 		}
-		WARN_ON(plist_node_empty(&q->list));
-		plist_del(&q->list, &q->list.plist);
+		__unqueue_futex(q);
 
 		BUG_ON(q->pi_state);
 
@@ -1525,8 +1656,7 @@ retry:
 static void unqueue_me_pi(struct futex_q *q)
 	__releases(q->lock_ptr)
 {
-	WARN_ON(plist_node_empty(&q->list));
-	plist_del(&q->list, &q->list.plist);
+	__unqueue_futex(q);
 
 	BUG_ON(!q->pi_state);
 	free_pi_state(q->pi_state);
@@ -2167,7 +2297,7 @@ int handle_early_requeue_pi_wakeup(struct futex_hash_bucket *hb,
 		 * We were woken prior to requeue by a timeout or a signal.
 		 * Unqueue the futex_q and determine which it was.
 		 */
-		plist_del(&q->list, &q->list.plist);
+		__unqueue_futex(q);
 
 		/* Handle spurious wakeups gracefully */
 		ret = -EWOULDBLOCK;
@@ -2663,10 +2793,103 @@ SYSCALL_DEFINE6(futex, u32 __user *, uaddr, int, op, u32, val,
 	return do_futex(uaddr, op, val, tp, uaddr2, val2, val3);
 }
 
+static void futex_private_hash_free(struct futex_private_hash *fph)
+{
+	if (is_vmalloc_addr(fph))
+		vfree(fph);
+	else
+		kfree(fph);
+}
+
+/**
+ * futex_set_private_hash() - Give the process its own private futex table
+ * @hashsize:	number of hash buckets, a power of two, 0 for the global table
+ *
+ * More than FUTEX_PRIVATE_HASH_MAX buckets needs CAP_SYS_RESOURCE.
+ * Only possible while the process is single-threaded: with no other
+ * thread, no private futex of the process can have a waiter queued, so
+ * the table can be switched under its futexes.
+ */
+int futex_set_private_hash(unsigned long hashsize)
+{
+	struct mm_struct *mm = current->mm;
+	struct futex_private_hash *fph = NULL;
+	unsigned long size;
+
+	if (hashsize && (!is_power_of_2(hashsize) || hashsize > futex_hashsize))
+		return -EINVAL;
+	if (hashsize > FUTEX_PRIVATE_HASH_MAX && !capable(CAP_SYS_RESOURCE))
+		return -EPERM;
+
+	if (!mm || atomic_read(&mm->mm_users) != 1)
+		return -EBUSY;
+
+	if (hashsize) {
+		size = sizeof(*fph) + hashsize * sizeof(fph->queues[0]);
+		if (size > PAGE_SIZE)
+			fph = vmalloc(size);
+		else
+			fph = kmalloc(size, GFP_KERNEL);
+		if (!fph)
+			return -ENOMEM;
+
+		fph->hashsize = hashsize;
+		futex_hash_init(fph->queues, hashsize);
+	}
+
+	if (mm->futex_hash)
+		futex_private_hash_free(mm->futex_hash);
+	mm->futex_hash = fph;
+
+	return 0;
+}
+
+/**
+ * futex_get_private_hash() - Size of the process's private futex table
+ *
+ * Returns 0 when the private futexes of the process use the global table.
+ */
+unsigned long futex_get_private_hash(void)
+{
+	struct mm_struct *mm = current->mm;
+
+	if (!mm || !mm->futex_hash)
+		return 0;
+	return mm->futex_hash->hashsize;
+}
+
+/*
+ * Called when the last user of the mm is gone, with it all the tasks that
+ * could use its private futexes.
+ */
+void futex_mm_release(struct mm_struct *mm)
+{
+	if (mm->futex_hash) {
+		futex_private_hash_free(mm->futex_hash);
+		mm->futex_hash = NULL;
+	}
+}
+
 static int __init futex_init(void)
 {
+	unsigned int futex_shift;
 	u32 curval;
-	int i;
+
+	/*
+	 * The more CPUs, the more tasks can wait on futexes at once, and
+	 * the more unrelated futexes collide in a bucket.
+	 */
+#if CONFIG_BASE_SMALL
+	futex_hashsize = 16;
+#else
+	futex_hashsize = roundup_pow_of_two(256 * num_possible_cpus());
+#endif
+
+	futex_queues = alloc_large_system_hash("futex", sizeof(*futex_queues),
+					       futex_hashsize, 0, 0,
+					       &futex_shift, NULL,
+					       futex_hashsize);
+	futex_hashsize = 1UL << futex_shift;
 
 	/*
 	 * This will fail and we want it. Some arch implementations do
@@ -2682,10 +2905,7 @@ static int __init futex_init(void)
 	if (curval == -EFAULT)
 		futex_cmpxchg_enabled = 1;
 
-	for (i = 0; i < ARRAY_SIZE(futex_queues); i++) {
-		plist_head_init(&futex_queues[i].chain, &futex_queues[i].lock);
-		spin_lock_init(&futex_queues[i].lock);
-	}
+	futex_hash_init(futex_queues, futex_hashsize);
 
 	return 0;
 }
@@ -216,6 +216,9 @@ struct lock_class_stats lock_stats(struct lock_class *class)
 
 		for (i = 0; i < ARRAY_SIZE(stats.bounces); i++)
 			stats.bounces[i] += pcs->bounces[i];
+
+		for (i = 0; i < ARRAY_SIZE(stats.spin_acquisitions); i++)
+			stats.spin_acquisitions[i] += pcs->spin_acquisitions[i];
 	}
 
 	return stats;
@@ -3399,6 +3402,43 @@ found_it:
 	lock->ip = ip;
 }
 
+static void
+__lock_spin_acquired(struct lockdep_map *lock)
+{
+	struct task_struct *curr = current;
+	struct held_lock *hlock, *prev_hlock;
+	struct lock_class_stats *stats;
+	unsigned int depth;
+	int i;
+
+	depth = curr->lockdep_depth;
+	if (DEBUG_LOCKS_WARN_ON(!depth))
+		return;
+
+	prev_hlock = NULL;
+	for (i = depth-1; i >= 0; i--) {
+		hlock = curr->held_locks + i;
+		/*
+		 * We must not cross into another context:
+		 */
+		if (prev_hlock && prev_hlock->irq_context != hlock->irq_context)
+			break;
+		if (match_held_lock(hlock, lock))
+			goto found_it;
+		prev_hlock = hlock;
+	}
+	print_lock_contention_bug(curr, lock, _RET_IP_);
+	return;
+
+found_it:
+	if (hlock->instance != lock)
+		return;
+
+	stats = get_lock_stats(hlock_class(hlock));
+	stats->spin_acquisitions[!!hlock->read]++;
+	put_lock_stats(stats);
+}
+
 void lock_contended(struct lockdep_map *lock, unsigned long ip)
 {
 	unsigned long flags;
@@ -3437,6 +3477,29 @@ void lock_acquired(struct lockdep_map *lock, unsigned long ip)
 	raw_local_irq_restore(flags);
 }
 EXPORT_SYMBOL_GPL(lock_acquired);
+
+/*
+ * The contended lock was acquired by spinning on its running owner,
+ * rather than by sleeping until it was released.
+ */
+void lock_spin_acquired(struct lockdep_map *lock)
+{
+	unsigned long flags;
+
+	if (unlikely(!lock_stat))
+		return;
+
+	if (unlikely(current->lockdep_recursion))
+		return;
+
+	raw_local_irq_save(flags);
+	check_flags(flags);
+	current->lockdep_recursion = 1;
+	__lock_spin_acquired(lock);
+	current->lockdep_recursion = 0;
+	raw_local_irq_restore(flags);
+}
+EXPORT_SYMBOL_GPL(lock_spin_acquired);
 #endif
 
 /*
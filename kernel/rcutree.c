@@ -54,7 +54,7 @@
 
 static struct lock_class_key rcu_node_class[NUM_RCU_LVLS];
 
-#define RCU_STATE_INITIALIZER(structname) { \
+#define RCU_STATE_INITIALIZER(structname, sabbr, cr) { \
 	.level = { &structname.node[0] }, \
 	.levelcnt = { \
 		NUM_RCU_LVL_0,  /* root of hierarchy. */ \
@@ -71,12 +71,16 @@ static struct lock_class_key rcu_node_class[NUM_RCU_LVLS];
 	.n_force_qs = 0, \
 	.n_force_qs_ngp = 0, \
 	.name = #structname, \
+	.abbr = sabbr, \
+	.call = cr, \
 }
 
-struct rcu_state rcu_sched_state = RCU_STATE_INITIALIZER(rcu_sched_state);
+struct rcu_state rcu_sched_state =
+	RCU_STATE_INITIALIZER(rcu_sched_state, 's', call_rcu_sched);
 DEFINE_PER_CPU(struct rcu_data, rcu_sched_data);
 
-struct rcu_state rcu_bh_state = RCU_STATE_INITIALIZER(rcu_bh_state);
+struct rcu_state rcu_bh_state =
+	RCU_STATE_INITIALIZER(rcu_bh_state, 'b', call_rcu_bh);
 DEFINE_PER_CPU(struct rcu_data, rcu_bh_data);
 
 int rcu_scheduler_active __read_mostly;
@@ -1015,7 +1019,7 @@ static void rcu_send_cbs_to_online(struct rcu_state *rsp)
 {
 	int i;
 	/* current DYING CPU is cleared in the cpu_online_mask */
-	int receive_cpu = cpumask_any(cpu_online_mask);
+	int receive_cpu = rcu_nocb_adopting_cpu();
 	struct rcu_data *rdp = this_cpu_ptr(rsp->rda);
 	struct rcu_data *receive_rdp = per_cpu_ptr(rsp->rda, receive_cpu);
 
@@ -1436,6 +1440,12 @@ __call_rcu(struct rcu_head *head, void (*func)(struct rcu_head *rcu),
 	local_irq_save(flags);
 	rdp = this_cpu_ptr(rsp->rda);
 
+	/* Hand the callback to the kthread of a no-CBs CPU. */
+	if (__call_rcu_nocb(rdp, head)) {
+		local_irq_restore(flags);
+		return;
+	}
+
 	/* Add the callback to our list. */
 	*rdp->nxttail[RCU_NEXT_TAIL] = head;
 	rdp->nxttail[RCU_NEXT_TAIL] = &head->next;
@@ -1674,6 +1684,9 @@ static void rcu_barrier_func(void *type)
 	void (*call_rcu_func)(struct rcu_head *head,
 			      void (*func)(struct rcu_head *head));
 
+	/* See rcu_barrier_nocb() */
+	if (is_nocb_cpu(cpu))
+		return;
 	atomic_inc(&rcu_barrier_cpu_count);
 	call_rcu_func = type;
 	call_rcu_func(head, rcu_barrier_callback);
@@ -1700,10 +1713,12 @@ static void _rcu_barrier(struct rcu_state *rsp,
 	 * did their increment, causing this function to return too
 	 * early.  Note that on_each_cpu() disables irqs, which prevents
 	 * any CPUs from coming online or going offline until each online
-	 * CPU has queued its RCU-barrier callback.
+	 * CPU has queued its RCU-barrier callback.  No-CBs CPUs get theirs
+	 * queued directly, whether they are online or not.
 	 */
 	atomic_set(&rcu_barrier_cpu_count, 1);
 	on_each_cpu(rcu_barrier_func, (void *)call_rcu_func, 1);
+	rcu_barrier_nocb(rsp);
 	if (atomic_dec_and_test(&rcu_barrier_cpu_count))
 		complete(&rcu_barrier_completion);
 	wait_for_completion(&rcu_barrier_completion);
@@ -1750,6 +1765,8 @@ rcu_boot_init_percpu_data(int cpu, struct rcu_state *rsp)
 	rdp->dynticks = &per_cpu(rcu_dynticks, cpu);
 #endif /* #ifdef CONFIG_NO_HZ */
 	rdp->cpu = cpu;
+	rdp->rsp = rsp;
+	rcu_boot_init_nocb_percpu_data(rdp);
 	raw_spin_unlock_irqrestore(&rnp->lock, flags);
 }
 
@@ -1826,6 +1843,12 @@ static int __cpuinit rcu_cpu_notify(struct notifier_block *self,
 	case CPU_UP_PREPARE_FROZEN:
 		rcu_online_cpu(cpu);
 		break;
+	case CPU_DOWN_PREPARE:
+	case CPU_DOWN_PREPARE_FROZEN:
+		/* No-CBs CPUs need another CPU to start grace periods. */
+		if (!nocb_cpu_expendable(cpu))
+			return NOTIFY_BAD;
+		break;
 	case CPU_DYING:
 	case CPU_DYING_FROZEN:
 		/*
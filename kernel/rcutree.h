@@ -239,7 +239,20 @@ struct rcu_data {
 	unsigned long n_rp_need_fqs;
 	unsigned long n_rp_need_nothing;
 
+#ifdef CONFIG_RCU_NOCB_CPU
+	/* 6) Callback offloading. */
+	struct rcu_head *nocb_head;	/* CBs waiting for kthread. */
+	struct rcu_head **nocb_tail;
+	atomic_long_t nocb_q_count;	/* # CBs waiting for kthread. */
+	long nocb_p_count;		/* # CBs being invoked by kthread. */
+	wait_queue_head_t nocb_wq;	/* For nocb kthreads to sleep on. */
+	struct task_struct *nocb_kthread;
+	unsigned long n_nocb_gps;	/* # GPs waited for by kthread. */
+	unsigned long n_nocbs_invoked;	/* # CBs invoked by kthread. */
+#endif /* #ifdef CONFIG_RCU_NOCB_CPU */
+
 	int cpu;
+	struct rcu_state *rsp;
 };
 
 /* Values for signaled field in struct rcu_state. */
@@ -332,6 +345,9 @@ struct rcu_state {
 						/*  for CPU stalls. */
 #endif /* #ifdef CONFIG_RCU_CPU_STALL_DETECTOR */
 	char *name;				/* Name of structure. */
+	char abbr;				/* Abbreviated name. */
+	void (*call)(struct rcu_head *head,	/* call_rcu() flavor. */
+		     void (*func)(struct rcu_head *head));
 };
 
 /* Return values for rcu_preempt_offline_tasks(). */
@@ -390,5 +406,11 @@ static void __cpuinit rcu_preempt_init_percpu_data(int cpu);
 static void rcu_preempt_send_cbs_to_online(void);
 static void __init __rcu_init_preempt(void);
 static void rcu_needs_cpu_flush(void);
+static bool is_nocb_cpu(int cpu);
+static bool __call_rcu_nocb(struct rcu_data *rdp, struct rcu_head *rhp);
+static void rcu_barrier_nocb(struct rcu_state *rsp);
+static bool nocb_cpu_expendable(int cpu);
+static int rcu_nocb_adopting_cpu(void);
+static void __init rcu_boot_init_nocb_percpu_data(struct rcu_data *rdp);
 
 #endif /* #ifndef RCU_TREE_NONCORE */
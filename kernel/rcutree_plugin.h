@@ -26,6 +26,7 @@
 
 #include <linux/delay.h>
 #include <linux/stop_machine.h>
+#include <linux/kthread.h>
 
 /*
  * Check the RCU kernel configuration parameters and print informative
@@ -68,7 +69,8 @@ static void __init rcu_bootup_announce_oddness(void)
 
 #ifdef CONFIG_TREE_PREEMPT_RCU
 
-struct rcu_state rcu_preempt_state = RCU_STATE_INITIALIZER(rcu_preempt_state);
+struct rcu_state rcu_preempt_state =
+	RCU_STATE_INITIALIZER(rcu_preempt_state, 'p', call_rcu);
 DEFINE_PER_CPU(struct rcu_data, rcu_preempt_data);
 
 static int rcu_preempted_readers_exp(struct rcu_node *rnp);
@@ -1260,3 +1262,304 @@ static void rcu_needs_cpu_flush(void)
 }
 
 #endif /* #else #if !defined(CONFIG_RCU_FAST_NO_HZ) */
+
+#ifdef CONFIG_RCU_NOCB_CPU
+
+/*
+ * Offload callback invocation from the CPUs named by the rcu_nocbs=
+ * boot parameter.  The callbacks that such a no-CBs CPU queues do not
+ * go on its rcu_data lists, but to a kthread per CPU and RCU flavor,
+ * which waits for a grace period and then invokes them.  The kthreads
+ * run on the other CPUs by default, and can be moved wherever the
+ * administrator sees fit, so that the no-CBs CPUs are spared the
+ * softirq invocation of large batches of callbacks.
+ *
+ * The no-CBs CPUs still report quiescent states as usual, but having no
+ * callbacks of their own they never start grace periods.  Instead, the
+ * kthreads have a CPU that is not a no-CBs CPU register the callback
+ * they wait on, so there must always be one of those online.  CPU 0
+ * cannot be a no-CBs CPU.
+ */
+
+static cpumask_var_t rcu_nocb_mask; /* CPUs to have callbacks offloaded. */
+static bool have_rcu_nocb_mask;	    /* Was rcu_nocb_mask allocated? */
+
+/* Parse the boot-time rcu_nocbs= CPU list. */
+static int __init rcu_nocb_setup(char *str)
+{
+	char buf[128];
+
+	alloc_bootmem_cpumask_var(&rcu_nocb_mask);
+	have_rcu_nocb_mask = true;
+	cpulist_parse(str, rcu_nocb_mask);
+	if (cpumask_test_cpu(0, rcu_nocb_mask)) {
+		printk(KERN_WARNING "RCU: CPU 0 cannot be a no-CBs CPU.\n");
+		cpumask_clear_cpu(0, rcu_nocb_mask);
+	}
+	cpulist_scnprintf(buf, sizeof(buf), rcu_nocb_mask);
+	printk(KERN_INFO "RCU: offloading callbacks from CPUs %s.\n", buf);
+	return 1;
+}
+__setup("rcu_nocbs=", rcu_nocb_setup);
+
+/* Is the specified CPU a no-CBs CPU? */
+static bool is_nocb_cpu(int cpu)
+{
+	if (have_rcu_nocb_mask)
+		return cpumask_test_cpu(cpu, rcu_nocb_mask);
+	return false;
+}
+
+/*
+ * Hand a callback queued on a no-CBs CPU to the kthread of that CPU,
+ * and wake the kthread up if its list was empty.  Returns false if the
+ * CPU is not a no-CBs CPU, leaving the callback to the caller.
+ *
+ * The callback is appended with an xchg() of the tail pointer, so that
+ * the kthread can take the list over without excluding call_rcu(): it
+ * waits for the link to the callback if it sees the new tail first.
+ */
+static bool __call_rcu_nocb(struct rcu_data *rdp, struct rcu_head *rhp)
+{
+	struct rcu_head **old_rhpp;
+
+	if (!is_nocb_cpu(rdp->cpu))
+		return false;
+
+	old_rhpp = xchg(&rdp->nocb_tail, &rhp->next);
+	ACCESS_ONCE(*old_rhpp) = rhp;
+	atomic_long_inc(&rdp->nocb_q_count);
+
+	/* The kthread picks up what was queued before it was spawned. */
+	if (old_rhpp == &rdp->nocb_head && ACCESS_ONCE(rdp->nocb_kthread))
+		wake_up(&rdp->nocb_wq);
+	return true;
+}
+
+/*
+ * Queue an rcu_barrier() callback on the list of each no-CBs CPU, online
+ * or not: the kthread of an offline one may still hold callbacks, which
+ * rcu_barrier_func() running on the online CPUs would not wait for.
+ */
+static void rcu_barrier_nocb(struct rcu_state *rsp)
+{
+	struct rcu_head *head;
+	int cpu;
+
+	if (!have_rcu_nocb_mask)
+		return;
+	for_each_cpu(cpu, rcu_nocb_mask) {
+		if (!cpu_possible(cpu))
+			continue;
+		head = &per_cpu(rcu_barrier_head, cpu);
+		debug_rcu_head_queue(head);
+		head->func = rcu_barrier_callback;
+		head->next = NULL;
+		atomic_inc(&rcu_barrier_cpu_count);
+		__call_rcu_nocb(per_cpu_ptr(rsp->rda, cpu), head);
+	}
+}
+
+/*
+ * Refuse to offline the last online CPU that is not a no-CBs CPU, as
+ * the no-CBs kthreads need one to register their callbacks.
+ */
+static bool nocb_cpu_expendable(int cpu)
+{
+	int i;
+
+	if (!have_rcu_nocb_mask || is_nocb_cpu(cpu))
+		return true;
+	for_each_online_cpu(i)
+		if (i != cpu && !is_nocb_cpu(i))
+			return true;
+	return false;
+}
+
+/*
+ * Pick an online CPU to take over callbacks, preferring one that is
+ * not a no-CBs CPU, which would otherwise invoke them from softirq.
+ */
+static int rcu_nocb_adopting_cpu(void)
+{
+	int cpu;
+
+	if (have_rcu_nocb_mask)
+		for_each_online_cpu(cpu)
+			if (!is_nocb_cpu(cpu))
+				return cpu;
+	return cpumask_any(cpu_online_mask);
+}
+
+/* A callback to register on another CPU with smp_call_function_single(). */
+struct rcu_head_remote {
+	struct rcu_head *rhp;
+	void (*crf)(struct rcu_head *rhp, void (*func)(struct rcu_head *rhp));
+	void (*func)(struct rcu_head *rhp);
+};
+
+static void call_rcu_local(void *arg)
+{
+	struct rcu_head_remote *rhrp = arg;
+
+	rhrp->crf(rhrp->rhp, rhrp->func);
+}
+
+/*
+ * Wait for a grace period of the flavor of the specified rcu_data.  The
+ * callback that ends the wait is registered on a CPU that is not a
+ * no-CBs CPU: queued from a no-CBs CPU, it could end up on the list of
+ * this very kthread.  Disabling preemption keeps that CPU online until
+ * the callback is registered.
+ */
+static void rcu_nocb_wait_gp(struct rcu_data *rdp)
+{
+	struct rcu_synchronize rcu;
+	struct rcu_head_remote rhr;
+
+	init_rcu_head_on_stack(&rcu.head);
+	init_completion(&rcu.completion);
+	rhr.rhp = &rcu.head;
+	rhr.crf = rdp->rsp->call;
+	rhr.func = wakeme_after_rcu;
+
+	preempt_disable();
+	smp_call_function_single(rcu_nocb_adopting_cpu(), call_rcu_local,
+				 &rhr, 1);
+	preempt_enable();
+
+	wait_for_completion(&rcu.completion);
+	destroy_rcu_head_on_stack(&rcu.head);
+	rdp->n_nocb_gps++;
+}
+
+/*
+ * Per-rcu_data kthread, but only for no-CBs CPUs.  Each pass through
+ * the loop takes all the callbacks queued so far, waits for a grace
+ * period, and invokes them.
+ */
+static int rcu_nocb_kthread(void *arg)
+{
+	struct rcu_data *rdp = arg;
+	struct rcu_head *list;
+	struct rcu_head *next;
+	struct rcu_head **tail;
+	long c;
+
+	for (;;) {
+		wait_event_interruptible(rdp->nocb_wq,
+					 ACCESS_ONCE(rdp->nocb_head));
+		list = ACCESS_ONCE(rdp->nocb_head);
+		if (!list)
+			continue;
+
+		/* Take over the queued callbacks and wait for a GP. */
+		ACCESS_ONCE(rdp->nocb_head) = NULL;
+		tail = xchg(&rdp->nocb_tail, &rdp->nocb_head);
+		c = atomic_long_xchg(&rdp->nocb_q_count, 0);
+		ACCESS_ONCE(rdp->nocb_p_count) += c;
+		rcu_nocb_wait_gp(rdp);
+
+		/* Invoke them, with bh disabled as in rcu_do_batch(). */
+		c = 0;
+		while (list) {
+			next = list->next;
+			/* Wait for call_rcu() to link in the next one. */
+			while (next == NULL && &list->next != tail) {
+				schedule_timeout_interruptible(1);
+				next = ACCESS_ONCE(list->next);
+			}
+			debug_rcu_head_unqueue(list);
+			local_bh_disable();
+			list->func(list);
+			local_bh_enable();
+			list = next;
+			c++;
+			cond_resched();
+		}
+		ACCESS_ONCE(rdp->nocb_p_count) -= c;
+		rdp->n_nocbs_invoked += c;
+	}
+	return 0;
+}
+
+/* Initialize the no-CBs state of a CPU's rcu_data at boot. */
+static void __init rcu_boot_init_nocb_percpu_data(struct rcu_data *rdp)
+{
+	rdp->nocb_tail = &rdp->nocb_head;
+	init_waitqueue_head(&rdp->nocb_wq);
+}
+
+/*
+ * Create the kthreads of the no-CBs CPUs for the specified flavor, and
+ * allow them on the other CPUs only.
+ */
+static void __init rcu_spawn_nocb_kthreads(struct rcu_state *rsp,
+					   const struct cpumask *cpus)
+{
+	int cpu;
+	struct rcu_data *rdp;
+	struct task_struct *t;
+
+	for_each_cpu(cpu, rcu_nocb_mask) {
+		if (!cpu_possible(cpu))
+			continue;
+		rdp = per_cpu_ptr(rsp->rda, cpu);
+		t = kthread_create(rcu_nocb_kthread, rdp,
+				   "rcuo%c/%d", rsp->abbr, cpu);
+		BUG_ON(IS_ERR(t));
+		set_cpus_allowed_ptr(t, cpus);
+		ACCESS_ONCE(rdp->nocb_kthread) = t;
+		wake_up_process(t);
+	}
+}
+
+static struct cpumask rcu_nocb_housekeeping_mask __initdata;
+
+static int __init rcu_nocb_init(void)
+{
+	struct cpumask *cpus = &rcu_nocb_housekeeping_mask;
+
+	if (!have_rcu_nocb_mask)
+		return 0;
+	cpumask_andnot(cpus, cpu_possible_mask, rcu_nocb_mask);
+#ifdef CONFIG_TREE_PREEMPT_RCU
+	rcu_spawn_nocb_kthreads(&rcu_preempt_state, cpus);
+#endif /* #ifdef CONFIG_TREE_PREEMPT_RCU */
+	rcu_spawn_nocb_kthreads(&rcu_sched_state, cpus);
+	rcu_spawn_nocb_kthreads(&rcu_bh_state, cpus);
+	return 0;
+}
+early_initcall(rcu_nocb_init);
+
+#else /* #ifdef CONFIG_RCU_NOCB_CPU */
+
+static bool is_nocb_cpu(int cpu)
+{
+	return false;
+}
+
+static bool __call_rcu_nocb(struct rcu_data *rdp, struct rcu_head *rhp)
+{
+	return false;
+}
+
+static void rcu_barrier_nocb(struct rcu_state *rsp)
+{
+}
+
+static bool nocb_cpu_expendable(int cpu)
+{
+	return true;
+}
+
+static inline int rcu_nocb_adopting_cpu(void)
+{
+	return cpumask_any(cpu_online_mask);
+}
+
+static void __init rcu_boot_init_nocb_percpu_data(struct rcu_data *rdp)
+{
+}
+
+#endif /* #else #ifdef CONFIG_RCU_NOCB_CPU */
@@ -2578,6 +2578,17 @@ static void __sched_fork(struct task_struct *p)
 #ifdef CONFIG_PREEMPT_NOTIFIERS
 	INIT_HLIST_HEAD(&p->preempt_notifiers);
 #endif
+
+#ifdef CONFIG_NUMA_BALANCING
+	p->numa_scan_seq = 0;
+	p->numa_work_pending = 0;
+	p->numa_scan_period = sysctl_numa_balancing_scan_delay;
+	p->node_stamp = 0;
+	p->numa_preferred_nid = -1;
+	p->numa_pages_migrated = 0;
+	p->numa_faults = NULL;
+	p->numa_faults_buffer = NULL;
+#endif
 }
 
 /*
@@ -4088,6 +4099,50 @@ int mutex_spin_on_owner(struct mutex *lock, struct thread_info *owner)
 }
 #endif
 
+#ifdef CONFIG_RWSEM_SPIN_ON_OWNER
+/*
+ * Spin while "owner" holds the rwsem for writing and runs, as
+ * mutex_spin_on_owner() does.  The owner's task_struct cannot be freed
+ * under rcu_read_lock(), even if it released the rwsem and exited.
+ */
+int rwsem_spin_on_owner(struct rw_semaphore *sem, struct task_struct *owner)
+{
+	int ret = 1;
+
+	if (!sched_feat(OWNER_SPIN))
+		return 0;
+
+	rcu_read_lock();
+	for (;;) {
+		/*
+		 * Owner changed, break to re-assess state.
+		 */
+		if (ACCESS_ONCE(sem->owner) != owner) {
+			/*
+			 * Another writer took the lock: heavy contention,
+			 * stop spinning.
+			 */
+			if (ACCESS_ONCE(sem->owner))
+				ret = 0;
+			break;
+		}
+
+		/*
+		 * Is that owner really running on its cpu?
+		 */
+		if (task_rq(owner)->curr != owner || need_resched()) {
+			ret = 0;
+			break;
+		}
+
+		arch_mutex_cpu_relax();
+	}
+	rcu_read_unlock();
+
+	return ret;
+}
+#endif
+
 #ifdef CONFIG_PREEMPT
 /*
  * this is the entry point to schedule() from in-kernel preemption
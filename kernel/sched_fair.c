@@ -22,6 +22,7 @@
 
 #include <linux/latencytop.h>
 #include <linux/sched.h>
+#include <linux/mempolicy.h>
 
 /*
  * Targeted preemption latency for CPU-bound tasks:
@@ -656,6 +657,240 @@ update_stats_curr_start(struct cfs_rq *cfs_rq, struct sched_entity *se)
 	se->exec_start = rq_of(cfs_rq)->clock_task;
 }
 
+/**************************************************
+ * Automatic NUMA balancing:
+ *
+ * Every numa_scan_period of its runtime, a task makes the next
+ * numa_balancing_scan_size megabytes of its address space take NUMA
+ * hinting faults, see change_prot_numa().  The faults move misplaced pages
+ * towards the node that touched them, see do_numa_page(), and are
+ * accounted to the task by the node the memory was on.  The load balancer
+ * then prefers to run the task on the node most of its faults were on.
+ * The scan period backs off while the task's pages stay where they are.
+ */
+#ifdef CONFIG_NUMA_BALANCING
+unsigned int sysctl_numa_balancing = 1;
+
+/* Runtime of a new task, and age of a new mm, before the first scan */
+unsigned int sysctl_numa_balancing_scan_delay = 1000;
+
+/* Bounds of the scan period, in msecs of the task's runtime */
+unsigned int sysctl_numa_balancing_scan_period_min = 1000;
+unsigned int sysctl_numa_balancing_scan_period_max = 60000;
+
+/* Megabytes of address space made to fault at a time */
+unsigned int sysctl_numa_balancing_scan_size = 256;
+
+/*
+ * Called on each NUMA hinting fault, and folds the faults of the previous
+ * scan into the task's statistics once the mm has been scanned again.
+ */
+static void task_numa_placement(struct task_struct *p)
+{
+	int seq = ACCESS_ONCE(p->mm->numa_scan_seq);
+	unsigned long faults, max_faults = 0;
+	unsigned int period;
+	int nid, max_nid = -1;
+
+	if (p->numa_scan_seq == seq)
+		return;
+	p->numa_scan_seq = seq;
+
+	/* Older faults count for less, so the task follows phase changes */
+	for (nid = 0; nid < nr_node_ids; nid++) {
+		faults = p->numa_faults[nid] / 2 + p->numa_faults_buffer[nid];
+		p->numa_faults[nid] = faults;
+		p->numa_faults_buffer[nid] = 0;
+		if (faults > max_faults) {
+			max_faults = faults;
+			max_nid = nid;
+		}
+	}
+	p->numa_preferred_nid = max_nid;
+
+	/* Scan faster while pages move, and slower once they are in place */
+	period = p->numa_scan_period;
+	if (p->numa_pages_migrated)
+		period /= 2;
+	else
+		period *= 2;
+	p->numa_scan_period = clamp(period,
+				    sysctl_numa_balancing_scan_period_min,
+				    sysctl_numa_balancing_scan_period_max);
+	p->numa_pages_migrated = 0;
+}
+
+/**
+ * task_numa_fault - account a NUMA hinting fault to current
+ * @node: the node the memory is on, after any migration
+ * @pages: the number of pages the fault was on
+ * @migrated: whether the pages were migrated to @node by the fault
+ */
+void task_numa_fault(int node, int pages, bool migrated)
+{
+	struct task_struct *p = current;
+
+	/* get_user_pages() of a kernel thread */
+	if (!p->mm)
+		return;
+
+	if (unlikely(!p->numa_faults)) {
+		int size = sizeof(*p->numa_faults) * 2 * nr_node_ids;
+
+		p->numa_faults = kzalloc(size, GFP_KERNEL | __GFP_NOWARN);
+		if (!p->numa_faults)
+			return;
+		p->numa_faults_buffer = p->numa_faults + nr_node_ids;
+	}
+
+	task_numa_placement(p);
+
+	p->numa_faults_buffer[node] += pages;
+	if (migrated)
+		p->numa_pages_migrated += pages;
+}
+
+void task_numa_free(struct task_struct *p)
+{
+	kfree(p->numa_faults);
+}
+
+/*
+ * Make the next range of current's address space take NUMA hinting
+ * faults.  Run on the way back to user space, when task_tick_numa()
+ * found the scan period of current expired.
+ */
+void task_numa_work(void)
+{
+	struct task_struct *p = current;
+	struct mm_struct *mm = p->mm;
+	struct vm_area_struct *vma;
+	unsigned long now = jiffies, next_scan, scan;
+	unsigned long start, end;
+	long pages;
+
+	if (!p->numa_work_pending)
+		return;
+	p->numa_work_pending = 0;
+
+	if (!mm || (p->flags & PF_EXITING))
+		return;
+
+	/* Only one of the threads sharing the mm scans it per period */
+	scan = mm->numa_next_scan;
+	if (time_before(now, scan))
+		return;
+	next_scan = now + msecs_to_jiffies(p->numa_scan_period);
+	if (cmpxchg(&mm->numa_next_scan, scan, next_scan) != scan)
+		return;
+
+	pages = (long)sysctl_numa_balancing_scan_size << (20 - PAGE_SHIFT);
+	if (!pages)
+		return;
+
+	down_read(&mm->mmap_sem);
+	start = mm->numa_scan_offset;
+	vma = find_vma(mm, start);
+	if (!vma) {
+		mm->numa_scan_seq++;
+		start = 0;
+		vma = mm->mmap;
+	}
+	for (; vma; vma = vma->vm_next) {
+		if (!vma_migratable(vma) ||
+		    !(vma->vm_flags & (VM_READ | VM_WRITE | VM_EXEC)))
+			continue;
+		/* Shared libraries and the like are shared by everybody */
+		if (vma->vm_file &&
+		    (vma->vm_flags & (VM_READ | VM_WRITE)) == VM_READ)
+			continue;
+
+		do {
+			start = max(start, vma->vm_start);
+			end = ALIGN(start + (pages << PAGE_SHIFT), PMD_SIZE);
+			end = min(end, vma->vm_end);
+			pages -= (end - start) >> PAGE_SHIFT;
+			change_prot_numa(vma, start, end);
+			count_vm_events(NUMA_PTE_UPDATES,
+					(end - start) >> PAGE_SHIFT);
+			start = end;
+			if (pages <= 0)
+				goto out;
+		} while (end != vma->vm_end);
+	}
+out:
+	/* Resume from here next time, or start a new scan of the mm */
+	if (vma)
+		mm->numa_scan_offset = start;
+	else {
+		mm->numa_scan_offset = 0;
+		mm->numa_scan_seq++;
+	}
+	up_read(&mm->mmap_sem);
+}
+
+static void task_tick_numa(struct rq *rq, struct task_struct *curr)
+{
+	u64 period, now;
+
+	if (!sysctl_numa_balancing || nr_online_nodes == 1)
+		return;
+	if (!curr->mm || (curr->flags & PF_EXITING) || curr->numa_work_pending)
+		return;
+
+	now = curr->se.sum_exec_runtime;
+	period = (u64)curr->numa_scan_period * NSEC_PER_MSEC;
+
+	if (now - curr->node_stamp > period) {
+		curr->node_stamp = now;
+		if (!time_before(jiffies, curr->mm->numa_next_scan)) {
+			curr->numa_work_pending = 1;
+			set_tsk_thread_flag(curr, TIF_NOTIFY_RESUME);
+		}
+	}
+}
+
+/*
+ * The load balancer moves tasks towards their preferred node readily, and
+ * holds them back from leaving it as if they were cache hot.
+ */
+static int migrate_improves_locality(struct task_struct *p,
+				     int src_cpu, int dst_cpu)
+{
+	int nid = p->numa_preferred_nid;
+
+	if (!sysctl_numa_balancing || nid == -1)
+		return 0;
+	return cpu_to_node(dst_cpu) == nid && cpu_to_node(src_cpu) != nid;
+}
+
+static int migrate_degrades_locality(struct task_struct *p,
+				     int src_cpu, int dst_cpu)
+{
+	int nid = p->numa_preferred_nid;
+
+	if (!sysctl_numa_balancing || nid == -1)
+		return 0;
+	return cpu_to_node(src_cpu) == nid && cpu_to_node(dst_cpu) != nid;
+}
+#else
+static inline void task_tick_numa(struct rq *rq, struct task_struct *curr)
+{
+}
+
+static inline int migrate_improves_locality(struct task_struct *p,
+					    int src_cpu, int dst_cpu)
+{
+	return 0;
+}
+
+static inline int migrate_degrades_locality(struct task_struct *p,
+					    int src_cpu, int dst_cpu)
+{
+	return 0;
+}
+#endif /* CONFIG_NUMA_BALANCING */
+
 /**************************************************
  * Scheduling class queueing methods:
  */
@@ -1983,6 +2218,10 @@ int can_migrate_task(struct task_struct *p, struct rq *rq, int this_cpu,
 	 */
 
 	tsk_cache_hot = task_hot(p, rq->clock_task, sd);
+	if (migrate_improves_locality(p, cpu_of(rq), this_cpu))
+		tsk_cache_hot = 0;
+	else if (migrate_degrades_locality(p, cpu_of(rq), this_cpu))
+		tsk_cache_hot = 1;
 	if (!tsk_cache_hot ||
 		sd->nr_balance_failed > sd->cache_nice_tries) {
 #ifdef CONFIG_SCHEDSTATS
@@ -4030,6 +4269,8 @@ static void task_tick_fair(struct rq *rq, struct task_struct *curr, int queued)
 		cfs_rq = cfs_rq_of(se);
 		entity_tick(cfs_rq, se, queued);
 	}
+
+	task_tick_numa(rq, curr);
 }
 
 /*
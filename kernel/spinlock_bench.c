@@ -0,0 +1,215 @@
+/*
+ * Spinlock throughput benchmark
+ *
+ * Runs 1, 2, 4, ... threads, up to one per online CPU, each bound to its
+ * own CPU and taking the same spinlock in a loop, and prints how many
+ * times per second the lock was taken with each number of threads.
+ *
+ * The lock is held for hold_loops iterations of cpu_relax() and released
+ * for think_loops, and the critical section writes a shared counter, so
+ * that the data protected by the lock moves between CPUs as it would in
+ * real use.
+ */
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/kthread.h>
+#include <linux/completion.h>
+#include <linux/spinlock.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/delay.h>
+
+static int runtime_ms = 1000;
+module_param(runtime_ms, int, 0444);
+MODULE_PARM_DESC(runtime_ms, "duration of each run in milliseconds");
+
+static int hold_loops = 10;
+module_param(hold_loops, int, 0444);
+MODULE_PARM_DESC(hold_loops, "delay loops with the lock held");
+
+static int think_loops = 10;
+module_param(think_loops, int, 0444);
+MODULE_PARM_DESC(think_loops, "delay loops between releasing and taking the lock");
+
+static int max_threads;
+module_param(max_threads, int, 0444);
+MODULE_PARM_DESC(max_threads, "largest number of threads, 0 for all online CPUs");
+
+#ifdef CONFIG_QUEUED_SPINLOCKS
+#define BENCH_LOCK_TYPE	"queued"
+#else
+#define BENCH_LOCK_TYPE	"ticket"
+#endif
+
+static DEFINE_SPINLOCK(bench_lock);
+static unsigned long bench_shared ____cacheline_aligned_in_smp;
+
+static DECLARE_COMPLETION(bench_start);
+static int bench_stop;
+
+struct bench_thread {
+	struct task_struct *task;
+	unsigned long ops;
+} ____cacheline_aligned_in_smp;
+
+static struct bench_thread *bench_threads;
+static struct task_struct *bench_task;
+
+static inline void bench_delay(int loops)
+{
+	while (loops-- > 0)
+		cpu_relax();
+}
+
+static int bench_thread_fn(void *arg)
+{
+	struct bench_thread *bt = arg;
+	unsigned long ops = 0;
+
+	wait_for_completion(&bench_start);
+
+	while (!ACCESS_ONCE(bench_stop)) {
+		spin_lock(&bench_lock);
+		bench_shared++;
+		bench_delay(hold_loops);
+		spin_unlock(&bench_lock);
+
+		bench_delay(think_loops);
+		if (!(++ops & 1023))
+			cond_resched();
+	}
+	bt->ops = ops;
+
+	/* Wait for kthread_stop() to collect the result */
+	set_current_state(TASK_INTERRUPTIBLE);
+	while (!kthread_should_stop()) {
+		schedule();
+		set_current_state(TASK_INTERRUPTIBLE);
+	}
+	__set_current_state(TASK_RUNNING);
+
+	return 0;
+}
+
+static int bench_run(int nr_threads)
+{
+	unsigned long total = 0, min = ULONG_MAX, max = 0;
+	ktime_t start, end;
+	s64 elapsed;
+	int i, cpu, started = 0;
+
+	INIT_COMPLETION(bench_start);
+	bench_stop = 0;
+
+	i = 0;
+	for_each_online_cpu(cpu) {
+		struct bench_thread *bt = &bench_threads[i];
+
+		if (i == nr_threads)
+			break;
+		bt->ops = 0;
+		bt->task = kthread_create(bench_thread_fn, bt,
+					  "spinlock_bench/%d", cpu);
+		if (IS_ERR(bt->task)) {
+			int err = PTR_ERR(bt->task);
+
+			bt->task = NULL;
+			bench_stop = 1;
+			complete_all(&bench_start);
+			for (i = 0; i < started; i++)
+				kthread_stop(bench_threads[i].task);
+			return err;
+		}
+		kthread_bind(bt->task, cpu);
+		wake_up_process(bt->task);
+		started++;
+		i++;
+	}
+
+	start = ktime_get();
+	complete_all(&bench_start);
+	msleep(runtime_ms);
+	bench_stop = 1;
+	end = ktime_get();
+
+	for (i = 0; i < started; i++) {
+		struct bench_thread *bt = &bench_threads[i];
+
+		kthread_stop(bt->task);
+		total += bt->ops;
+		if (bt->ops < min)
+			min = bt->ops;
+		if (bt->ops > max)
+			max = bt->ops;
+	}
+
+	elapsed = ktime_to_ns(ktime_sub(end, start));
+	if (elapsed <= 0)
+		elapsed = 1;
+	printk(KERN_INFO "spinlock_bench: %3d threads: %10llu locks/s, "
+	       "per thread min %lu max %lu\n", started,
+	       div64_u64((u64)total * NSEC_PER_SEC, elapsed), min, max);
+
+	return 0;
+}
+
+static int bench_main(void *unused)
+{
+	int nr_threads, nr_cpus = num_online_cpus();
+
+	if (max_threads <= 0 || max_threads > nr_cpus)
+		max_threads = nr_cpus;
+
+	printk(KERN_INFO "spinlock_bench: " BENCH_LOCK_TYPE " spinlocks, "
+	       "hold %d think %d loops, %d ms per run\n",
+	       hold_loops, think_loops, runtime_ms);
+
+	for (nr_threads = 1; !kthread_should_stop(); nr_threads *= 2) {
+		if (nr_threads > max_threads) {
+			if (nr_threads / 2 == max_threads)
+				break;
+			nr_threads = max_threads;
+		}
+		if (bench_run(nr_threads))
+			break;
+	}
+
+	/* Done, wait for the module to be unloaded */
+	set_current_state(TASK_INTERRUPTIBLE);
+	while (!kthread_should_stop()) {
+		schedule();
+		set_current_state(TASK_INTERRUPTIBLE);
+	}
+	__set_current_state(TASK_RUNNING);
+
+	return 0;
+}
+
+static int __init spinlock_bench_init(void)
+{
+	bench_threads = kcalloc(num_possible_cpus(), sizeof(*bench_threads),
+				GFP_KERNEL);
+	if (!bench_threads)
+		return -ENOMEM;
+
+	bench_task = kthread_run(bench_main, NULL, "spinlock_bench");
+	if (IS_ERR(bench_task)) {
+		kfree(bench_threads);
+		return PTR_ERR(bench_task);
+	}
+	return 0;
+}
+
+static void __exit spinlock_bench_exit(void)
+{
+	kthread_stop(bench_task);
+	kfree(bench_threads);
+}
+
+module_init(spinlock_bench_init);
+module_exit(spinlock_bench_exit);
+
+MODULE_DESCRIPTION("spinlock throughput benchmark");
+MODULE_LICENSE("GPL");
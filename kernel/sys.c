@@ -37,6 +37,7 @@
 #include <linux/ptrace.h>
 #include <linux/fs_struct.h>
 #include <linux/gfp.h>
+#include <linux/futex.h>
 
 #include <linux/compat.h>
 #include <linux/syscalls.h>
@@ -1736,6 +1737,16 @@ SYSCALL_DEFINE5(prctl, int, option, unsigned long, arg2, unsigned long, arg3,
 			else
 				error = PR_MCE_KILL_DEFAULT;
 			break;
+		case PR_SET_FUTEX_HASH:
+			if (arg3 | arg4 | arg5)
+				return -EINVAL;
+			error = futex_set_private_hash(arg2);
+			break;
+		case PR_GET_FUTEX_HASH:
+			if (arg2 | arg3 | arg4 | arg5)
+				return -EINVAL;
+			error = futex_get_private_hash();
+			break;
 		default:
 			error = -EINVAL;
 			break;
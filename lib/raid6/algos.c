@@ -20,6 +20,7 @@
 #ifndef __KERNEL__
 #include <sys/mman.h>
 #include <stdio.h>
+#include <string.h>
 #else
 #include <linux/gfp.h>
 #if !RAID6_USE_EMPTY_ZERO_PAGE
@@ -48,11 +49,20 @@ const struct raid6_calls * const raid6_algos[] = {
 	&raid6_sse1x2,
 	&raid6_sse2x1,
 	&raid6_sse2x2,
+#ifdef CONFIG_AS_AVX2
+	&raid6_avx2x1,
+	&raid6_avx2x2,
+#endif
 #endif
 #if defined(__x86_64__) && !defined(__arch_um__)
 	&raid6_sse2x1,
 	&raid6_sse2x2,
 	&raid6_sse2x4,
+#ifdef CONFIG_AS_AVX2
+	&raid6_avx2x1,
+	&raid6_avx2x2,
+	&raid6_avx2x4,
+#endif
 #endif
 #ifdef CONFIG_ALTIVEC
 	&raid6_altivec1,
@@ -63,6 +73,23 @@ const struct raid6_calls * const raid6_algos[] = {
 	NULL
 };
 
+void (*raid6_2data_recov)(int, size_t, int, int, void **);
+EXPORT_SYMBOL_GPL(raid6_2data_recov);
+
+void (*raid6_datap_recov)(int, size_t, int, void **);
+EXPORT_SYMBOL_GPL(raid6_datap_recov);
+
+const struct raid6_recov_calls * const raid6_recov_algos[] = {
+#if (defined(__i386__) || defined(__x86_64__)) && !defined(__arch_um__)
+#ifdef CONFIG_AS_AVX2
+	&raid6_recov_avx2,
+#endif
+	&raid6_recov_ssse3,
+#endif
+	&raid6_recov_intx1,
+	NULL
+};
+
 #ifdef __KERNEL__
 #define RAID6_TIME_JIFFIES_LG2	4
 #else
@@ -74,10 +101,55 @@ const struct raid6_calls * const raid6_algos[] = {
 /* Try to pick the best algorithm */
 /* This code uses the gfmul table as convenient data set to abuse */
 
+static const struct raid6_recov_calls * __init raid6_choose_recov(int disks,
+								  void **dptrs)
+{
+	const struct raid6_recov_calls * const * algo;
+	const struct raid6_recov_calls * best;
+	unsigned long perf, bestperf;
+	unsigned long j0, j1;
+
+	bestperf = 0;  best = NULL;
+
+	/* Recovery rewrites the two failed blocks, so recover the two
+	   disks that live in the writable part of the allocation */
+	for ( algo = raid6_recov_algos ; *algo ; algo++ ) {
+		if ( !(*algo)->valid || (*algo)->valid() ) {
+			perf = 0;
+
+			preempt_disable();
+			j0 = jiffies;
+			while ( (j1 = jiffies) == j0 )
+				cpu_relax();
+			while (time_before(jiffies,
+					    j1 + (1<<RAID6_TIME_JIFFIES_LG2))) {
+				(*algo)->data2(disks, PAGE_SIZE, 0, 1, dptrs);
+				perf++;
+			}
+			preempt_enable();
+
+			if ( perf > bestperf ) {
+				best = *algo;
+				bestperf = perf;
+			}
+			printk("raid6: %-8s recov %5ld MB/s\n", (*algo)->name,
+			       (perf*HZ) >> (20-16+RAID6_TIME_JIFFIES_LG2));
+		}
+	}
+
+	if (best)
+		printk("raid6: using %s recovery algorithm (%ld MB/s)\n",
+		       best->name,
+		       (bestperf*HZ) >> (20-16+RAID6_TIME_JIFFIES_LG2));
+
+	return best;
+}
+
 int __init raid6_select_algo(void)
 {
 	const struct raid6_calls * const * algo;
 	const struct raid6_calls * best;
+	const struct raid6_recov_calls * rec_best;
 	char *syndromes;
 	void *dptrs[(65536/PAGE_SIZE)+2];
 	int i, disks;
@@ -85,19 +157,26 @@ int __init raid6_select_algo(void)
 	int bestprefer;
 	unsigned long j0, j1;
 
-	disks = (65536/PAGE_SIZE)+2;
-	for ( i = 0 ; i < disks-2 ; i++ ) {
-		dptrs[i] = ((char *)raid6_gfmul) + PAGE_SIZE*i;
-	}
-
-	/* Normal code - use a 2-page allocation to avoid D$ conflict */
-	syndromes = (void *) __get_free_pages(GFP_KERNEL, 1);
+	/* Normal code - use a 4-page allocation to avoid D$ conflict:
+	   two pages of syndromes and two writable data pages that the
+	   recovery benchmark can fail */
+	syndromes = (void *) __get_free_pages(GFP_KERNEL, 2);
 
 	if ( !syndromes ) {
 		printk("raid6: Yikes!  No memory available.\n");
 		return -ENOMEM;
 	}
 
+	disks = (65536/PAGE_SIZE)+2;
+	for ( i = 0 ; i < 2 ; i++ ) {
+		dptrs[i] = syndromes + PAGE_SIZE*(i+2);
+		memcpy(dptrs[i], ((char *)raid6_gfmul) + PAGE_SIZE*i,
+		       PAGE_SIZE);
+	}
+	for ( ; i < disks-2 ; i++ ) {
+		dptrs[i] = ((char *)raid6_gfmul) + PAGE_SIZE*i;
+	}
+
 	dptrs[disks-2] = syndromes;
 	dptrs[disks-1] = syndromes + PAGE_SIZE;
 
@@ -130,17 +209,28 @@ int __init raid6_select_algo(void)
 		}
 	}
 
+	rec_best = NULL;
 	if (best) {
 		printk("raid6: using algorithm %s (%ld MB/s)\n",
 		       best->name,
 		       (bestperf*HZ) >> (20-16+RAID6_TIME_JIFFIES_LG2));
 		raid6_call = *best;
+
+		/* Recovery calls gen_syndrome, so time it with the winner */
+		raid6_call.gen_syndrome(disks, PAGE_SIZE, dptrs);
+		rec_best = raid6_choose_recov(disks, dptrs);
 	} else
 		printk("raid6: Yikes!  No algorithm found!\n");
 
-	free_pages((unsigned long)syndromes, 1);
+	if (rec_best) {
+		raid6_2data_recov = rec_best->data2;
+		raid6_datap_recov = rec_best->datap;
+	} else if (best)
+		printk("raid6: Yikes!  No recovery algorithm found!\n");
+
+	free_pages((unsigned long)syndromes, 2);
 
-	return best ? 0 : -EINVAL;
+	return best && rec_best ? 0 : -EINVAL;
 }
 
 static void raid6_exit(void)
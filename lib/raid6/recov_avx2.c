@@ -0,0 +1,184 @@
+/* -*- linux-c -*- ------------------------------------------------------- *
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, Inc., 53 Temple Place Ste 330,
+ *   Boston MA 02111-1307, USA; either version 2 of the License, or
+ *   (at your option) any later version; incorporated herein by reference.
+ *
+ * ----------------------------------------------------------------------- */
+
+/*
+ * raid6/recov_avx2.c
+ *
+ * RAID-6 data recovery in dual failure mode using AVX2.  This is the
+ * nibble table lookup of recov_ssse3.c, with the raid6_vgfmul tables
+ * broadcast to both 128-bit lanes so VPSHUFB does 32 bytes at a time.
+ */
+
+#if (defined(__i386__) || defined(__x86_64__)) && !defined(__arch_um__) && \
+	defined(CONFIG_AS_AVX2)
+
+#include <linux/raid/pq.h>
+#include "x86.h"
+
+static const struct raid6_avx2_constants {
+	u64 x0f[4];
+} raid6_avx2_constants __attribute__((aligned(32))) = {
+	{ 0x0f0f0f0f0f0f0f0fULL, 0x0f0f0f0f0f0f0f0fULL,
+	  0x0f0f0f0f0f0f0f0fULL, 0x0f0f0f0f0f0f0f0fULL },
+};
+
+static int raid6_has_avx2(void)
+{
+	return boot_cpu_has(X86_FEATURE_AVX2) &&
+		boot_cpu_has(X86_FEATURE_AVX);
+}
+
+static void raid6_2data_recov_avx2(int disks, size_t bytes, int faila,
+		int failb, void **ptrs)
+{
+	u8 *p, *q, *dp, *dq;
+	const u8 *pbmul;	/* P multiplier table for B data */
+	const u8 *qmul;		/* Q multiplier table (for both) */
+
+	p = (u8 *)ptrs[disks-2];
+	q = (u8 *)ptrs[disks-1];
+
+	/* Compute syndrome with zero for the missing data pages
+	   Use the dead data pages as temporary storage for
+	   delta p and delta q */
+	dp = (u8 *)ptrs[faila];
+	ptrs[faila] = (void *)raid6_empty_zero_page;
+	ptrs[disks-2] = dp;
+	dq = (u8 *)ptrs[failb];
+	ptrs[failb] = (void *)raid6_empty_zero_page;
+	ptrs[disks-1] = dq;
+
+	raid6_call.gen_syndrome(disks, bytes, ptrs);
+
+	/* Restore pointer table */
+	ptrs[faila]   = dp;
+	ptrs[failb]   = dq;
+	ptrs[disks-2] = p;
+	ptrs[disks-1] = q;
+
+	/* Now, pick the proper data tables */
+	pbmul = raid6_vgfmul[raid6_gfexi[failb-faila]];
+	qmul  = raid6_vgfmul[raid6_gfinv[raid6_gfexp[faila] ^
+		raid6_gfexp[failb]]];
+
+	kernel_fpu_begin();
+
+	asm volatile("vmovdqa %0,%%ymm7" : : "m" (raid6_avx2_constants.x0f[0]));
+
+	while (bytes) {
+		/* ymm0 = *q ^ *dq, ymm1 = px = *p ^ *dp */
+		asm volatile("vmovdqa %0,%%ymm0" : : "m" (q[0]));
+		asm volatile("vmovdqa %0,%%ymm1" : : "m" (p[0]));
+		asm volatile("vpxor %0,%%ymm0,%%ymm0" : : "m" (dq[0]));
+		asm volatile("vpxor %0,%%ymm1,%%ymm1" : : "m" (dp[0]));
+
+		/* ymm5 = qx = qmul[*q ^ *dq] */
+		asm volatile("vbroadcasti128 %0,%%ymm4" : : "m" (qmul[0]));
+		asm volatile("vbroadcasti128 %0,%%ymm5" : : "m" (qmul[16]));
+		asm volatile("vpsrlw $4,%ymm0,%ymm3");
+		asm volatile("vpand %ymm7,%ymm0,%ymm0");
+		asm volatile("vpand %ymm7,%ymm3,%ymm3");
+		asm volatile("vpshufb %ymm0,%ymm4,%ymm4");
+		asm volatile("vpshufb %ymm3,%ymm5,%ymm5");
+		asm volatile("vpxor %ymm4,%ymm5,%ymm5");
+
+		/* ymm2 = pbmul[px] */
+		asm volatile("vbroadcasti128 %0,%%ymm4" : : "m" (pbmul[0]));
+		asm volatile("vbroadcasti128 %0,%%ymm2" : : "m" (pbmul[16]));
+		asm volatile("vpsrlw $4,%ymm1,%ymm3");
+		asm volatile("vpand %ymm7,%ymm1,%ymm6");
+		asm volatile("vpand %ymm7,%ymm3,%ymm3");
+		asm volatile("vpshufb %ymm6,%ymm4,%ymm4");
+		asm volatile("vpshufb %ymm3,%ymm2,%ymm2");
+		asm volatile("vpxor %ymm4,%ymm2,%ymm2");
+
+		/* ymm2 = db = pbmul[px] ^ qx */
+		asm volatile("vpxor %ymm5,%ymm2,%ymm2");
+		asm volatile("vmovdqa %%ymm2,%0" : "=m" (dq[0]));
+
+		/* ymm1 = da = db ^ px */
+		asm volatile("vpxor %ymm2,%ymm1,%ymm1");
+		asm volatile("vmovdqa %%ymm1,%0" : "=m" (dp[0]));
+
+		bytes -= 32;
+		p += 32;
+		q += 32;
+		dp += 32;
+		dq += 32;
+	}
+
+	kernel_fpu_end();
+}
+
+static void raid6_datap_recov_avx2(int disks, size_t bytes, int faila,
+		void **ptrs)
+{
+	u8 *p, *q, *dq;
+	const u8 *qmul;		/* Q multiplier table */
+
+	p = (u8 *)ptrs[disks-2];
+	q = (u8 *)ptrs[disks-1];
+
+	/* Compute syndrome with zero for the missing data page
+	   Use the dead data page as temporary storage for delta q */
+	dq = (u8 *)ptrs[faila];
+	ptrs[faila] = (void *)raid6_empty_zero_page;
+	ptrs[disks-1] = dq;
+
+	raid6_call.gen_syndrome(disks, bytes, ptrs);
+
+	/* Restore pointer table */
+	ptrs[faila]   = dq;
+	ptrs[disks-1] = q;
+
+	/* Now, pick the proper data tables */
+	qmul  = raid6_vgfmul[raid6_gfinv[raid6_gfexp[faila]]];
+
+	kernel_fpu_begin();
+
+	asm volatile("vmovdqa %0,%%ymm7" : : "m" (raid6_avx2_constants.x0f[0]));
+
+	while (bytes) {
+		/* ymm3 = *q ^ *dq */
+		asm volatile("vmovdqa %0,%%ymm3" : : "m" (dq[0]));
+		asm volatile("vpxor %0,%%ymm3,%%ymm3" : : "m" (q[0]));
+
+		/* ymm1 = qmul[*q ^ *dq] */
+		asm volatile("vbroadcasti128 %0,%%ymm0" : : "m" (qmul[0]));
+		asm volatile("vbroadcasti128 %0,%%ymm1" : : "m" (qmul[16]));
+		asm volatile("vpsrlw $4,%ymm3,%ymm2");
+		asm volatile("vpand %ymm7,%ymm3,%ymm3");
+		asm volatile("vpand %ymm7,%ymm2,%ymm2");
+		asm volatile("vpshufb %ymm3,%ymm0,%ymm0");
+		asm volatile("vpshufb %ymm2,%ymm1,%ymm1");
+		asm volatile("vpxor %ymm0,%ymm1,%ymm1");
+		asm volatile("vmovdqa %%ymm1,%0" : "=m" (dq[0]));
+
+		/* *p ^= *dq */
+		asm volatile("vpxor %0,%%ymm1,%%ymm1" : : "m" (p[0]));
+		asm volatile("vmovdqa %%ymm1,%0" : "=m" (p[0]));
+
+		bytes -= 32;
+		p += 32;
+		q += 32;
+		dq += 32;
+	}
+
+	kernel_fpu_end();
+}
+
+const struct raid6_recov_calls raid6_recov_avx2 = {
+	.data2 = raid6_2data_recov_avx2,
+	.datap = raid6_datap_recov_avx2,
+	.valid = raid6_has_avx2,
+	.name = "avx2",
+};
+
+#endif
@@ -22,11 +22,12 @@
 #define NDISKS		16	/* Including P and Q */
 
 const char raid6_empty_zero_page[PAGE_SIZE] __attribute__((aligned(256)));
-struct raid6_calls raid6_call;
 
 char *dataptrs[NDISKS];
-char data[NDISKS][PAGE_SIZE];
-char recovi[PAGE_SIZE], recovj[PAGE_SIZE];
+char data[NDISKS][PAGE_SIZE] __attribute__((aligned(PAGE_SIZE)));
+char recovi[PAGE_SIZE] __attribute__((aligned(PAGE_SIZE)));
+char recovj[PAGE_SIZE] __attribute__((aligned(PAGE_SIZE)));
+char refsyn[2][PAGE_SIZE] __attribute__((aligned(PAGE_SIZE)));
 
 static void makedata(void)
 {
@@ -52,6 +53,20 @@ static char disk_type(int d)
 	}
 }
 
+static const char *rec_name;
+
+/* Compute the reference syndrome with the plain C code */
+static void makesyndrome(void)
+{
+	dataptrs[NDISKS-2] = refsyn[0];
+	dataptrs[NDISKS-1] = refsyn[1];
+
+	raid6_intx1.gen_syndrome(NDISKS, PAGE_SIZE, (void **)&dataptrs);
+
+	dataptrs[NDISKS-2] = data[NDISKS-2];
+	dataptrs[NDISKS-1] = data[NDISKS-1];
+}
+
 static int test_disks(int i, int j)
 {
 	int erra, errb;
@@ -72,8 +87,8 @@ static int test_disks(int i, int j)
 		   equivalent to a RAID-5 failure (XOR, then recompute Q) */
 		erra = errb = 0;
 	} else {
-		printf("algo=%-8s  faila=%3d(%c)  failb=%3d(%c)  %s\n",
-		       raid6_call.name,
+		printf("algo=%-8s/%-8s  faila=%3d(%c)  failb=%3d(%c)  %s\n",
+		       raid6_call.name, rec_name,
 		       i, disk_type(i),
 		       j, disk_type(j),
 		       (!erra && !errb) ? "OK" :
@@ -90,21 +105,41 @@ static int test_disks(int i, int j)
 int main(int argc, char *argv[])
 {
 	const struct raid6_calls *const *algo;
+	const struct raid6_recov_calls *const *ra;
 	int i, j;
 	int err = 0;
 
 	makedata();
+	makesyndrome();
 
 	for (algo = raid6_algos; *algo; algo++) {
-		if (!(*algo)->valid || (*algo)->valid()) {
-			raid6_call = **algo;
+		if ((*algo)->valid && !(*algo)->valid())
+			continue;
+
+		raid6_call = **algo;
+
+		/* Nuke syndromes */
+		memset(data[NDISKS-2], 0xee, 2*PAGE_SIZE);
+
+		/* Generate assumed good syndrome and check it */
+		raid6_call.gen_syndrome(NDISKS, PAGE_SIZE,
+					(void **)&dataptrs);
+
+		if (memcmp(data[NDISKS-2], refsyn, 2*PAGE_SIZE)) {
+			printf("algo=%-8s  gen_syndrome  %s\n",
+			       raid6_call.name,
+			       memcmp(data[NDISKS-2], refsyn[0], PAGE_SIZE) ?
+			       "ERRP" : "ERRQ");
+			err++;
+		}
 
-			/* Nuke syndromes */
-			memset(data[NDISKS-2], 0xee, 2*PAGE_SIZE);
+		for (ra = raid6_recov_algos; *ra; ra++) {
+			if ((*ra)->valid && !(*ra)->valid())
+				continue;
 
-			/* Generate assumed good syndrome */
-			raid6_call.gen_syndrome(NDISKS, PAGE_SIZE,
-						(void **)&dataptrs);
+			raid6_2data_recov = (*ra)->data2;
+			raid6_datap_recov = (*ra)->datap;
+			rec_name = (*ra)->name;
 
 			for (i = 0; i < NDISKS-1; i++)
 				for (j = i+1; j < NDISKS; j++)
@@ -24,6 +24,9 @@ void __init_rwsem(struct rw_semaphore *sem, const char *name,
 	sem->count = RWSEM_UNLOCKED_VALUE;
 	spin_lock_init(&sem->wait_lock);
 	INIT_LIST_HEAD(&sem->wait_list);
+#ifdef CONFIG_RWSEM_SPIN_ON_OWNER
+	sem->owner = NULL;
+#endif
 }
 
 EXPORT_SYMBOL(__init_rwsem);
@@ -201,7 +204,7 @@ rwsem_down_failed_common(struct rw_semaphore *sem,
 	if (count == RWSEM_WAITING_BIAS)
 		sem = __rwsem_do_wake(sem, RWSEM_WAKE_NO_ACTIVE);
 	else if (count > RWSEM_WAITING_BIAS &&
-		 adjustment == -RWSEM_ACTIVE_WRITE_BIAS)
+		 (flags & RWSEM_WAITING_FOR_WRITE))
 		sem = __rwsem_do_wake(sem, RWSEM_WAKE_READ_OWNED);
 
 	spin_unlock_irq(&sem->wait_lock);
@@ -229,14 +232,97 @@ rwsem_down_read_failed(struct rw_semaphore *sem)
 					-RWSEM_ACTIVE_READ_BIAS);
 }
 
+#ifdef CONFIG_RWSEM_SPIN_ON_OWNER
+/*
+ * Try to take the write lock without queueing: the lock is stolen from
+ * the waiters, if there are any, as soon as it is free.
+ */
+static inline int rwsem_try_write_lock_unqueued(struct rw_semaphore *sem)
+{
+	signed long old, count = ACCESS_ONCE(sem->count);
+
+	while (count == RWSEM_UNLOCKED_VALUE || count == RWSEM_WAITING_BIAS) {
+		old = cmpxchg(&sem->count, count,
+			      count + RWSEM_ACTIVE_WRITE_BIAS);
+		if (old == count)
+			return 1;
+		count = old;
+	}
+	return 0;
+}
+
+/*
+ * Optimistic spinning, as for mutexes: while the writer holding the
+ * rwsem runs, it is likely to release it before we could even go to
+ * sleep and be woken up.  Readers are not tracked, so a read owned
+ * rwsem is not spun on.
+ */
+static int rwsem_optimistic_spin(struct rw_semaphore *sem)
+{
+	struct task_struct *owner;
+	int taken = 0;
+
+	preempt_disable();
+	for (;;) {
+		/*
+		 * If we own the BKL, then don't spin. The owner of
+		 * the rwsem might be waiting on us to release the BKL.
+		 */
+		if (unlikely(current->lock_depth >= 0))
+			break;
+
+		owner = ACCESS_ONCE(sem->owner);
+		if (owner && !rwsem_spin_on_owner(sem, owner))
+			break;
+
+		if (rwsem_try_write_lock_unqueued(sem)) {
+			taken = 1;
+			break;
+		}
+
+		/*
+		 * Without an owner, the rwsem is read owned, or its writer
+		 * has not set the owner yet: in either case give up rather
+		 * than spin on it, and do not keep an RT task spinning
+		 * either.
+		 */
+		if (!owner && (need_resched() || rt_task(current) ||
+			       (ACCESS_ONCE(sem->count) & RWSEM_ACTIVE_MASK)))
+			break;
+
+		arch_mutex_cpu_relax();
+	}
+	preempt_enable();
+
+	return taken;
+}
+#endif
+
 /*
  * wait for the write lock to be granted
  */
 asmregparm struct rw_semaphore __sched *
 rwsem_down_write_failed(struct rw_semaphore *sem)
 {
+	signed long adjustment = -RWSEM_ACTIVE_WRITE_BIAS;
+
+#ifdef CONFIG_RWSEM_SPIN_ON_OWNER
+	/*
+	 * Stop actively locking while spinning, so that the writer's
+	 * up_write() does not see us as an active locker; if the spinning
+	 * fails, rwsem_down_failed_common() wakes the waiters should the
+	 * rwsem have been released meanwhile.
+	 */
+	rwsem_atomic_add(adjustment, sem);
+	if (rwsem_optimistic_spin(sem)) {
+		lock_spin_acquired(&sem->dep_map);
+		return sem;
+	}
+	adjustment = 0;
+#endif
+
 	return rwsem_down_failed_common(sem, RWSEM_WAITING_FOR_WRITE,
-					-RWSEM_ACTIVE_WRITE_BIAS);
+					adjustment);
 }
 
 /*
@@ -0,0 +1,133 @@
+/*
+ *  linux/mm/cleancache.c
+ *
+ *  Hooks that offer clean page cache pages, on eviction, to a backend
+ *  that keeps them somewhere cheaper than the disk, see
+ *  include/linux/cleancache.h.
+ *
+ *  put_page is called from __remove_from_page_cache() with the mapping's
+ *  tree_lock held and interrupts disabled, and the invalidate hooks may be
+ *  too, so backends must not sleep in them.  get_page is called with the
+ *  page locked from ->readpage(s).
+ *
+ *  This work is licensed under the terms of the GNU GPL, version 2.
+ */
+
+#include <linux/module.h>
+#include <linux/fs.h>
+#include <linux/dcache.h>
+#include <linux/exportfs.h>
+#include <linux/mm.h>
+#include <linux/cleancache.h>
+
+static struct cleancache_ops *cleancache_ops __read_mostly;
+
+int cleancache_enabled __read_mostly;
+EXPORT_SYMBOL(cleancache_enabled);
+
+/**
+ * cleancache_register_ops - install a cleancache backend
+ * @ops: the backend's operations
+ *
+ * Only filesystems mounted after this use the backend.  Returns the
+ * previously registered operations, if any.
+ */
+struct cleancache_ops *cleancache_register_ops(struct cleancache_ops *ops)
+{
+	struct cleancache_ops *old = cleancache_ops;
+
+	cleancache_ops = ops;
+	smp_wmb();
+	cleancache_enabled = 1;
+	return old;
+}
+EXPORT_SYMBOL(cleancache_register_ops);
+
+void __cleancache_init_fs(struct super_block *sb)
+{
+	sb->cleancache_poolid = cleancache_ops->init_fs(PAGE_SIZE);
+}
+EXPORT_SYMBOL(__cleancache_init_fs);
+
+/*
+ * Inode numbers are not unique on every filesystem (e.g. btrfs
+ * subvolumes), so use the file handle when the filesystem has one.
+ */
+static int cleancache_get_key(struct inode *inode,
+			      struct cleancache_filekey *key)
+{
+	int (*fhfn)(struct dentry *, __u32 *fh, int *, int);
+	int len, maxlen = CLEANCACHE_KEY_MAX;
+	struct super_block *sb = inode->i_sb;
+
+	memset(key, 0, sizeof(*key));
+	key->u.ino = inode->i_ino;
+	if (sb->s_export_op != NULL) {
+		fhfn = sb->s_export_op->encode_fh;
+		if (fhfn) {
+			/* Non-connectable handles only look at d_inode */
+			struct dentry d;
+
+			d.d_inode = inode;
+			len = (*fhfn)(&d, &key->u.fh[0], &maxlen, 0);
+			if (len <= 0 || len == 255)
+				return -1;
+			if (maxlen > CLEANCACHE_KEY_MAX)
+				return -1;
+		}
+	}
+	return 0;
+}
+
+int __cleancache_get_page(struct page *page)
+{
+	int pool_id = page->mapping->host->i_sb->cleancache_poolid;
+	struct cleancache_filekey key;
+
+	VM_BUG_ON(!PageLocked(page));
+
+	if (cleancache_get_key(page->mapping->host, &key) < 0)
+		return -1;
+	return cleancache_ops->get_page(pool_id, key, page->index, page);
+}
+EXPORT_SYMBOL(__cleancache_get_page);
+
+void __cleancache_put_page(struct page *page)
+{
+	int pool_id = page->mapping->host->i_sb->cleancache_poolid;
+	struct cleancache_filekey key;
+
+	VM_BUG_ON(!PageLocked(page));
+
+	if (cleancache_get_key(page->mapping->host, &key) >= 0)
+		cleancache_ops->put_page(pool_id, key, page->index, page);
+}
+EXPORT_SYMBOL(__cleancache_put_page);
+
+void __cleancache_invalidate_page(struct address_space *mapping,
+				  struct page *page)
+{
+	int pool_id = mapping->host->i_sb->cleancache_poolid;
+	struct cleancache_filekey key;
+
+	if (cleancache_get_key(mapping->host, &key) >= 0)
+		cleancache_ops->invalidate_page(pool_id, key, page->index);
+}
+EXPORT_SYMBOL(__cleancache_invalidate_page);
+
+void __cleancache_invalidate_inode(struct address_space *mapping)
+{
+	int pool_id = mapping->host->i_sb->cleancache_poolid;
+	struct cleancache_filekey key;
+
+	if (cleancache_get_key(mapping->host, &key) >= 0)
+		cleancache_ops->invalidate_inode(pool_id, key);
+}
+EXPORT_SYMBOL(__cleancache_invalidate_inode);
+
+void __cleancache_invalidate_fs(struct super_block *sb)
+{
+	cleancache_ops->invalidate_fs(sb->cleancache_poolid);
+	sb->cleancache_poolid = -1;
+}
+EXPORT_SYMBOL(__cleancache_invalidate_fs);
@@ -14,6 +14,9 @@
 #include <linux/backing-dev.h>
 #include <linux/sysctl.h>
 #include <linux/sysfs.h>
+#include <linux/kthread.h>
+#include <linux/freezer.h>
+#include <linux/cpu.h>
 #include "internal.h"
 
 #define CREATE_TRACE_POINTS
@@ -397,7 +400,7 @@ static int compact_finished(struct zone *zone,
 		return COMPACT_COMPLETE;
 
 	/* Compaction run is not finished if the watermark is not met */
-	if (cc->compact_mode != COMPACT_MODE_KSWAPD)
+	if (cc->compact_mode == COMPACT_MODE_DIRECT_RECLAIM)
 		watermark = low_wmark_pages(zone);
 	else
 		watermark = high_wmark_pages(zone);
@@ -422,6 +425,13 @@ static int compact_finished(struct zone *zone,
 	if (cc->compact_mode == COMPACT_MODE_KSWAPD)
 		return COMPACT_CONTINUE;
 
+	/*
+	 * kcompactd only tops the zone up to the high watermark for the
+	 * order, it leaves the rest of the zone for the next time.
+	 */
+	if (cc->compact_mode == COMPACT_MODE_KCOMPACTD)
+		return COMPACT_PARTIAL;
+
 	/* Direct compactor: Is a suitable page free? */
 	for (order = cc->order; order < MAX_ORDER; order++) {
 		/* Job done if page is free of the right migratetype */
@@ -704,3 +714,277 @@ void compaction_unregister_node(struct node *node)
 	return sysdev_remove_file(&node->sysdev, &attr_compact);
 }
 #endif /* CONFIG_SYSFS && CONFIG_NUMA */
+
+/*
+ * kcompactd: compact in the background, on behalf of high-order
+ * allocations, before they have to stall in direct compaction.
+ *
+ * kswapd wakes the node's kcompactd with the order it was balancing for
+ * when it goes back to sleep, so that reclaim and compaction don't fight
+ * each other.  In addition, every kcompactd_interval_centisecs, kcompactd
+ * checks whether the free blocks of kcompactd_order have fallen below the
+ * low watermark in a zone where the fragmentation index says compaction
+ * can help, and compacts that zone back up to the high watermark.
+ */
+int sysctl_kcompactd_order = PAGE_ALLOC_COSTLY_ORDER;
+unsigned int sysctl_kcompactd_interval_centisecs = 500;
+
+/* Would compacting a zone of the node help an allocation of this order? */
+static bool kcompactd_node_suitable(pg_data_t *pgdat, int order,
+				    int classzone_idx)
+{
+	int zoneid;
+	struct zone *zone;
+
+	for (zoneid = 0; zoneid <= classzone_idx; zoneid++) {
+		zone = &pgdat->node_zones[zoneid];
+
+		if (!populated_zone(zone))
+			continue;
+
+		if (zone_watermark_ok(zone, order, low_wmark_pages(zone), 0, 0))
+			continue;
+
+		if (compaction_suitable(zone, order) == COMPACT_CONTINUE)
+			return true;
+	}
+
+	return false;
+}
+
+static void kcompactd_do_work(pg_data_t *pgdat, int order, int classzone_idx)
+{
+	int zoneid;
+	struct zone *zone;
+
+	count_vm_event(KCOMPACTD_WAKE);
+
+	for (zoneid = 0; zoneid <= classzone_idx; zoneid++) {
+		struct compact_control cc = {
+			.nr_freepages = 0,
+			.nr_migratepages = 0,
+			.order = order,
+			.migratetype = MIGRATE_MOVABLE,
+			.sync = false,
+			.compact_mode = COMPACT_MODE_KCOMPACTD,
+		};
+
+		zone = &pgdat->node_zones[zoneid];
+		if (!populated_zone(zone))
+			continue;
+
+		if (zone_watermark_ok(zone, order, low_wmark_pages(zone), 0, 0))
+			continue;
+
+		if (compaction_deferred(zone))
+			continue;
+
+		if (compaction_suitable(zone, order) != COMPACT_CONTINUE)
+			continue;
+
+		if (kthread_should_stop())
+			return;
+
+		cc.zone = zone;
+		INIT_LIST_HEAD(&cc.freepages);
+		INIT_LIST_HEAD(&cc.migratepages);
+
+		compact_zone(zone, &cc);
+
+		VM_BUG_ON(!list_empty(&cc.freepages));
+		VM_BUG_ON(!list_empty(&cc.migratepages));
+
+		if (zone_watermark_ok(zone, order, low_wmark_pages(zone), 0, 0)) {
+			zone->compact_considered = 0;
+			zone->compact_defer_shift = 0;
+			count_vm_event(KCOMPACTD_SUCCESS);
+		} else {
+			defer_compaction(zone);
+			count_vm_event(KCOMPACTD_FAIL);
+		}
+	}
+}
+
+static bool kcompactd_work_requested(pg_data_t *pgdat, long timeout)
+{
+	if (pgdat->kcompactd_max_order > 0 || kthread_should_stop())
+		return true;
+
+	/* kcompactd_order was set while we slept without a timeout */
+	return timeout == MAX_SCHEDULE_TIMEOUT && sysctl_kcompactd_order;
+}
+
+static long kcompactd_timeout(void)
+{
+	if (!sysctl_kcompactd_order)
+		return MAX_SCHEDULE_TIMEOUT;
+
+	return msecs_to_jiffies(sysctl_kcompactd_interval_centisecs * 10);
+}
+
+/*
+ * The background compaction daemon, started as a kernel thread
+ * from the init process.
+ */
+static int kcompactd(void *p)
+{
+	pg_data_t *pgdat = (pg_data_t *)p;
+	const struct cpumask *cpumask = cpumask_of_node(pgdat->node_id);
+
+	if (!cpumask_empty(cpumask))
+		set_cpus_allowed_ptr(current, cpumask);
+
+	set_freezable();
+
+	pgdat->kcompactd_max_order = 0;
+	pgdat->kcompactd_classzone_idx = pgdat->nr_zones - 1;
+
+	while (!kthread_should_stop()) {
+		int order, classzone_idx;
+		long timeout = kcompactd_timeout();
+
+		wait_event_freezable_timeout(pgdat->kcompactd_wait,
+				kcompactd_work_requested(pgdat, timeout),
+				timeout);
+		if (kthread_should_stop())
+			break;
+
+		order = pgdat->kcompactd_max_order;
+		classzone_idx = pgdat->kcompactd_classzone_idx;
+		pgdat->kcompactd_max_order = 0;
+		pgdat->kcompactd_classzone_idx = pgdat->nr_zones - 1;
+
+		/* Timed out: check the proactive order instead */
+		if (!order) {
+			order = sysctl_kcompactd_order;
+			if (!order || !kcompactd_node_suitable(pgdat, order,
+							pgdat->nr_zones - 1))
+				continue;
+		}
+
+		kcompactd_do_work(pgdat, order, classzone_idx);
+	}
+
+	return 0;
+}
+
+/*
+ * kcompactd sleeps without a timeout while kcompactd_order is 0, so kick
+ * it once a new order has been written.
+ */
+int sysctl_kcompactd_order_handler(struct ctl_table *table, int write,
+			void __user *buffer, size_t *length, loff_t *ppos)
+{
+	pg_data_t *pgdat;
+	int ret;
+
+	ret = proc_dointvec_minmax(table, write, buffer, length, ppos);
+	if (ret || !write)
+		return ret;
+
+	for_each_online_pgdat(pgdat)
+		wake_up_interruptible(&pgdat->kcompactd_wait);
+
+	return 0;
+}
+
+/**
+ * wakeup_kcompactd - ask kcompactd to compact a node in the background
+ * @pgdat: The node to compact
+ * @order: The order that compaction should make available
+ * @classzone_idx: The highest zone the allocation may use
+ *
+ * Called by kswapd when it has reclaimed enough for @order and goes back
+ * to sleep.  kcompactd is only woken if compaction is likely to help.
+ */
+void wakeup_kcompactd(pg_data_t *pgdat, int order, int classzone_idx)
+{
+	if (!order)
+		return;
+
+	if (pgdat->kcompactd_max_order < order)
+		pgdat->kcompactd_max_order = order;
+
+	if (pgdat->kcompactd_classzone_idx > classzone_idx)
+		pgdat->kcompactd_classzone_idx = classzone_idx;
+
+	if (!waitqueue_active(&pgdat->kcompactd_wait))
+		return;
+
+	if (!kcompactd_node_suitable(pgdat, order, classzone_idx))
+		return;
+
+	wake_up_interruptible(&pgdat->kcompactd_wait);
+}
+
+/*
+ * This kcompactd start function will be called by init and node-hot-add.
+ * On node-hot-add, kcompactd will moved to proper cpus if cpus are hot-added.
+ */
+int kcompactd_run(int nid)
+{
+	pg_data_t *pgdat = NODE_DATA(nid);
+	int ret = 0;
+
+	if (pgdat->kcompactd)
+		return 0;
+
+	pgdat->kcompactd = kthread_run(kcompactd, pgdat, "kcompactd%d", nid);
+	if (IS_ERR(pgdat->kcompactd)) {
+		printk(KERN_ERR "Failed to start kcompactd on node %d\n", nid);
+		pgdat->kcompactd = NULL;
+		ret = -1;
+	}
+	return ret;
+}
+
+/*
+ * Called by memory hotplug when all memory in a node is offlined.
+ */
+void kcompactd_stop(int nid)
+{
+	struct task_struct *kcompactd = NODE_DATA(nid)->kcompactd;
+
+	if (kcompactd) {
+		kthread_stop(kcompactd);
+		NODE_DATA(nid)->kcompactd = NULL;
+	}
+}
+
+/*
+ * It's optimal to keep kcompactds on the same CPUs as their memory, but
+ * not required for correctness. So if the last cpu in a node goes away,
+ * we get changed to run anywhere: as the first one comes back, restore
+ * their cpu bindings.
+ */
+static int __devinit kcompactd_cpu_callback(struct notifier_block *nfb,
+					    unsigned long action, void *hcpu)
+{
+	int nid;
+
+	if (action == CPU_ONLINE || action == CPU_ONLINE_FROZEN) {
+		for_each_node_state(nid, N_HIGH_MEMORY) {
+			pg_data_t *pgdat = NODE_DATA(nid);
+			const struct cpumask *mask;
+
+			mask = cpumask_of_node(pgdat->node_id);
+
+			if (pgdat->kcompactd &&
+			    cpumask_any_and(cpu_online_mask, mask) < nr_cpu_ids)
+				/* One of our CPUs online: restore mask */
+				set_cpus_allowed_ptr(pgdat->kcompactd, mask);
+		}
+	}
+	return NOTIFY_OK;
+}
+
+static int __init kcompactd_init(void)
+{
+	int nid;
+
+	for_each_node_state(nid, N_HIGH_MEMORY)
+		kcompactd_run(nid);
+	hotcpu_notifier(kcompactd_cpu_callback, 0);
+	return 0;
+}
+module_init(kcompactd_init)
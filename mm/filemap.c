@@ -33,6 +33,7 @@
 #include <linux/cpuset.h>
 #include <linux/hardirq.h> /* for BUG_ON(!in_atomic()) only */
 #include <linux/memcontrol.h>
+#include <linux/cleancache.h>
 #include <linux/mm_inline.h> /* for page_is_file_cache() */
 #include "internal.h"
 
@@ -80,7 +81,8 @@
  *  ->i_mutex
  *    ->i_alloc_sem             (various)
  *
- *  ->inode_lock
+ *  ->inode_wb_list_lock
+ *    ->inode->i_lock		(fs/fs-writeback.c)
  *    ->sb_lock			(fs/fs-writeback.c)
  *    ->mapping->tree_lock	(__sync_single_inode)
  *
@@ -98,8 +100,10 @@
  *    ->zone.lru_lock		(check_pte_range->isolate_lru_page)
  *    ->private_lock		(page_remove_rmap->set_page_dirty)
  *    ->tree_lock		(page_remove_rmap->set_page_dirty)
- *    ->inode_lock		(page_remove_rmap->set_page_dirty)
- *    ->inode_lock		(zap_pte_range->set_page_dirty)
+ *    ->inode->i_lock		(page_remove_rmap->set_page_dirty)
+ *    ->inode->i_lock		(zap_pte_range->set_page_dirty)
+ *    ->inode_wb_list_lock	(page_remove_rmap->set_page_dirty)
+ *    ->inode_wb_list_lock	(zap_pte_range->set_page_dirty)
  *    ->private_lock		(zap_pte_range->__set_page_dirty_buffers)
  *
  *  (code doesn't rely on that order, so you could switch it around)
@@ -116,6 +120,16 @@ void __remove_from_page_cache(struct page *page)
 {
 	struct address_space *mapping = page->mapping;
 
+	/*
+	 * An uptodate page known to be backed by the disk gets a second
+	 * chance in cleancache; otherwise make sure no stale copy of it
+	 * stays behind there.  Truncation clears PageMappedToDisk first.
+	 */
+	if (PageUptodate(page) && PageMappedToDisk(page))
+		cleancache_put_page(page);
+	else
+		cleancache_invalidate_page(mapping, page);
+
 	radix_tree_delete(&mapping->page_tree, page->index);
 	page->mapping = NULL;
 	mapping->nrpages--;
@@ -452,10 +466,18 @@ int add_to_page_cache_lru(struct page *page, struct address_space *mapping,
 
 	ret = add_to_page_cache(page, mapping, offset, gfp_mask);
 	if (ret == 0) {
-		if (page_is_file_cache(page))
-			lru_cache_add_file(page);
-		else
+		if (!page_is_file_cache(page))
 			lru_cache_add_anon(page);
+		else if (workingset_refault(mapping, offset)) {
+			/*
+			 * The page was evicted recently enough that it
+			 * would still be cached, had the inactive list
+			 * had the room: it is part of the working set.
+			 */
+			lru_cache_add_lru(page, LRU_ACTIVE_FILE);
+			workingset_activation(page);
+		} else
+			lru_cache_add_file(page);
 	}
 	return ret;
 }
@@ -1653,8 +1675,80 @@ page_not_uptodate:
 }
 EXPORT_SYMBOL(filemap_fault);
 
+/**
+ * filemap_map_pages - map the cached pages around a read fault
+ * @vma:	vma in which the fault was taken
+ * @vmf:	the pages to map, from vmf->pgoff to vmf->max_pgoff
+ *
+ * Maps the pages of the range that are already uptodate in the page cache
+ * and not locked, without sleeping: anything else is left to filemap_fault.
+ * Pages marked for readahead are left too, so that touching them still
+ * triggers the next asynchronous readahead.  Called with the page table
+ * lock held.
+ */
+void filemap_map_pages(struct vm_area_struct *vma, struct vm_fault *vmf)
+{
+	struct file *file = vma->vm_file;
+	struct address_space *mapping = file->f_mapping;
+	struct page *pages[PAGEVEC_SIZE];
+	pgoff_t index = vmf->pgoff;
+	unsigned long address = (unsigned long)vmf->virtual_address;
+	unsigned long addr;
+	pgoff_t size;
+	pte_t *pte;
+	unsigned int nr, i;
+
+	while (index <= vmf->max_pgoff) {
+		nr = find_get_pages(mapping, index,
+				min_t(pgoff_t, PAGEVEC_SIZE,
+				      vmf->max_pgoff - index + 1), pages);
+		if (!nr)
+			break;
+		index = pages[nr - 1]->index + 1;
+
+		for (i = 0; i < nr; i++) {
+			struct page *page = pages[i];
+
+			if (page->index < vmf->pgoff ||
+			    page->index > vmf->max_pgoff)
+				goto skip;
+			if (!PageUptodate(page) || PageReadahead(page) ||
+			    PageHWPoison(page))
+				goto skip;
+			if (!trylock_page(page))
+				goto skip;
+
+			if (page->mapping != mapping || !PageUptodate(page))
+				goto unlock;
+
+			size = (i_size_read(mapping->host) + PAGE_CACHE_SIZE - 1)
+							>> PAGE_CACHE_SHIFT;
+			if (page->index >= size)
+				goto unlock;
+
+			pte = vmf->pte + page->index - vmf->pgoff;
+			if (!pte_none(*pte))
+				goto unlock;
+
+			if (file->f_ra.mmap_miss > 0)
+				file->f_ra.mmap_miss--;
+			addr = address + (page->index - vmf->pgoff) * PAGE_SIZE;
+			/* the pte now holds the page reference */
+			do_set_pte(vma, addr, page, pte, false, false);
+			unlock_page(page);
+			continue;
+unlock:
+			unlock_page(page);
+skip:
+			page_cache_release(page);
+		}
+	}
+}
+EXPORT_SYMBOL(filemap_map_pages);
+
 const struct vm_operations_struct generic_file_vm_ops = {
 	.fault		= filemap_fault,
+	.map_pages	= filemap_map_pages,
 };
 
 /* This is used for a general mmap of a disk file */
@@ -2198,6 +2292,12 @@ generic_file_direct_write(struct kiocb *iocb, const struct iovec *iov,
 	if (mapping->nrpages) {
 		invalidate_inode_pages2_range(mapping,
 					      pos >> PAGE_CACHE_SHIFT, end);
+	} else {
+		/*
+		 * That would drop the copies cleancache holds too, which may
+		 * be stale now even with no page left in the page cache.
+		 */
+		cleancache_invalidate_inode(mapping);
 	}
 
 	if (written > 0) {
@@ -0,0 +1,98 @@
+/*
+ *  linux/mm/frontswap.c
+ *
+ *  Hooks that let a backend keep swapped out pages in front of the
+ *  swap device, see include/linux/frontswap.h.
+ *
+ *  The page being stored or loaded is locked and in the swap cache, which
+ *  serializes the store, load and writeback of any one swap slot.
+ *  Invalidation is called from swap_entry_free() with swap_lock held, so
+ *  backends must not sleep there.
+ *
+ *  This work is licensed under the terms of the GNU GPL, version 2.
+ */
+
+#include <linux/mm.h>
+#include <linux/swap.h>
+#include <linux/swapops.h>
+#include <linux/module.h>
+#include <linux/frontswap.h>
+
+static struct frontswap_ops *frontswap_ops __read_mostly;
+
+int frontswap_enabled __read_mostly;
+EXPORT_SYMBOL(frontswap_enabled);
+
+/* Swap types that are swapped on, to init them on a late registration */
+static DECLARE_BITMAP(frontswap_types, MAX_SWAPFILES);
+
+/**
+ * frontswap_register_ops - install a frontswap backend
+ * @ops: the backend's operations
+ *
+ * Swap areas that are already active are initialized for the backend
+ * right away.  Returns the previously registered operations, if any.
+ */
+struct frontswap_ops *frontswap_register_ops(struct frontswap_ops *ops)
+{
+	struct frontswap_ops *old = frontswap_ops;
+	int type;
+
+	for_each_set_bit(type, frontswap_types, MAX_SWAPFILES)
+		ops->init(type);
+
+	frontswap_ops = ops;
+	smp_wmb();
+	frontswap_enabled = 1;
+	return old;
+}
+EXPORT_SYMBOL(frontswap_register_ops);
+
+void __frontswap_init(unsigned type)
+{
+	BUG_ON(type >= MAX_SWAPFILES);
+	set_bit(type, frontswap_types);
+	if (frontswap_ops)
+		frontswap_ops->init(type);
+}
+
+int __frontswap_store(struct page *page)
+{
+	swp_entry_t entry = { .val = page_private(page), };
+	unsigned type = swp_type(entry);
+	pgoff_t offset = swp_offset(entry);
+	int ret;
+
+	BUG_ON(!PageLocked(page));
+
+	ret = frontswap_ops->store(type, offset, page);
+	if (ret)
+		/*
+		 * The backend may still hold an older copy of this slot,
+		 * from before the page was last dirtied: the swap device is
+		 * about to get the real data, so that copy must go.
+		 */
+		frontswap_ops->invalidate_page(type, offset);
+	return ret;
+}
+
+int __frontswap_load(struct page *page)
+{
+	swp_entry_t entry = { .val = page_private(page), };
+
+	BUG_ON(!PageLocked(page));
+
+	return frontswap_ops->load(swp_type(entry), swp_offset(entry), page);
+}
+
+void __frontswap_invalidate_page(unsigned type, pgoff_t offset)
+{
+	frontswap_ops->invalidate_page(type, offset);
+}
+
+void __frontswap_invalidate_area(unsigned type)
+{
+	if (frontswap_ops)
+		frontswap_ops->invalidate_area(type);
+	clear_bit(type, frontswap_types);
+}
@@ -17,6 +17,9 @@
 #include <linux/khugepaged.h>
 #include <linux/freezer.h>
 #include <linux/mman.h>
+#include <linux/file.h>
+#include <linux/pagemap.h>
+#include <linux/shmem_fs.h>
 #include <asm/tlb.h>
 #include <asm/pgalloc.h>
 #include "internal.h"
@@ -312,6 +315,9 @@ static struct attribute *hugepage_attr[] = {
 	&defrag_attr.attr,
 #ifdef CONFIG_DEBUG_VM
 	&debug_cow_attr.attr,
+#endif
+#ifdef CONFIG_SHMEM
+	&shmem_enabled_attr.attr,
 #endif
 	NULL,
 };
@@ -709,6 +715,46 @@ out:
 	return handle_pte_fault(mm, vma, address, pte, pmd, flags);
 }
 
+/*
+ * Map HPAGE_PMD_NR naturally aligned pages of the page cache with a huge
+ * pmd.  They are not a compound page: each keeps its own count and
+ * mapcount, and the caller's references are handed over to the mapping.
+ */
+int map_file_huge_pmd(struct vm_area_struct *vma, unsigned long haddr,
+		      pmd_t *pmd, struct page *page, unsigned int flags)
+{
+	struct mm_struct *mm = vma->vm_mm;
+	pgtable_t pgtable;
+	pmd_t entry;
+	int i;
+
+	VM_BUG_ON(haddr & ~HPAGE_PMD_MASK);
+	VM_BUG_ON(page_to_pfn(page) & (HPAGE_PMD_NR-1));
+	pgtable = pte_alloc_one(mm, haddr);
+	if (unlikely(!pgtable))
+		return VM_FAULT_FALLBACK;
+
+	spin_lock(&mm->page_table_lock);
+	if (unlikely(!pmd_none(*pmd))) {
+		spin_unlock(&mm->page_table_lock);
+		pte_free(mm, pgtable);
+		return VM_FAULT_FALLBACK;
+	}
+	for (i = 0; i < HPAGE_PMD_NR; i++)
+		page_add_file_rmap(page + i);
+	add_mm_counter(mm, MM_FILEPAGES, HPAGE_PMD_NR);
+	entry = mk_pmd(page, vma->vm_page_prot);
+	entry = maybe_pmd_mkwrite(pmd_mkhuge(entry), vma);
+	if (flags & FAULT_FLAG_WRITE)
+		entry = pmd_mkdirty(entry);
+	set_pmd_at(mm, haddr, pmd, entry);
+	prepare_pmd_huge_pte(pgtable, mm);
+	spin_unlock(&mm->page_table_lock);
+	count_vm_event(THP_FILE_MAPPED);
+
+	return 0;
+}
+
 int copy_huge_pmd(struct mm_struct *dst_mm, struct mm_struct *src_mm,
 		  pmd_t *dst_pmd, pmd_t *src_pmd, unsigned long addr,
 		  struct vm_area_struct *vma)
@@ -742,6 +788,20 @@ int copy_huge_pmd(struct mm_struct *dst_mm, struct mm_struct *src_mm,
 		goto out;
 	}
 	src_page = pmd_page(pmd);
+	if (!PageAnon(src_page)) {
+		int i;
+
+		/* pages of tmpfs, each with its own count and mapcount */
+		for (i = 0; i < HPAGE_PMD_NR; i++) {
+			get_page(src_page + i);
+			page_dup_rmap(src_page + i);
+		}
+		add_mm_counter(dst_mm, MM_FILEPAGES, HPAGE_PMD_NR);
+		set_pmd_at(dst_mm, addr, dst_pmd, pmd_mkold(pmd));
+		prepare_pmd_huge_pte(pgtable, dst_mm);
+		ret = 0;
+		goto out_unlock;
+	}
 	VM_BUG_ON(!PageHead(src_page));
 	get_page(src_page);
 	page_dup_rmap(src_page);
@@ -948,6 +1008,35 @@ out:
 	return ret;
 }
 
+#ifdef CONFIG_NUMA_BALANCING
+/*
+ * A NUMA hinting fault on a huge pmd, see do_numa_page().  Huge pages are
+ * not migrated: the fault only tells the task where its memory is.
+ */
+int do_huge_pmd_numa_page(struct mm_struct *mm, struct vm_area_struct *vma,
+			  unsigned long address, pmd_t *pmd, pmd_t orig_pmd)
+{
+	unsigned long haddr = address & HPAGE_PMD_MASK;
+	int page_nid;
+
+	spin_lock(&mm->page_table_lock);
+	if (unlikely(!pmd_same(*pmd, orig_pmd))) {
+		spin_unlock(&mm->page_table_lock);
+		return 0;
+	}
+	orig_pmd = pmd_modify(orig_pmd, vma->vm_page_prot);
+	set_pmd_at(mm, haddr, pmd, orig_pmd);
+	page_nid = page_to_nid(pmd_page(orig_pmd));
+	spin_unlock(&mm->page_table_lock);
+
+	count_vm_event(NUMA_HINT_FAULTS);
+	if (page_nid == numa_node_id())
+		count_vm_event(NUMA_HINT_FAULTS_LOCAL);
+	task_numa_fault(page_nid, HPAGE_PMD_NR, false);
+	return 0;
+}
+#endif
+
 struct page *follow_trans_huge_pmd(struct mm_struct *mm,
 				   unsigned long addr,
 				   pmd_t *pmd,
@@ -961,7 +1050,7 @@ struct page *follow_trans_huge_pmd(struct mm_struct *mm,
 		goto out;
 
 	page = pmd_page(*pmd);
-	VM_BUG_ON(!PageHead(page));
+	VM_BUG_ON(!PageHead(page) && PageAnon(page));
 	if (flags & FOLL_TOUCH) {
 		pmd_t _pmd;
 		/*
@@ -976,7 +1065,7 @@ struct page *follow_trans_huge_pmd(struct mm_struct *mm,
 		set_pmd_at(mm, addr & HPAGE_PMD_MASK, pmd, _pmd);
 	}
 	page += (addr & ~HPAGE_PMD_MASK) >> PAGE_SHIFT;
-	VM_BUG_ON(!PageCompound(page));
+	VM_BUG_ON(!PageCompound(page) && PageHead(pmd_page(*pmd)));
 	if (flags & FOLL_GET)
 		get_page(page);
 
@@ -984,8 +1073,36 @@ out:
 	return page;
 }
 
+static void zap_file_huge_pmd(struct mmu_gather *tlb,
+			      struct vm_area_struct *vma,
+			      pmd_t *pmd, unsigned long addr)
+{
+	pgtable_t pgtable;
+	struct page *page;
+	pmd_t orig_pmd;
+	int i;
+
+	pgtable = get_pmd_huge_pte(tlb->mm);
+	orig_pmd = pmdp_get_and_clear(tlb->mm, addr, pmd);
+	page = pmd_page(orig_pmd);
+	for (i = 0; i < HPAGE_PMD_NR; i++) {
+		if (pmd_dirty(orig_pmd))
+			set_page_dirty(page + i);
+		if (pmd_young(orig_pmd) &&
+		    likely(!VM_SequentialReadHint(vma)))
+			mark_page_accessed(page + i);
+		page_remove_rmap(page + i);
+		VM_BUG_ON(page_mapcount(page + i) < 0);
+	}
+	add_mm_counter(tlb->mm, MM_FILEPAGES, -HPAGE_PMD_NR);
+	spin_unlock(&tlb->mm->page_table_lock);
+	for (i = 0; i < HPAGE_PMD_NR; i++)
+		tlb_remove_page(tlb, page + i);
+	pte_free(tlb->mm, pgtable);
+}
+
 int zap_huge_pmd(struct mmu_gather *tlb, struct vm_area_struct *vma,
-		 pmd_t *pmd)
+		 pmd_t *pmd, unsigned long addr)
 {
 	int ret = 0;
 
@@ -995,6 +1112,9 @@ int zap_huge_pmd(struct mmu_gather *tlb, struct vm_area_struct *vma,
 			spin_unlock(&tlb->mm->page_table_lock);
 			wait_split_huge_page(vma->anon_vma,
 					     pmd);
+		} else if (!PageAnon(pmd_page(*pmd))) {
+			zap_file_huge_pmd(tlb, vma, pmd, addr);
+			ret = 1;
 		} else {
 			struct page *page;
 			pgtable_t pgtable;
@@ -1112,6 +1232,41 @@ out:
 	return ret;
 }
 
+/*
+ * Returns the huge pmd mapping the tmpfs @page at @address, if any, with
+ * the page_table_lock held.
+ */
+pmd_t *page_check_file_pmd(struct page *page, struct mm_struct *mm,
+			   unsigned long address)
+{
+	pgd_t *pgd;
+	pud_t *pud;
+	pmd_t *pmd;
+
+	if (PageAnon(page))
+		return NULL;
+
+	pgd = pgd_offset(mm, address);
+	if (!pgd_present(*pgd))
+		return NULL;
+
+	pud = pud_offset(pgd, address);
+	if (!pud_present(*pud))
+		return NULL;
+
+	pmd = pmd_offset(pud, address);
+	if (!pmd_trans_huge(*pmd))
+		return NULL;
+
+	spin_lock(&mm->page_table_lock);
+	if (pmd_trans_huge(*pmd) && !PageAnon(pmd_page(*pmd)) &&
+	    pmd_pfn(*pmd) + ((address & ~HPAGE_PMD_MASK) >> PAGE_SHIFT) ==
+	    page_to_pfn(page))
+		return pmd;
+	spin_unlock(&mm->page_table_lock);
+	return NULL;
+}
+
 static int __split_huge_page_splitting(struct page *page,
 				       struct vm_area_struct *vma,
 				       unsigned long address)
@@ -1394,13 +1549,18 @@ out:
 int hugepage_madvise(struct vm_area_struct *vma,
 		     unsigned long *vm_flags, int advice)
 {
+	unsigned long shared = VM_SHARED | VM_MAYSHARE;
+
+	/* tmpfs maps its own huge pages, shared mappings included */
+	if (vma->vm_ops && vma->vm_ops->pmd_fault)
+		shared = 0;
+
 	switch (advice) {
 	case MADV_HUGEPAGE:
 		/*
 		 * Be somewhat over-protective like KSM for now!
 		 */
-		if (*vm_flags & (VM_HUGEPAGE |
-				 VM_SHARED   | VM_MAYSHARE   |
+		if (*vm_flags & (VM_HUGEPAGE | shared |
 				 VM_PFNMAP   | VM_IO      | VM_DONTEXPAND |
 				 VM_RESERVED | VM_HUGETLB | VM_INSERTPAGE |
 				 VM_MIXEDMAP | VM_SAO))
@@ -1419,8 +1579,7 @@ int hugepage_madvise(struct vm_area_struct *vma,
 		/*
 		 * Be somewhat over-protective like KSM for now!
 		 */
-		if (*vm_flags & (VM_NOHUGEPAGE |
-				 VM_SHARED   | VM_MAYSHARE   |
+		if (*vm_flags & (VM_NOHUGEPAGE | shared |
 				 VM_PFNMAP   | VM_IO      | VM_DONTEXPAND |
 				 VM_RESERVED | VM_HUGETLB | VM_INSERTPAGE |
 				 VM_MIXEDMAP | VM_SAO))
@@ -1551,6 +1710,9 @@ int __khugepaged_enter(struct mm_struct *mm)
 int khugepaged_enter_vma_merge(struct vm_area_struct *vma)
 {
 	unsigned long hstart, hend;
+	if (shmem_huge_enabled(vma))
+		/* khugepaged collapses tmpfs too, see khugepaged_scan_file */
+		goto check_size;
 	if (!vma->anon_vma)
 		/*
 		 * Not yet faulted in so we will register later in the
@@ -1558,9 +1720,10 @@ int khugepaged_enter_vma_merge(struct vm_area_struct *vma)
 		 */
 		return 0;
 	if (vma->vm_file || vma->vm_ops)
-		/* khugepaged not yet working on file or special mappings */
+		/* khugepaged not yet working on other file or special mappings */
 		return 0;
 	VM_BUG_ON(is_linear_pfn_mapping(vma) || is_pfn_mapping(vma));
+check_size:
 	hstart = (vma->vm_start + ~HPAGE_PMD_MASK) & HPAGE_PMD_MASK;
 	hend = vma->vm_end & HPAGE_PMD_MASK;
 	if (hstart < hend)
@@ -1963,6 +2126,103 @@ out:
 	return ret;
 }
 
+/*
+ * Drop the page table mapping the tmpfs pages at @haddr, once they have
+ * been collapsed into a huge page, for the next fault to map them with a
+ * huge pmd.  Called with the mmap_sem held for writing.
+ */
+static void retract_page_table(struct vm_area_struct *vma,
+			       unsigned long haddr)
+{
+	struct mm_struct *mm = vma->vm_mm;
+	struct address_space *mapping = vma->vm_file->f_mapping;
+	pgd_t *pgd;
+	pud_t *pud;
+	pmd_t *pmd, _pmd;
+
+	zap_page_range(vma, haddr, HPAGE_PMD_SIZE, NULL);
+
+	pgd = pgd_offset(mm, haddr);
+	if (!pgd_present(*pgd))
+		return;
+	pud = pud_offset(pgd, haddr);
+	if (!pud_present(*pud))
+		return;
+	pmd = pmd_offset(pud, haddr);
+
+	/* rmap walkers of the file may still be looking at the ptes */
+	spin_lock(&mapping->i_mmap_lock);
+	spin_lock(&mm->page_table_lock);
+	if (!pmd_present(*pmd) || pmd_trans_huge(*pmd)) {
+		spin_unlock(&mm->page_table_lock);
+		spin_unlock(&mapping->i_mmap_lock);
+		return;
+	}
+	_pmd = pmdp_clear_flush_notify(vma, haddr, pmd);
+	mm->nr_ptes--;
+	spin_unlock(&mm->page_table_lock);
+	spin_unlock(&mapping->i_mmap_lock);
+	pte_free(mm, pmd_pgtable(_pmd));
+}
+
+/*
+ * tmpfs pages mapped by ptes are collapsed by migrating them into a
+ * huge page of the page cache (shmem_collapse_huge), then dropping the
+ * page table.  Returns 1 after releasing the mmap_sem.
+ */
+static int khugepaged_scan_file(struct mm_struct *mm,
+				struct vm_area_struct *vma,
+				unsigned long address)
+{
+	struct file *file = vma->vm_file;
+	pgoff_t pgoff = linear_page_index(vma, address);
+	pgd_t *pgd;
+	pud_t *pud;
+	pmd_t *pmd;
+	int collapsed;
+
+	VM_BUG_ON(address & ~HPAGE_PMD_MASK);
+
+	if (pgoff & (HPAGE_PMD_NR-1))
+		return 0;
+	if (vma->anon_vma || vma->vm_flags & (VM_LOCKED | VM_NONLINEAR))
+		return 0;
+
+	pgd = pgd_offset(mm, address);
+	if (!pgd_present(*pgd))
+		return 0;
+	pud = pud_offset(pgd, address);
+	if (!pud_present(*pud))
+		return 0;
+	pmd = pmd_offset(pud, address);
+	if (!pmd_present(*pmd) || pmd_trans_huge(*pmd))
+		return 0;
+
+	get_file(file);
+	up_read(&mm->mmap_sem);
+
+	collapsed = shmem_collapse_huge(file, pgoff);
+	if (collapsed) {
+		down_write(&mm->mmap_sem);
+		if (unlikely(khugepaged_test_exit(mm)))
+			goto out;
+		vma = find_vma(mm, address);
+		if (!vma || vma->vm_file != file ||
+		    vma->vm_start > address ||
+		    vma->vm_end < address + HPAGE_PMD_SIZE ||
+		    linear_page_index(vma, address) != pgoff ||
+		    vma->anon_vma ||
+		    vma->vm_flags & (VM_LOCKED | VM_NONLINEAR))
+			goto out;
+		retract_page_table(vma, address);
+		khugepaged_pages_collapsed++;
+out:
+		up_write(&mm->mmap_sem);
+	}
+	fput(file);
+	return 1;
+}
+
 static void collect_mm_slot(struct mm_slot *mm_slot)
 {
 	struct mm_struct *mm = mm_slot->mm;
@@ -2024,6 +2284,10 @@ static unsigned int khugepaged_scan_mm_slot(unsigned int pages,
 			break;
 		}
 
+		if (shmem_huge_enabled(vma))
+			/* tmpfs mount policy, checked again by collapse */
+			goto scan;
+
 		if ((!(vma->vm_flags & VM_HUGEPAGE) &&
 		     !khugepaged_always()) ||
 		    (vma->vm_flags & VM_NOHUGEPAGE)) {
@@ -2038,6 +2302,7 @@ static unsigned int khugepaged_scan_mm_slot(unsigned int pages,
 			continue;
 		}
 		VM_BUG_ON(is_linear_pfn_mapping(vma) || is_pfn_mapping(vma));
+scan:
 
 		hstart = (vma->vm_start + ~HPAGE_PMD_MASK) & HPAGE_PMD_MASK;
 		hend = vma->vm_end & HPAGE_PMD_MASK;
@@ -2063,9 +2328,13 @@ static unsigned int khugepaged_scan_mm_slot(unsigned int pages,
 			VM_BUG_ON(khugepaged_scan.address < hstart ||
 				  khugepaged_scan.address + HPAGE_PMD_SIZE >
 				  hend);
-			ret = khugepaged_scan_pmd(mm, vma,
-						  khugepaged_scan.address,
-						  hpage);
+			if (vma->vm_file)
+				ret = khugepaged_scan_file(mm, vma,
+						khugepaged_scan.address);
+			else
+				ret = khugepaged_scan_pmd(mm, vma,
+						khugepaged_scan.address,
+						hpage);
 			/* move to next address */
 			khugepaged_scan.address += HPAGE_PMD_SIZE;
 			progress += HPAGE_PMD_NR;
@@ -2260,7 +2529,52 @@ static int khugepaged(void *none)
 	return 0;
 }
 
-void __split_huge_page_pmd(struct mm_struct *mm, pmd_t *pmd)
+/*
+ * The pages of tmpfs mapped by a huge pmd are not a compound page, so
+ * there is nothing to split but the mapping itself: replace the pmd with
+ * the page table deposited for it, filled with the equivalent ptes.
+ * Must be called with the page_table_lock held.
+ */
+void __split_file_huge_pmd(struct mm_struct *mm, unsigned long address,
+			   pmd_t *pmd)
+{
+	unsigned long haddr = address & HPAGE_PMD_MASK;
+	pgtable_t pgtable;
+	pmd_t _pmd, orig_pmd;
+	unsigned long pfn;
+	pgprot_t prot;
+	int i;
+
+	assert_spin_locked(&mm->page_table_lock);
+	VM_BUG_ON(!pmd_trans_huge(*pmd) || PageAnon(pmd_page(*pmd)));
+
+	/*
+	 * Never let huge and small TLB entries coexist, as for anon pages.
+	 * Clearing the pmd atomically also makes sure that no write through
+	 * it gets lost: the hardware cannot set the dirty bit behind us.
+	 */
+	orig_pmd = pmdp_get_and_clear(mm, haddr, pmd);
+	flush_tlb_mm(mm);
+	pfn = pmd_pfn(orig_pmd);
+	/* carries the dirty and accessed bits over to every pte */
+	prot = pmd_pgprot(orig_pmd);
+
+	pgtable = get_pmd_huge_pte(mm);
+	pmd_populate(mm, &_pmd, pgtable);
+	for (i = 0; i < HPAGE_PMD_NR; i++) {
+		pte_t *pte = pte_offset_map(&_pmd, i << PAGE_SHIFT);
+		BUG_ON(!pte_none(*pte));
+		set_pte_at(mm, haddr + (i << PAGE_SHIFT), pte,
+			   pfn_pte(pfn + i, prot));
+		pte_unmap(pte);
+	}
+	mm->nr_ptes++;
+	smp_wmb(); /* make pte visible before pmd */
+	pmd_populate(mm, pmd, pgtable);
+}
+
+void __split_huge_page_pmd(struct mm_struct *mm, unsigned long address,
+			   pmd_t *pmd)
 {
 	struct page *page;
 
@@ -2270,6 +2584,11 @@ void __split_huge_page_pmd(struct mm_struct *mm, pmd_t *pmd)
 		return;
 	}
 	page = pmd_page(*pmd);
+	if (!PageAnon(page)) {
+		__split_file_huge_pmd(mm, address, pmd);
+		spin_unlock(&mm->page_table_lock);
+		return;
+	}
 	VM_BUG_ON(!page_count(page));
 	get_page(page);
 	spin_unlock(&mm->page_table_lock);
@@ -2304,7 +2623,7 @@ static void split_huge_page_address(struct mm_struct *mm,
 	 * Caller holds the mmap_sem write mode, so a huge pmd cannot
 	 * materialize from under us.
 	 */
-	split_huge_page_pmd(mm, pmd);
+	split_huge_page_pmd(mm, address, pmd);
 }
 
 void __vma_adjust_trans_huge(struct vm_area_struct *vma,
@@ -57,6 +57,10 @@
 #include <linux/swapops.h>
 #include <linux/elf.h>
 #include <linux/gfp.h>
+#include <linux/file.h>
+#include <linux/migrate.h>
+#include <linux/log2.h>
+#include <linux/sysctl.h>
 
 #include <asm/io.h>
 #include <asm/pgalloc.h>
@@ -919,6 +923,7 @@ static unsigned long zap_pte_range(struct mmu_gather *tlb,
 	init_rss_vec(rss);
 
 	pte = pte_offset_map_lock(mm, pmd, addr, &ptl);
+	flush_tlb_batched_pending(mm);
 	arch_enter_lazy_mmu_mode();
 	do {
 		pte_t ptent = *pte;
@@ -1017,9 +1022,11 @@ static inline unsigned long zap_pmd_range(struct mmu_gather *tlb,
 		next = pmd_addr_end(addr, end);
 		if (pmd_trans_huge(*pmd)) {
 			if (next-addr != HPAGE_PMD_SIZE) {
-				VM_BUG_ON(!rwsem_is_locked(&tlb->mm->mmap_sem));
-				split_huge_page_pmd(vma->vm_mm, pmd);
-			} else if (zap_huge_pmd(tlb, vma, pmd)) {
+				/* truncation splits tmpfs pmds without it */
+				VM_BUG_ON(!rwsem_is_locked(&tlb->mm->mmap_sem) &&
+					  !vma->vm_file);
+				split_huge_page_pmd(vma->vm_mm, addr, pmd);
+			} else if (zap_huge_pmd(tlb, vma, pmd, addr)) {
 				(*zap_work)--;
 				continue;
 			}
@@ -1308,7 +1315,7 @@ struct page *follow_page(struct vm_area_struct *vma, unsigned long address,
 	}
 	if (pmd_trans_huge(*pmd)) {
 		if (flags & FOLL_SPLIT) {
-			split_huge_page_pmd(mm, pmd);
+			split_huge_page_pmd(mm, address, pmd);
 			goto split_fallthrough;
 		}
 		spin_lock(&mm->page_table_lock);
@@ -1684,7 +1691,8 @@ pte_t *__get_locked_pte(struct mm_struct *mm, unsigned long addr,
 	if (pud) {
 		pmd_t * pmd = pmd_alloc(mm, pud, addr);
 		if (pmd) {
-			VM_BUG_ON(pmd_trans_huge(*pmd));
+			/* remap_file_pages() may hit a huge pmd of tmpfs */
+			split_huge_page_pmd(mm, addr, pmd);
 			return pte_alloc_map_lock(mm, pmd, addr, ptl);
 		}
 	}
@@ -2977,6 +2985,123 @@ oom:
 	return VM_FAULT_OOM;
 }
 
+/**
+ * do_set_pte - setup a new pte for a faulted page
+ * @vma: virtual memory area
+ * @address: user virtual address
+ * @page: page to map
+ * @pte: pointer to the pte, which must be none
+ * @write: true if the page is mapped for a write fault
+ * @anon: true if the page is a new anonymous page
+ *
+ * Called with the page table lock held.  The pte takes over the
+ * caller's reference on @page.
+ */
+void do_set_pte(struct vm_area_struct *vma, unsigned long address,
+		struct page *page, pte_t *pte, bool write, bool anon)
+{
+	pte_t entry;
+
+	flush_icache_page(vma, page);
+	entry = mk_pte(page, vma->vm_page_prot);
+	if (write)
+		entry = maybe_mkwrite(pte_mkdirty(entry), vma);
+	if (anon) {
+		inc_mm_counter_fast(vma->vm_mm, MM_ANONPAGES);
+		page_add_new_anon_rmap(page, vma, address);
+	} else {
+		inc_mm_counter_fast(vma->vm_mm, MM_FILEPAGES);
+		page_add_file_rmap(page);
+	}
+	set_pte_at(vma->vm_mm, address, pte, entry);
+
+	/* no need to invalidate: a not-present page won't be cached */
+	update_mmu_cache(vma, address, pte);
+}
+
+/*
+ * Read faults map the pages already in the page cache in an aligned
+ * window of fault_around_bytes around the faulting address, to save
+ * the faults on the neighbouring pages.  The window never crosses a
+ * page table, so it is at most PTRS_PER_PTE pages; PAGE_SIZE disables
+ * fault-around.
+ */
+unsigned long sysctl_fault_around_bytes __read_mostly = 65536;
+
+static inline unsigned long fault_around_pages(void)
+{
+	return ACCESS_ONCE(sysctl_fault_around_bytes) >> PAGE_SHIFT;
+}
+
+int fault_around_bytes_handler(struct ctl_table *table, int write,
+		void __user *buffer, size_t *length, loff_t *ppos)
+{
+	unsigned long val = sysctl_fault_around_bytes;
+	struct ctl_table t = *table;
+	int ret;
+
+	t.data = &val;
+	ret = proc_doulongvec_minmax(&t, write, buffer, length, ppos);
+	if (ret || !write)
+		return ret;
+
+	if (val / PAGE_SIZE > PTRS_PER_PTE)
+		return -EINVAL;
+	/* rounddown_pow_of_two(0) is undefined */
+	if (val > PAGE_SIZE)
+		sysctl_fault_around_bytes = rounddown_pow_of_two(val);
+	else
+		sysctl_fault_around_bytes = PAGE_SIZE;
+	return 0;
+}
+
+/*
+ * Let ->map_pages() map what it can of the fault-around window, up to
+ * the end of the vma, from the first pte that is still none.  Called
+ * with the page table lock held, @pte being the pte of @address.
+ */
+static void do_fault_around(struct vm_area_struct *vma, unsigned long address,
+		pte_t *pte, pgoff_t pgoff, unsigned int flags)
+{
+	unsigned long nr_pages = fault_around_pages();
+	unsigned long start_addr;
+	pgoff_t max_pgoff;
+	struct vm_fault vmf;
+	int off;
+
+	start_addr = max(address & ~((nr_pages << PAGE_SHIFT) - 1),
+			 vma->vm_start);
+	off = ((address - start_addr) >> PAGE_SHIFT) & (PTRS_PER_PTE - 1);
+	pte -= off;
+	pgoff -= off;
+
+	/*
+	 * max_pgoff is either the end of the page table, the end of the vma
+	 * or the end of the window, whichever is nearest.
+	 */
+	max_pgoff = pgoff - ((start_addr >> PAGE_SHIFT) & (PTRS_PER_PTE - 1)) +
+		PTRS_PER_PTE - 1;
+	max_pgoff = min3(max_pgoff, vma_pages(vma) + vma->vm_pgoff - 1,
+			 pgoff + nr_pages - 1);
+
+	/* Is there anything left to map? */
+	while (!pte_none(*pte)) {
+		if (++pgoff > max_pgoff)
+			return;
+		start_addr += PAGE_SIZE;
+		if (start_addr >= vma->vm_end)
+			return;
+		pte++;
+	}
+
+	vmf.virtual_address = (void __user *)start_addr;
+	vmf.pte = pte;
+	vmf.pgoff = pgoff;
+	vmf.max_pgoff = max_pgoff;
+	vmf.flags = flags;
+	vma->vm_ops->map_pages(vma, &vmf);
+}
+
 /*
  * __do_fault() tries to create a new page mapping. It aggressively
  * tries to share with existing pages, but makes a separate copy if
@@ -2997,7 +3122,6 @@ static int __do_fault(struct mm_struct *mm, struct vm_area_struct *vma,
 	pte_t *page_table;
 	spinlock_t *ptl;
 	struct page *page;
-	pte_t entry;
 	int anon = 0;
 	int charged = 0;
 	struct page *dirty_page = NULL;
@@ -3005,6 +3129,21 @@ static int __do_fault(struct mm_struct *mm, struct vm_area_struct *vma,
 	int ret;
 	int page_mkwrite = 0;
 
+	/*
+	 * Map the cached pages around a read fault first: if the faulting
+	 * page is among them, the fault is done.
+	 */
+	if (!(flags & (FAULT_FLAG_WRITE | FAULT_FLAG_NONLINEAR)) &&
+	    vma->vm_ops->map_pages && fault_around_pages() > 1) {
+		page_table = pte_offset_map_lock(mm, pmd, address, &ptl);
+		do_fault_around(vma, address, page_table, pgoff, flags);
+		if (!pte_same(*page_table, orig_pte)) {
+			pte_unmap_unlock(page_table, ptl);
+			return 0;
+		}
+		pte_unmap_unlock(page_table, ptl);
+	}
+
 	vmf.virtual_address = (void __user *)(address & PAGE_MASK);
 	vmf.pgoff = pgoff;
 	vmf.flags = flags;
@@ -3107,25 +3246,12 @@ static int __do_fault(struct mm_struct *mm, struct vm_area_struct *vma,
 	 */
 	/* Only go through if we didn't race with anybody else... */
 	if (likely(pte_same(*page_table, orig_pte))) {
-		flush_icache_page(vma, page);
-		entry = mk_pte(page, vma->vm_page_prot);
-		if (flags & FAULT_FLAG_WRITE)
-			entry = maybe_mkwrite(pte_mkdirty(entry), vma);
-		if (anon) {
-			inc_mm_counter_fast(mm, MM_ANONPAGES);
-			page_add_new_anon_rmap(page, vma, address);
-		} else {
-			inc_mm_counter_fast(mm, MM_FILEPAGES);
-			page_add_file_rmap(page);
-			if (flags & FAULT_FLAG_WRITE) {
-				dirty_page = page;
-				get_page(dirty_page);
-			}
+		do_set_pte(vma, address, page, page_table,
+			   flags & FAULT_FLAG_WRITE, anon);
+		if (!anon && (flags & FAULT_FLAG_WRITE)) {
+			dirty_page = page;
+			get_page(dirty_page);
 		}
-		set_pte_at(mm, address, page_table, entry);
-
-		/* no need to invalidate: a not-present page won't be cached */
-		update_mmu_cache(vma, address, page_table);
 	} else {
 		if (charged)
 			mem_cgroup_uncharge_page(page);
@@ -3212,6 +3338,54 @@ static int do_nonlinear_fault(struct mm_struct *mm, struct vm_area_struct *vma,
 	return __do_fault(mm, vma, address, pmd, pgoff, flags, orig_pte);
 }
 
+#ifdef CONFIG_NUMA_BALANCING
+/*
+ * A NUMA hinting fault: the pte was made inaccessible by the NUMA
+ * balancing scanner to find out who uses the page, see task_numa_work().
+ * Give the access back, move the page to our node if it is misplaced, and
+ * account the fault to the task.
+ *
+ * We enter with the pte mapped and locked, and leave with both released.
+ */
+static int do_numa_page(struct mm_struct *mm, struct vm_area_struct *vma,
+		unsigned long address, pte_t *page_table, pmd_t *pmd,
+		spinlock_t *ptl, pte_t entry)
+{
+	struct page *page;
+	int page_nid, target_nid;
+	bool migrated = false;
+
+	/* The pte was not present to the MMU: no TLB entry to flush */
+	entry = pte_modify(entry, vma->vm_page_prot);
+	set_pte_at(mm, address, page_table, entry);
+	update_mmu_cache(vma, address, page_table);
+
+	page = vm_normal_page(vma, address, entry);
+	if (!page) {
+		pte_unmap_unlock(page_table, ptl);
+		return 0;
+	}
+	get_page(page);
+	pte_unmap_unlock(page_table, ptl);
+
+	count_vm_event(NUMA_HINT_FAULTS);
+	page_nid = page_to_nid(page);
+	if (page_nid == numa_node_id())
+		count_vm_event(NUMA_HINT_FAULTS_LOCAL);
+
+	target_nid = mpol_misplaced(page, vma, address);
+	if (target_nid == -1)
+		put_page(page);
+	else if (migrate_misplaced_page(page, target_nid)) {
+		page_nid = target_nid;
+		migrated = true;
+	}
+
+	task_numa_fault(page_nid, 1, migrated);
+	return 0;
+}
+#endif
+
 /*
  * These routines also need to handle stuff like marking pages dirty
  * and/or accessed for architectures that don't do it in hardware (most
@@ -3254,6 +3428,10 @@ int handle_pte_fault(struct mm_struct *mm,
 	spin_lock(ptl);
 	if (unlikely(!pte_same(*pte, entry)))
 		goto unlock;
+#ifdef CONFIG_NUMA_BALANCING
+	if (pte_numa(vma, entry))
+		return do_numa_page(mm, vma, address, pte, pmd, ptl, entry);
+#endif
 	if (flags & FAULT_FLAG_WRITE) {
 		if (!pte_write(entry))
 			return do_wp_page(mm, vma, address,
@@ -3306,7 +3484,11 @@ int handle_mm_fault(struct mm_struct *mm, struct vm_area_struct *vma,
 	pmd = pmd_alloc(mm, pud, address);
 	if (!pmd)
 		return VM_FAULT_OOM;
-	if (pmd_none(*pmd) && transparent_hugepage_enabled(vma)) {
+	if (pmd_none(*pmd) && vma->vm_ops && vma->vm_ops->pmd_fault) {
+		int ret = vma->vm_ops->pmd_fault(vma, address, pmd, flags);
+		if (!(ret & VM_FAULT_FALLBACK))
+			return ret;
+	} else if (pmd_none(*pmd) && transparent_hugepage_enabled(vma)) {
 		if (!vma->vm_ops)
 			return do_huge_pmd_anonymous_page(mm, vma, address,
 							  pmd, flags);
@@ -3314,12 +3496,18 @@ int handle_mm_fault(struct mm_struct *mm, struct vm_area_struct *vma,
 		pmd_t orig_pmd = *pmd;
 		barrier();
 		if (pmd_trans_huge(orig_pmd)) {
-			if (flags & FAULT_FLAG_WRITE &&
-			    !pmd_write(orig_pmd) &&
-			    !pmd_trans_splitting(orig_pmd))
+			if (pmd_numa(vma, orig_pmd))
+				return do_huge_pmd_numa_page(mm, vma, address,
+							     pmd, orig_pmd);
+			if (!(flags & FAULT_FLAG_WRITE) ||
+			    pmd_write(orig_pmd) ||
+			    pmd_trans_splitting(orig_pmd))
+				return 0;
+			if (!vma->vm_ops)
 				return do_huge_pmd_wp_page(mm, vma, address,
 							   pmd, orig_pmd);
-			return 0;
+			/* shared file pages are made writable by the ptes */
+			split_huge_page_pmd(mm, address, pmd);
 		}
 	}
 
@@ -3344,6 +3532,353 @@ int handle_mm_fault(struct mm_struct *mm, struct vm_area_struct *vma,
 	return handle_pte_fault(mm, vma, address, pte, pmd, flags);
 }
 
+#ifdef CONFIG_SPECULATIVE_PAGE_FAULT
+/*
+ * Speculative page faults.
+ *
+ * The common faults, the first touch of an anonymous page or of a page
+ * cache page, are handled here without mmap_sem.  The vma is looked up
+ * under RCU and copied, and the fault is handled on the copy.  Every change
+ * to the vma tree, or to the vma fields a fault depends on, bumps
+ * mm->vma_seq, and the pte is only installed if vma_seq has not moved,
+ * which is checked under the pte lock: whoever changes the vmas and then
+ * the page tables, like munmap() or mprotect(), takes that lock after
+ * bumping vma_seq, so it either makes us back off or finds our pte.
+ *
+ * Anything else, and anything we are unsure about, is left to the classic
+ * path: handle_speculative_fault() returns VM_FAULT_RETRY and the caller
+ * then takes mmap_sem and handles the fault as usual.
+ */
+
+/*
+ * Map and lock the pte of @address, if the page tables are populated and
+ * no vma changed since @seq.  Without mmap_sem the page tables may be freed
+ * under us, so they are walked with interrupts disabled like
+ * get_user_pages_fast() does: freeing them waits for a TLB flush IPI to
+ * this cpu.  Once we hold the pte lock, whoever frees them has to take it
+ * first to zap the ptes.  For the same reason the lock is only trylocked.
+ */
+static pte_t *spf_pte_map_lock(struct mm_struct *mm, unsigned long address,
+			       unsigned seq, spinlock_t **ptlp)
+{
+	pgd_t *pgd;
+	pud_t *pud;
+	pmd_t pmdval;
+	pte_t *pte;
+	spinlock_t *ptl;
+	unsigned long flags;
+
+	local_irq_save(flags);
+	pgd = pgd_offset(mm, address);
+	if (pgd_none(*pgd) || unlikely(pgd_bad(*pgd)))
+		goto out;
+	pud = pud_offset(pgd, address);
+	if (pud_none(*pud) || unlikely(pud_bad(*pud)))
+		goto out;
+	pmdval = *pmd_offset(pud, address);
+	barrier();
+	/* No page table yet, or a huge pmd: leave those to the classic path */
+	if (pmd_none(pmdval) || pmd_trans_huge(pmdval) ||
+	    unlikely(pmd_bad(pmdval)))
+		goto out;
+
+	pte = pte_offset_map(&pmdval, address);
+	ptl = pte_lockptr(mm, &pmdval);
+	if (!spin_trylock(ptl)) {
+		pte_unmap(pte);
+		goto out;
+	}
+	if (read_seqcount_retry(&mm->vma_seq, seq)) {
+		pte_unmap_unlock(pte, ptl);
+		goto out;
+	}
+	local_irq_restore(flags);
+	*ptlp = ptl;
+	return pte;
+out:
+	local_irq_restore(flags);
+	return NULL;
+}
+
+/*
+ * Return value for a fault that found its pte no longer none: 0 if the
+ * page got mapped meanwhile.  Swap, migration and nonlinear file entries,
+ * and NUMA hinting ptes, are handled by the classic path only, and have
+ * to go there, or the task would fault on them again and again.
+ */
+static int spf_pte_busy(struct vm_area_struct *vma, pte_t pte)
+{
+	if (pte_present(pte) && !pte_numa(vma, pte))
+		return 0;
+	return VM_FAULT_RETRY;
+}
+
+/*
+ * As do_anonymous_page(), on the copy @vma of the faulting vma.
+ */
+static int spf_anonymous_page(struct mm_struct *mm, struct vm_area_struct *vma,
+		unsigned long address, unsigned int flags, unsigned seq)
+{
+	struct page *page = NULL;
+	spinlock_t *ptl;
+	pte_t *page_table;
+	pte_t entry;
+
+	if (!(flags & FAULT_FLAG_WRITE)) {
+		entry = pte_mkspecial(pfn_pte(my_zero_pfn(address),
+						vma->vm_page_prot));
+	} else {
+		page = alloc_zeroed_user_highpage_movable(vma, address);
+		if (!page)
+			return VM_FAULT_RETRY;
+		__SetPageUptodate(page);
+
+		if (mem_cgroup_newpage_charge(page, mm, GFP_KERNEL)) {
+			page_cache_release(page);
+			return VM_FAULT_RETRY;
+		}
+
+		entry = mk_pte(page, vma->vm_page_prot);
+		if (vma->vm_flags & VM_WRITE)
+			entry = pte_mkwrite(pte_mkdirty(entry));
+	}
+
+	page_table = spf_pte_map_lock(mm, address, seq, &ptl);
+	if (!page_table)
+		goto release;
+	if (!pte_none(*page_table)) {
+		int ret = spf_pte_busy(vma, *page_table);
+
+		pte_unmap_unlock(page_table, ptl);
+		if (page) {
+			mem_cgroup_uncharge_page(page);
+			page_cache_release(page);
+		}
+		return ret;
+	}
+
+	if (page) {
+		inc_mm_counter_fast(mm, MM_ANONPAGES);
+		page_add_new_anon_rmap(page, vma, address);
+	}
+	set_pte_at(mm, address, page_table, entry);
+
+	/* No need to invalidate - it was non-present before */
+	update_mmu_cache(vma, address, page_table);
+	pte_unmap_unlock(page_table, ptl);
+	return 0;
+
+release:
+	if (page) {
+		mem_cgroup_uncharge_page(page);
+		page_cache_release(page);
+	}
+	return VM_FAULT_RETRY;
+}
+
+/*
+ * As __do_fault() for a linear page cache mapping, on the copy @vma of the
+ * faulting vma, whose file the caller holds a reference on.  Shared write
+ * faults are not handled here, they need ->page_mkwrite().
+ */
+static int spf_linear_fault(struct mm_struct *mm, struct vm_area_struct *vma,
+		unsigned long address, unsigned int flags, unsigned seq)
+{
+	struct page *page, *cow_page = NULL;
+	struct vm_fault vmf;
+	spinlock_t *ptl;
+	pte_t *page_table;
+	pte_t entry;
+	int ret;
+
+	vmf.virtual_address = (void __user *)(address & PAGE_MASK);
+	vmf.pgoff = (((address & PAGE_MASK)
+			- vma->vm_start) >> PAGE_SHIFT) + vma->vm_pgoff;
+	/* Never FAULT_FLAG_ALLOW_RETRY: there is no mmap_sem to drop */
+	vmf.flags = flags;
+	vmf.page = NULL;
+
+	/* As in __do_fault(), the pte lock keeping the vma copy valid */
+	if (!(flags & FAULT_FLAG_WRITE) && vma->vm_ops->map_pages &&
+	    fault_around_pages() > 1) {
+		page_table = spf_pte_map_lock(mm, address, seq, &ptl);
+		if (!page_table)
+			return VM_FAULT_RETRY;
+		if (pte_none(*page_table))
+			do_fault_around(vma, address, page_table, vmf.pgoff,
+					flags);
+		if (!pte_none(*page_table)) {
+			ret = spf_pte_busy(vma, *page_table);
+			pte_unmap_unlock(page_table, ptl);
+			return ret;
+		}
+		pte_unmap_unlock(page_table, ptl);
+	}
+
+	ret = vma->vm_ops->fault(vma, &vmf);
+	if (unlikely(ret & (VM_FAULT_ERROR | VM_FAULT_NOPAGE |
+			    VM_FAULT_RETRY)))
+		return VM_FAULT_RETRY;
+
+	page = vmf.page;
+	if (unlikely(!(ret & VM_FAULT_LOCKED)))
+		lock_page(page);
+	else
+		VM_BUG_ON(!PageLocked(page));
+	ret &= VM_FAULT_MAJOR;
+
+	if (unlikely(PageHWPoison(page))) {
+		ret = VM_FAULT_RETRY;
+		goto out;
+	}
+
+	if (flags & FAULT_FLAG_WRITE) {
+		cow_page = alloc_page_vma(GFP_HIGHUSER_MOVABLE, vma, address);
+		if (!cow_page) {
+			ret = VM_FAULT_RETRY;
+			goto out;
+		}
+		if (mem_cgroup_newpage_charge(cow_page, mm, GFP_KERNEL)) {
+			page_cache_release(cow_page);
+			cow_page = NULL;
+			ret = VM_FAULT_RETRY;
+			goto out;
+		}
+		if (vma->vm_flags & VM_LOCKED)
+			clear_page_mlock(page);
+		copy_user_highpage(cow_page, page, address, vma);
+		__SetPageUptodate(cow_page);
+	}
+
+	page_table = spf_pte_map_lock(mm, address, seq, &ptl);
+	if (!page_table) {
+		ret = VM_FAULT_RETRY;
+		goto out;
+	}
+	/* Only go through if we didn't race with anybody else... */
+	if (likely(pte_none(*page_table))) {
+		if (cow_page) {
+			flush_icache_page(vma, cow_page);
+			entry = mk_pte(cow_page, vma->vm_page_prot);
+			entry = maybe_mkwrite(pte_mkdirty(entry), vma);
+			inc_mm_counter_fast(mm, MM_ANONPAGES);
+			page_add_new_anon_rmap(cow_page, vma, address);
+			cow_page = NULL;
+		} else {
+			flush_icache_page(vma, page);
+			entry = mk_pte(page, vma->vm_page_prot);
+			inc_mm_counter_fast(mm, MM_FILEPAGES);
+			page_add_file_rmap(page);
+			/* the pte now holds the page reference */
+			unlock_page(page);
+			page = NULL;
+		}
+		set_pte_at(mm, address, page_table, entry);
+
+		/* no need to invalidate: a not-present page won't be cached */
+		update_mmu_cache(vma, address, page_table);
+	} else if (spf_pte_busy(vma, *page_table))
+		ret = VM_FAULT_RETRY;
+	pte_unmap_unlock(page_table, ptl);
+
+out:
+	if (cow_page) {
+		mem_cgroup_uncharge_page(cow_page);
+		page_cache_release(cow_page);
+	}
+	if (page) {
+		unlock_page(page);
+		page_cache_release(page);
+	}
+	return ret;
+}
+
+/**
+ * handle_speculative_fault - handle a page fault without mmap_sem
+ * @mm: the faulting mm, current->mm
+ * @address: the faulting address
+ * @flags: FAULT_FLAG_WRITE or 0
+ *
+ * Returns VM_FAULT_RETRY if the fault was not handled and has to be retried
+ * the classic way under mmap_sem, including when it should fail: errors are
+ * never reported from here.  Otherwise returns 0 or VM_FAULT_MAJOR.
+ */
+int handle_speculative_fault(struct mm_struct *mm, unsigned long address,
+			     unsigned int flags)
+{
+	struct vm_area_struct *vma, vmc;
+	struct file *file = NULL;
+	unsigned seq;
+	int ret = VM_FAULT_RETRY;
+
+	flags &= FAULT_FLAG_WRITE;
+
+	/* Don't wait for a vma change in progress, take mmap_sem instead */
+	seq = ACCESS_ONCE(mm->vma_seq.sequence);
+	smp_rmb();
+	if (seq & 1)
+		goto out;
+
+	rcu_read_lock();
+	vma = find_vma_rcu(mm, address);
+	if (!vma || vma->vm_start > address)
+		goto out_unlock;
+	vmc = *vma;
+	if (read_seqcount_retry(&mm->vma_seq, seq))
+		goto out_unlock;
+
+	/* Stacks grow under mmap_sem held for read, without vma_seq */
+	if (vmc.vm_flags & (VM_GROWSDOWN | VM_GROWSUP | VM_HUGETLB |
+			    VM_PFNMAP | VM_IO | VM_MIXEDMAP | VM_NONLINEAR))
+		goto out_unlock;
+	if (flags & FAULT_FLAG_WRITE) {
+		if (!(vmc.vm_flags & VM_WRITE))
+			goto out_unlock;
+		/* anon_vma_prepare() needs mmap_sem */
+		if (!vmc.anon_vma)
+			goto out_unlock;
+	} else if (!(vmc.vm_flags & (VM_READ | VM_EXEC | VM_WRITE)))
+		goto out_unlock;
+	/* A vma policy can be freed as soon as we leave RCU */
+	if (vma_policy(&vmc))
+		goto out_unlock;
+
+	if (vmc.vm_ops) {
+		/* Other ->fault handlers may rely on mmap_sem */
+		if (vmc.vm_ops->fault != filemap_fault)
+			goto out_unlock;
+		if ((flags & FAULT_FLAG_WRITE) && (vmc.vm_flags & VM_SHARED))
+			goto out_unlock;
+		/* Files are freed by RCU, and the vma still held it above */
+		file = vmc.vm_file;
+		if (!file || !atomic_long_inc_not_zero(&file->f_count))
+			goto out_unlock;
+	}
+	rcu_read_unlock();
+
+	__set_current_state(TASK_RUNNING);
+	check_sync_rss_stat(current);
+
+	if (file) {
+		ret = spf_linear_fault(mm, &vmc, address, flags, seq);
+		fput(file);
+	} else
+		ret = spf_anonymous_page(mm, &vmc, address, flags, seq);
+out:
+	if (ret & VM_FAULT_RETRY)
+		count_vm_event(SPECULATIVE_PGFAULT_ABORT);
+	else {
+		count_vm_event(PGFAULT);
+		count_vm_event(SPECULATIVE_PGFAULT);
+	}
+	return ret;
+
+out_unlock:
+	rcu_read_unlock();
+	goto out;
+}
+#endif /* CONFIG_SPECULATIVE_PAGE_FAULT */
+
 #ifndef __PAGETABLE_PUD_FOLDED
 /*
  * Allocate page upper directory.
@@ -90,6 +90,7 @@
 #include <linux/syscalls.h>
 #include <linux/ctype.h>
 #include <linux/mm_inline.h>
+#include <linux/mmu_notifier.h>
 
 #include <asm/tlbflush.h>
 #include <asm/uaccess.h>
@@ -514,7 +515,7 @@ static inline int check_pmd_range(struct vm_area_struct *vma, pud_t *pud,
 	pmd = pmd_offset(pud, addr);
 	do {
 		next = pmd_addr_end(addr, end);
-		split_huge_page_pmd(vma->vm_mm, pmd);
+		split_huge_page_pmd(vma->vm_mm, addr, pmd);
 		if (pmd_none_or_clear_bad(pmd))
 			continue;
 		if (check_pte_range(vma, pmd, addr, next, nodes,
@@ -1856,6 +1857,54 @@ alloc_pages_vma(gfp_t gfp, int order, struct vm_area_struct *vma,
 	return page;
 }
 
+#ifdef CONFIG_NUMA_BALANCING
+/**
+ * change_prot_numa - make a range of a vma take NUMA hinting faults
+ * @vma: the vma, which must allow some access
+ * @start: start of the range
+ * @end: end of the range
+ *
+ * Called with mmap_sem held for read by the NUMA balancing scanner, see
+ * task_numa_work().
+ */
+void change_prot_numa(struct vm_area_struct *vma,
+		      unsigned long start, unsigned long end)
+{
+	struct mm_struct *mm = vma->vm_mm;
+
+	mmu_notifier_invalidate_range_start(mm, start, end);
+	change_protection(vma, start, end, vma_prot_none(vma), 0);
+	mmu_notifier_invalidate_range_end(mm, start, end);
+}
+
+/**
+ * mpol_misplaced - check whether a page is on the node it should be on
+ * @page: the page a NUMA hinting fault was taken on
+ * @vma: the vma the page is mapped in
+ * @addr: the virtual address of the page in @vma
+ *
+ * Only pages under the default, local, policy are moved: those that were
+ * placed by an explicit policy are left where the policy put them.
+ *
+ * Returns the node the page should be migrated to, or -1 if it is fine
+ * where it is.
+ */
+int mpol_misplaced(struct page *page, struct vm_area_struct *vma,
+		   unsigned long addr)
+{
+	struct mempolicy *pol = get_vma_policy(current, vma, addr);
+	int this_nid = numa_node_id();
+	int ret = -1;
+
+	if (pol->mode == MPOL_PREFERRED && (pol->flags & MPOL_F_LOCAL) &&
+	    page_to_nid(page) != this_nid &&
+	    node_isset(this_nid, cpuset_current_mems_allowed))
+		ret = this_nid;
+	mpol_cond_put(pol);
+	return ret;
+}
+#endif /* CONFIG_NUMA_BALANCING */
+
 /**
  * 	alloc_pages_current - Allocate pages.
  *
@@ -1898,6 +1947,53 @@ struct page *alloc_pages_current(gfp_t gfp, unsigned order)
 }
 EXPORT_SYMBOL(alloc_pages_current);
 
+/**
+ * alloc_pages_bulk_current - allocate a batch of order-0 pages
+ * @gfp: GFP flags, as for alloc_pages_current()
+ * @nr_pages: the number of pages wanted
+ * @page_list: list to add the pages to, or NULL
+ * @page_array: array to store the pages in, or NULL
+ *
+ * As __alloc_pages_bulk_nodemask(), applying the current process NUMA
+ * policy like alloc_pages_current() does.  Interleaved pages are still
+ * allocated one at a time.
+ */
+unsigned long alloc_pages_bulk_current(gfp_t gfp, unsigned long nr_pages,
+		struct list_head *page_list, struct page **page_array)
+{
+	struct mempolicy *pol = current->mempolicy;
+	unsigned long i, ret = 0;
+
+	if (!pol || in_interrupt() || (gfp & __GFP_THISNODE))
+		pol = &default_policy;
+
+	get_mems_allowed();
+	if (pol->mode != MPOL_INTERLEAVE) {
+		ret = __alloc_pages_bulk_nodemask(gfp, policy_zonelist(gfp, pol),
+				policy_nodemask(gfp, pol), nr_pages,
+				page_list, page_array);
+		put_mems_allowed();
+		return ret;
+	}
+
+	for (i = 0; i < nr_pages; i++, ret++) {
+		struct page *page;
+
+		if (page_array && page_array[i])
+			continue;
+		page = alloc_page_interleave(gfp, 0, interleave_nodes(pol));
+		if (!page)
+			break;
+		if (page_list)
+			list_add(&page->lru, page_list);
+		else
+			page_array[i] = page;
+	}
+	put_mems_allowed();
+	return ret;
+}
+EXPORT_SYMBOL(alloc_pages_bulk_current);
+
 /*
  * If mpol_dup() sees current->cpuset == cpuset_being_rebound, then it
  * rebinds the mempolicy its copying by calling mpol_rebind_policy()
@@ -1358,3 +1358,45 @@ int migrate_vmas(struct mm_struct *mm, const nodemask_t *to,
  	return err;
 }
 #endif
+
+#ifdef CONFIG_NUMA_BALANCING
+static struct page *alloc_misplaced_dst_page(struct page *page,
+					     unsigned long data, int **result)
+{
+	int nid = (int)data;
+
+	return alloc_pages_exact_node(nid, GFP_HIGHUSER_MOVABLE |
+				      GFP_THISNODE | __GFP_NOMEMALLOC, 0);
+}
+
+/*
+ * Move a page that a NUMA hinting fault found on the wrong node to @node.
+ * This is only a hint, so rather than reclaim or wait on the page we give
+ * up, and the page may move on a later fault.  Pages mapped more than once
+ * are left alone: they would bounce between the nodes of their users.
+ *
+ * The caller's reference on @page is dropped.  Returns 1 if the page was
+ * migrated.
+ */
+int migrate_misplaced_page(struct page *page, int node)
+{
+	LIST_HEAD(migratepages);
+
+	if (page_mapcount(page) != 1 || PageCompound(page) || PageKsm(page) ||
+	    isolate_lru_page(page)) {
+		put_page(page);
+		return 0;
+	}
+	inc_zone_page_state(page, NR_ISOLATED_ANON + page_is_file_cache(page));
+	list_add(&page->lru, &migratepages);
+	put_page(page);
+
+	if (migrate_pages(&migratepages, alloc_misplaced_dst_page,
+			  node, false, false)) {
+		putback_lru_pages(&migratepages);
+		return 0;
+	}
+	count_vm_event(NUMA_PAGE_MIGRATE);
+	return 1;
+}
+#endif /* CONFIG_NUMA_BALANCING */
@@ -363,10 +363,12 @@ success:
 	 * set VM_LOCKED, __mlock_vma_pages_range will bring it back.
 	 */
 
+	vma_seq_write_begin(mm);
 	if (lock)
 		vma->vm_flags = newflags;
 	else
 		munlock_vma_pages_range(vma, start, end);
+	vma_seq_write_end(mm);
 
 out:
 	*prev = vma;
@@ -30,6 +30,7 @@
 #include <linux/perf_event.h>
 #include <linux/audit.h>
 #include <linux/khugepaged.h>
+#include <linux/shmem_fs.h>
 
 #include <asm/uaccess.h>
 #include <asm/cacheflush.h>
@@ -224,6 +225,28 @@ void unlink_file_vma(struct vm_area_struct *vma)
 	}
 }
 
+#ifdef CONFIG_SPECULATIVE_PAGE_FAULT
+static void free_vma_rcu(struct rcu_head *head)
+{
+	kmem_cache_free(vm_area_cachep,
+			container_of(head, struct vm_area_struct, vm_rcu));
+}
+#endif
+
+/*
+ * Free a vma that has been linked into its mm: speculative page faults
+ * look vmas up without mmap_sem, so it has to stay around until they
+ * are done with it.
+ */
+static void free_vma(struct vm_area_struct *vma)
+{
+#ifdef CONFIG_SPECULATIVE_PAGE_FAULT
+	call_rcu(&vma->vm_rcu, free_vma_rcu);
+#else
+	kmem_cache_free(vm_area_cachep, vma);
+#endif
+}
+
 /*
  * Close a vm structure and free it, returning the next.
  */
@@ -240,7 +263,7 @@ static struct vm_area_struct *remove_vma(struct vm_area_struct *vma)
 			removed_exe_file_vma(vma->vm_mm);
 	}
 	mpol_put(vma_policy(vma));
-	kmem_cache_free(vm_area_cachep, vma);
+	free_vma(vma);
 	return next;
 }
 
@@ -469,7 +492,9 @@ static void vma_link(struct mm_struct *mm, struct vm_area_struct *vma,
 		vma->vm_truncate_count = mapping->truncate_count;
 	}
 
+	vma_seq_write_begin(mm);
 	__vma_link(mm, vma, prev, rb_link, rb_parent);
+	vma_seq_write_end(mm);
 	__vma_link_file(vma);
 
 	if (mapping)
@@ -599,6 +624,8 @@ again:			remove_next = 1 + (end > next->vm_end);
 
 	vma_adjust_trans_huge(vma, start, end, adjust_next);
 
+	vma_seq_write_begin(mm);
+
 	/*
 	 * When changing only vma->vm_end, we don't really need anon_vma
 	 * lock. This is a fairly rare case by itself, but the anon_vma
@@ -651,6 +678,7 @@ again:			remove_next = 1 + (end > next->vm_end);
 
 	if (anon_vma)
 		anon_vma_unlock(anon_vma);
+	vma_seq_write_end(mm);
 	if (mapping)
 		spin_unlock(&mapping->i_mmap_lock);
 
@@ -664,7 +692,7 @@ again:			remove_next = 1 + (end > next->vm_end);
 			anon_vma_merge(vma, next);
 		mm->map_count--;
 		mpol_put(vma_policy(next));
-		kmem_cache_free(vm_area_cachep, next);
+		free_vma(next);
 		/*
 		 * In mprotect's case 6 (see comments on vma_merge),
 		 * we must remove another next too. It would clutter
@@ -1588,6 +1616,13 @@ get_unmapped_area(struct file *file, unsigned long addr, unsigned long len,
 	get_area = current->mm->get_unmapped_area;
 	if (file && file->f_op && file->f_op->get_unmapped_area)
 		get_area = file->f_op->get_unmapped_area;
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+	else if (!file && (flags & MAP_SHARED)) {
+		/* shmem_zero_setup() will back it with tmpfs, align for it */
+		pgoff = 0;
+		get_area = shmem_get_unmapped_area;
+	}
+#endif
 	addr = get_area(file, addr, len, pgoff, flags);
 	if (IS_ERR_VALUE(addr))
 		return addr;
@@ -1640,6 +1675,40 @@ struct vm_area_struct *find_vma(struct mm_struct *mm, unsigned long addr)
 
 EXPORT_SYMBOL(find_vma);
 
+#ifdef CONFIG_SPECULATIVE_PAGE_FAULT
+/*
+ * Like find_vma(), but without mmap_sem: called under rcu_read_lock(), and
+ * the caller must check mm->vma_seq before trusting the result.  The tree
+ * may be rebalanced under us, so the walk is bounded rather than relying
+ * on it to be well formed.
+ */
+struct vm_area_struct *find_vma_rcu(struct mm_struct *mm, unsigned long addr)
+{
+	struct rb_node *rb_node = ACCESS_ONCE(mm->mm_rb.rb_node);
+	struct vm_area_struct *vma = NULL;
+	int depth = 0;
+
+	while (rb_node) {
+		struct vm_area_struct *vma_tmp;
+
+		/* A red-black tree is at most 2 * log2(n + 1) deep */
+		if (++depth > 2 * BITS_PER_LONG)
+			return NULL;
+
+		vma_tmp = rb_entry(rb_node, struct vm_area_struct, vm_rb);
+
+		if (vma_tmp->vm_end > addr) {
+			vma = vma_tmp;
+			if (vma_tmp->vm_start <= addr)
+				break;
+			rb_node = ACCESS_ONCE(rb_node->rb_left);
+		} else
+			rb_node = ACCESS_ONCE(rb_node->rb_right);
+	}
+	return vma;
+}
+#endif
+
 /* Same as find_vma, but also return a pointer to the previous VMA in *pprev. */
 struct vm_area_struct *
 find_vma_prev(struct mm_struct *mm, unsigned long addr,
@@ -1940,12 +2009,14 @@ detach_vmas_to_be_unmapped(struct mm_struct *mm, struct vm_area_struct *vma,
 
 	insertion_point = (prev ? &prev->vm_next : &mm->mmap);
 	vma->vm_prev = NULL;
+	vma_seq_write_begin(mm);
 	do {
 		rb_erase(&vma->vm_rb, &mm->mm_rb);
 		mm->map_count--;
 		tail_vma = vma;
 		vma = vma->vm_next;
 	} while (vma && vma->vm_start < end);
+	vma_seq_write_end(mm);
 	*insertion_point = vma;
 	if (vma)
 		vma->vm_prev = prev;
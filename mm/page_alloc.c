@@ -2225,6 +2225,140 @@ __alloc_pages_nodemask(gfp_t gfp_mask, unsigned int order,
 }
 EXPORT_SYMBOL(__alloc_pages_nodemask);
 
+/**
+ * __alloc_pages_bulk_nodemask - allocate a batch of order-0 pages
+ * @gfp_mask: GFP flags for the allocation
+ * @zonelist: the zonelist to allocate from
+ * @nodemask: nodes to allocate from, or NULL for all
+ * @nr_pages: the number of pages wanted
+ * @page_list: list to add the pages to, or NULL
+ * @page_array: array to store the pages in, or NULL
+ *
+ * Takes the pages from the per-cpu lists of the first zone that has enough
+ * free pages for the whole batch, refilling them from the buddy lists a
+ * batch at a time, all with interrupts disabled once.  Pages go either on
+ * @page_list, or into the NULL entries of @page_array: entries that are
+ * already set are skipped.  If the batch cannot be taken quickly, a single
+ * page is allocated the usual way, with reclaim if @gfp_mask allows it, so
+ * that callers looping until they have all their pages make progress.
+ *
+ * Returns the number of pages added to @page_list, or the number of set
+ * entries at the start of @page_array.  This may be fewer than @nr_pages.
+ */
+unsigned long
+__alloc_pages_bulk_nodemask(gfp_t gfp_mask, struct zonelist *zonelist,
+			    nodemask_t *nodemask, unsigned long nr_pages,
+			    struct list_head *page_list,
+			    struct page **page_array)
+{
+	enum zone_type high_zoneidx = gfp_zone(gfp_mask);
+	int migratetype = allocflags_to_migratetype(gfp_mask);
+	int cold = !!(gfp_mask & __GFP_COLD);
+	struct zone *preferred_zone, *zone;
+	struct per_cpu_pages *pcp;
+	struct list_head *list;
+	unsigned long nr_populated = 0, nr_allocated = 0;
+	unsigned long flags;
+	struct zoneref *z;
+	struct page *page;
+
+	/* Skip the entries of the array that are already set */
+	while (page_array && nr_populated < nr_pages &&
+	       page_array[nr_populated])
+		nr_populated++;
+	if (nr_populated == nr_pages)
+		return nr_populated;
+
+	/* Not worth the trouble for a single page */
+	if (nr_pages - nr_populated == 1)
+		goto failed;
+
+	gfp_mask &= gfp_allowed_mask;
+	if (unlikely(!zonelist->_zonerefs->zone) ||
+	    should_fail_alloc_page(gfp_mask, 0))
+		goto failed;
+
+	get_mems_allowed();
+	first_zones_zonelist(zonelist, high_zoneidx,
+				nodemask ? : &cpuset_current_mems_allowed,
+				&preferred_zone);
+	if (!preferred_zone)
+		goto failed_put;
+
+	/* The first zone that can afford the rest of the batch */
+	for_each_zone_zonelist_nodemask(zone, z, zonelist,
+						high_zoneidx, nodemask) {
+		if (!cpuset_zone_allowed_softwall(zone,
+						  gfp_mask | __GFP_HARDWALL))
+			continue;
+		if (zone_watermark_ok(zone, 0, low_wmark_pages(zone) +
+				      nr_pages - nr_populated,
+				      zone_idx(preferred_zone),
+				      ALLOC_WMARK_LOW | ALLOC_CPUSET))
+			break;
+	}
+	if (!zone)
+		goto failed_put;
+
+	local_irq_save(flags);
+	pcp = &this_cpu_ptr(zone->pageset)->pcp;
+	list = &pcp->lists[migratetype];
+	while (nr_populated < nr_pages) {
+		if (page_array && page_array[nr_populated]) {
+			nr_populated++;
+			continue;
+		}
+
+		if (list_empty(list)) {
+			pcp->count += rmqueue_bulk(zone, 0, pcp->batch, list,
+						   migratetype, cold);
+			if (unlikely(list_empty(list)))
+				break;
+		}
+
+		if (cold)
+			page = list_entry(list->prev, struct page, lru);
+		else
+			page = list_entry(list->next, struct page, lru);
+		list_del(&page->lru);
+		pcp->count--;
+		zone_statistics(preferred_zone, zone);
+
+		VM_BUG_ON(bad_range(zone, page));
+		if (prep_new_page(page, 0, gfp_mask))
+			continue;
+
+		nr_allocated++;
+		trace_mm_page_alloc(page, 0, gfp_mask, migratetype);
+		if (page_list)
+			list_add(&page->lru, page_list);
+		else
+			page_array[nr_populated] = page;
+		nr_populated++;
+	}
+	__count_zone_vm_events(PGALLOC, zone, nr_allocated);
+	local_irq_restore(flags);
+	put_mems_allowed();
+
+	if (nr_allocated || nr_populated == nr_pages)
+		return nr_populated;
+	goto failed;
+
+failed_put:
+	put_mems_allowed();
+failed:
+	page = __alloc_pages_nodemask(gfp_mask, 0, zonelist, nodemask);
+	if (page) {
+		if (page_list)
+			list_add(&page->lru, page_list);
+		else
+			page_array[nr_populated] = page;
+		nr_populated++;
+	}
+	return nr_populated;
+}
+EXPORT_SYMBOL(__alloc_pages_bulk_nodemask);
+
 /*
  * Common helper functions.
  */
@@ -4135,6 +4269,9 @@ static void __paginginit free_area_init_core(struct pglist_data *pgdat,
 	pgdat_resize_init(pgdat);
 	pgdat->nr_zones = 0;
 	init_waitqueue_head(&pgdat->kswapd_wait);
+#ifdef CONFIG_COMPACTION
+	init_waitqueue_head(&pgdat->kcompactd_wait);
+#endif
 	pgdat->kswapd_max_order = 0;
 	pgdat_page_cgroup_init(pgdat);
 	
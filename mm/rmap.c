@@ -31,11 +31,12 @@
  *             swap_lock (in swap_duplicate, swap_info_get)
  *               mmlist_lock (in mmput, drain_mmlist and others)
  *               mapping->private_lock (in __set_page_dirty_buffers)
- *               inode_lock (in set_page_dirty's __mark_inode_dirty)
- *                 sb_lock (within inode_lock in fs/fs-writeback.c)
+ *               inode_wb_list_lock (in set_page_dirty's __mark_inode_dirty)
+ *                 inode->i_lock (in set_page_dirty's __mark_inode_dirty)
+ *                 sb_lock (within inode_wb_list_lock in fs/fs-writeback.c)
  *                 mapping->tree_lock (widely used, in set_page_dirty,
  *                           in arch-dependent flush_dcache_mmap_lock,
- *                           within inode_lock in __sync_single_inode)
+ *                           within inode_wb_list_lock in __sync_single_inode)
  *
  * (code doesn't rely on that order so it could be switched around)
  * ->tasklist_lock
@@ -529,8 +530,19 @@ int page_referenced_one(struct page *page, struct vm_area_struct *vma,
 		spinlock_t *ptl;
 
 		pte = page_check_address(page, mm, address, &ptl, 0);
-		if (!pte)
-			goto out;
+		if (!pte) {
+			pmd_t *pmd;
+
+			/* tmpfs pages may be mapped by a huge pmd */
+			pmd = page_check_file_pmd(page, mm, address);
+			if (!pmd)
+				goto out;
+			if (pmdp_clear_flush_young_notify(vma,
+					address & HPAGE_PMD_MASK, pmd))
+				referenced++;
+			spin_unlock(&mm->page_table_lock);
+			goto mapped;
+		}
 
 		if (ptep_clear_flush_young_notify(vma, address, pte)) {
 			/*
@@ -545,7 +557,7 @@ int page_referenced_one(struct page *page, struct vm_area_struct *vma,
 		}
 		pte_unmap_unlock(pte, ptl);
 	}
-
+mapped:
 	(*mapcount)--;
 
 	if (referenced)
@@ -992,6 +1004,128 @@ void page_remove_rmap(struct page *page)
 	 */
 }
 
+#ifdef CONFIG_ARCH_WANT_BATCHED_UNMAP_TLB_FLUSH
+/*
+ * Reclaim unmaps pages by the batch, and flushing the TLBs for every pte
+ * it clears would send an IPI to every CPU of the mm for every page.
+ * Instead, with TTU_BATCH_FLUSH, try_to_unmap_one() only collects the
+ * CPUs that may cache the ptes, and the caller flushes them all at once
+ * with try_to_unmap_flush() before freeing the pages.
+ *
+ * Until then, other CPUs may still read the pages through stale TLB
+ * entries, but they cannot write to a page whose pte was clean: the CPU
+ * would have to walk the page tables to set the dirty bit. The pages
+ * whose pte was dirty must be flushed before they are written out, by
+ * try_to_unmap_flush_dirty(), or a write could be lost under the I/O.
+ */
+static void percpu_flush_tlb_batch_pages(void *data)
+{
+	local_flush_tlb();
+}
+
+/**
+ * try_to_unmap_flush - flush the TLBs for the ptes cleared with
+ * TTU_BATCH_FLUSH by the current task
+ */
+void try_to_unmap_flush(void)
+{
+	struct tlbflush_unmap_batch *tlb_ubc = &current->tlb_ubc;
+	int cpu;
+
+	if (!tlb_ubc->flush_required)
+		return;
+
+	cpu = get_cpu();
+
+	if (cpumask_test_cpu(cpu, &tlb_ubc->cpumask))
+		percpu_flush_tlb_batch_pages(NULL);
+
+	if (cpumask_any_but(&tlb_ubc->cpumask, cpu) < nr_cpu_ids)
+		smp_call_function_many(&tlb_ubc->cpumask,
+				percpu_flush_tlb_batch_pages, NULL, true);
+
+	cpumask_clear(&tlb_ubc->cpumask);
+	tlb_ubc->flush_required = false;
+	tlb_ubc->writable = false;
+	put_cpu();
+}
+
+/* Flush if any of the ptes cleared was dirty, before writing the pages */
+void try_to_unmap_flush_dirty(void)
+{
+	struct tlbflush_unmap_batch *tlb_ubc = &current->tlb_ubc;
+
+	if (tlb_ubc->writable)
+		try_to_unmap_flush();
+}
+
+static void set_tlb_ubc_flush_pending(struct mm_struct *mm, bool writable)
+{
+	struct tlbflush_unmap_batch *tlb_ubc = &current->tlb_ubc;
+
+	cpumask_or(&tlb_ubc->cpumask, &tlb_ubc->cpumask, mm_cpumask(mm));
+	tlb_ubc->flush_required = true;
+
+	/*
+	 * Tell flush_tlb_batched_pending() that a flush is pending: set
+	 * under the page table lock, after the pte was cleared.
+	 */
+	barrier();
+	mm->tlb_flush_batched = true;
+
+	if (writable)
+		tlb_ubc->writable = true;
+}
+
+/*
+ * Only defer the flush if other CPUs may cache the pte: flushing the
+ * local TLB right away is cheap.
+ */
+static bool should_defer_flush(struct mm_struct *mm, enum ttu_flags flags)
+{
+	bool should_defer = false;
+
+	if (!(flags & TTU_BATCH_FLUSH))
+		return false;
+
+	if (cpumask_any_but(mm_cpumask(mm), get_cpu()) < nr_cpu_ids)
+		should_defer = true;
+	put_cpu();
+
+	return should_defer;
+}
+
+/**
+ * flush_tlb_batched_pending - flush the TLBs of an mm if reclaim did not
+ * @mm: the mm whose page tables are about to be changed
+ *
+ * Reclaim may have cleared ptes of @mm without flushing the TLBs yet.
+ * munmap, mprotect, mremap and MADV_FREE decide whether to flush from
+ * the ptes they find, so they must flush themselves first: called with
+ * the page table lock held, which orders this against reclaim setting
+ * the flag.
+ */
+void flush_tlb_batched_pending(struct mm_struct *mm)
+{
+	if (mm->tlb_flush_batched) {
+		flush_tlb_mm(mm);
+
+		/* Do not clear the flag before the flush is done */
+		barrier();
+		mm->tlb_flush_batched = false;
+	}
+}
+#else
+static void set_tlb_ubc_flush_pending(struct mm_struct *mm, bool writable)
+{
+}
+
+static bool should_defer_flush(struct mm_struct *mm, enum ttu_flags flags)
+{
+	return false;
+}
+#endif /* CONFIG_ARCH_WANT_BATCHED_UNMAP_TLB_FLUSH */
+
 /*
  * Subfunctions of try_to_unmap: try_to_unmap_one called
  * repeatedly from either try_to_unmap_anon or try_to_unmap_file.
@@ -1006,8 +1140,19 @@ int try_to_unmap_one(struct page *page, struct vm_area_struct *vma,
 	int ret = SWAP_AGAIN;
 
 	pte = page_check_address(page, mm, address, &ptl, 0);
-	if (!pte)
-		goto out;
+	if (!pte) {
+		pmd_t *pmd;
+
+		/* Split a huge pmd of tmpfs pages to unmap just this one */
+		pmd = page_check_file_pmd(page, mm, address);
+		if (!pmd)
+			goto out;
+		__split_file_huge_pmd(mm, address, pmd);
+		spin_unlock(&mm->page_table_lock);
+		pte = page_check_address(page, mm, address, &ptl, 0);
+		if (!pte)
+			goto out;
+	}
 
 	/*
 	 * If the page is mlock()d, we cannot swap it out.
@@ -1030,7 +1175,16 @@ int try_to_unmap_one(struct page *page, struct vm_area_struct *vma,
 
 	/* Nuke the page table entry. */
 	flush_cache_page(vma, address, page_to_pfn(page));
-	pteval = ptep_clear_flush_notify(vma, address, pte);
+	if (should_defer_flush(mm, flags)) {
+		/*
+		 * The caller flushes the TLBs before the page is freed or
+		 * written, see try_to_unmap_flush().
+		 */
+		pteval = ptep_get_and_clear(mm, address, pte);
+		set_tlb_ubc_flush_pending(mm, pte_dirty(pteval));
+		mmu_notifier_invalidate_page(mm, address);
+	} else
+		pteval = ptep_clear_flush_notify(vma, address, pte);
 
 	/* Move the dirty bit to the physical page now the pte is gone. */
 	if (pte_dirty(pteval))
@@ -1067,6 +1221,19 @@ int try_to_unmap_one(struct page *page, struct vm_area_struct *vma,
 			}
 			dec_mm_counter(mm, MM_ANONPAGES);
 			inc_mm_counter(mm, MM_SWAPENTS);
+		} else if (flags & TTU_LAZYFREE) {
+			/*
+			 * A page that MADV_FREE cleaned can be dropped, unless
+			 * it was written to again since: then put the pte
+			 * back and keep the page.
+			 */
+			if (PageDirty(page)) {
+				set_pte_at(mm, address, pte, pteval);
+				ret = SWAP_FAIL;
+				goto out_unmap;
+			}
+			dec_mm_counter(mm, MM_ANONPAGES);
+			goto discard;
 		} else if (PAGE_MIGRATION) {
 			/*
 			 * Store the pfn of the page in a special migration
@@ -1086,6 +1253,7 @@ int try_to_unmap_one(struct page *page, struct vm_area_struct *vma,
 	} else
 		dec_mm_counter(mm, MM_FILEPAGES);
 
+discard:
 	page_remove_rmap(page);
 	page_cache_release(page);
 
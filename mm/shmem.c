@@ -57,6 +57,8 @@ static struct vfsmount *shm_mnt;
 #include <linux/namei.h>
 #include <linux/ctype.h>
 #include <linux/migrate.h>
+#include <linux/mm_inline.h>
+#include <linux/khugepaged.h>
 #include <linux/highmem.h>
 #include <linux/seq_file.h>
 #include <linux/magic.h>
@@ -65,6 +67,8 @@ static struct vfsmount *shm_mnt;
 #include <asm/div64.h>
 #include <asm/pgtable.h>
 
+#include "internal.h"
+
 /*
  * The maximum size of a shmem/tmpfs file is limited by the maximum size of
  * its triple-indirect swap vector - see illustration at shmem_swp_entry().
@@ -119,8 +123,15 @@ static unsigned long shmem_default_max_inodes(void)
 }
 #endif
 
-static int shmem_getpage(struct inode *inode, unsigned long idx,
-			 struct page **pagep, enum sgp_type sgp, int *type);
+static int __shmem_getpage(struct inode *inode, unsigned long idx,
+			   struct page **pagep, enum sgp_type sgp, int *type,
+			   struct page *prealloc_page);
+
+static inline int shmem_getpage(struct inode *inode, unsigned long idx,
+			struct page **pagep, enum sgp_type sgp, int *type)
+{
+	return __shmem_getpage(inode, idx, pagep, sgp, type, NULL);
+}
 
 static inline struct page *shmem_dir_alloc(gfp_t gfp_mask)
 {
@@ -1214,23 +1225,27 @@ static inline struct mempolicy *shmem_get_sbmpol(struct shmem_sb_info *sbinfo)
  * If we allocate a new one we do not mark it dirty. That's up to the
  * vm. If we swap it in we mark it dirty since we also free the swap
  * entry since a page cannot live in both the swap and page cache
+ *
+ * __shmem_getpage may be given a prealloc_page, already charged, to use
+ * if a new page is needed: it is released if not.
  */
-static int shmem_getpage(struct inode *inode, unsigned long idx,
-			struct page **pagep, enum sgp_type sgp, int *type)
+static int __shmem_getpage(struct inode *inode, unsigned long idx,
+			   struct page **pagep, enum sgp_type sgp, int *type,
+			   struct page *prealloc_page)
 {
 	struct address_space *mapping = inode->i_mapping;
 	struct shmem_inode_info *info = SHMEM_I(inode);
 	struct shmem_sb_info *sbinfo;
 	struct page *filepage = *pagep;
 	struct page *swappage;
-	struct page *prealloc_page = NULL;
 	swp_entry_t *entry;
 	swp_entry_t swap;
 	gfp_t gfp;
 	int error;
 
+	error = -EFBIG;
 	if (idx >= SHMEM_MAX_INDEX)
-		return -EFBIG;
+		goto out;
 
 	if (type)
 		*type = 0;
@@ -1506,6 +1521,512 @@ out:
 	return error;
 }
 
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+/*
+ * tmpfs huge pages: a naturally aligned extent of HPAGE_PMD_NR pages of
+ * the page cache is allocated from one high order page, then split, so
+ * that each page is otherwise an ordinary tmpfs page: it can be swapped
+ * out, truncated or migrated on its own.  As long as the extent stays
+ * physically contiguous, shared mappings can map it with a huge pmd.
+ */
+
+/* Mount option values, also sbinfo->huge */
+#define SHMEM_HUGE_NEVER	0
+#define SHMEM_HUGE_ALWAYS	1
+#define SHMEM_HUGE_WITHIN_SIZE	2
+#define SHMEM_HUGE_ADVISE	3
+
+/* Special values for /sys/kernel/mm/transparent_hugepage/shmem_enabled */
+#define SHMEM_HUGE_DENY		(-1)	/* for emergencies: disable everywhere */
+#define SHMEM_HUGE_FORCE	(-2)	/* for testing: enable everywhere */
+
+/* Also the huge= option of the internal mount, unless DENY or FORCE */
+static int shmem_huge __read_mostly;
+
+static bool shmem_huge_wanted(struct inode *inode, pgoff_t index,
+			      struct vm_area_struct *vma)
+{
+	loff_t i_size;
+
+	if (shmem_huge == SHMEM_HUGE_DENY)
+		return false;
+	if (shmem_huge == SHMEM_HUGE_FORCE)
+		return true;
+	if (vma && (vma->vm_flags & VM_NOHUGEPAGE))
+		return false;
+
+	switch (SHMEM_SB(inode->i_sb)->huge) {
+	case SHMEM_HUGE_ALWAYS:
+		return true;
+	case SHMEM_HUGE_WITHIN_SIZE:
+		index = round_up(index + 1, HPAGE_PMD_NR);
+		i_size = round_up(i_size_read(inode), PAGE_CACHE_SIZE);
+		return (i_size >> PAGE_CACHE_SHIFT) >= index;
+	case SHMEM_HUGE_ADVISE:
+		return vma && (vma->vm_flags & VM_HUGEPAGE);
+	default:
+		return false;
+	}
+}
+
+/* Whether khugepaged should look at the tmpfs pages mapped by @vma */
+bool shmem_huge_enabled(struct vm_area_struct *vma)
+{
+	struct inode *inode;
+
+	/* SysV shm segments are tmpfs files behind their own vm_ops */
+	if (!vma->vm_file || !(vma->vm_flags & VM_SHARED) ||
+	    vma->vm_file->f_mapping->a_ops != &shmem_aops)
+		return false;
+	inode = vma->vm_file->f_path.dentry->d_inode;
+	return shmem_huge_wanted(inode,
+			round_up(vma->vm_pgoff, HPAGE_PMD_NR), vma);
+}
+
+#if defined(CONFIG_SYSFS) || defined(CONFIG_TMPFS)
+static int shmem_parse_huge(const char *str)
+{
+	if (!strcmp(str, "never"))
+		return SHMEM_HUGE_NEVER;
+	if (!strcmp(str, "always"))
+		return SHMEM_HUGE_ALWAYS;
+	if (!strcmp(str, "within_size"))
+		return SHMEM_HUGE_WITHIN_SIZE;
+	if (!strcmp(str, "advise"))
+		return SHMEM_HUGE_ADVISE;
+	if (!strcmp(str, "deny"))
+		return SHMEM_HUGE_DENY;
+	if (!strcmp(str, "force"))
+		return SHMEM_HUGE_FORCE;
+	return -EINVAL;
+}
+
+static const char *shmem_format_huge(int huge)
+{
+	switch (huge) {
+	case SHMEM_HUGE_NEVER:
+		return "never";
+	case SHMEM_HUGE_ALWAYS:
+		return "always";
+	case SHMEM_HUGE_WITHIN_SIZE:
+		return "within_size";
+	case SHMEM_HUGE_ADVISE:
+		return "advise";
+	case SHMEM_HUGE_DENY:
+		return "deny";
+	case SHMEM_HUGE_FORCE:
+		return "force";
+	default:
+		VM_BUG_ON(1);
+		return "bad_val";
+	}
+}
+#endif
+
+#ifdef CONFIG_SYSFS
+static ssize_t shmem_enabled_show(struct kobject *kobj,
+				  struct kobj_attribute *attr, char *buf)
+{
+	static const int values[] = {
+		SHMEM_HUGE_ALWAYS,
+		SHMEM_HUGE_WITHIN_SIZE,
+		SHMEM_HUGE_ADVISE,
+		SHMEM_HUGE_NEVER,
+		SHMEM_HUGE_DENY,
+		SHMEM_HUGE_FORCE,
+	};
+	int i, count;
+
+	for (i = 0, count = 0; i < ARRAY_SIZE(values); i++) {
+		const char *fmt = shmem_huge == values[i] ? "[%s] " : "%s ";
+
+		count += sprintf(buf + count, fmt,
+				 shmem_format_huge(values[i]));
+	}
+	buf[count - 1] = '\n';
+	return count;
+}
+
+static ssize_t shmem_enabled_store(struct kobject *kobj,
+				   struct kobj_attribute *attr,
+				   const char *buf, size_t count)
+{
+	char tmp[16];
+	int huge;
+
+	if (count + 1 > sizeof(tmp))
+		return -EINVAL;
+	memcpy(tmp, buf, count);
+	tmp[count] = '\0';
+	if (count && tmp[count - 1] == '\n')
+		tmp[count - 1] = '\0';
+
+	huge = shmem_parse_huge(tmp);
+	if (huge == -EINVAL)
+		return -EINVAL;
+
+	shmem_huge = huge;
+	if (shmem_huge >= SHMEM_HUGE_NEVER && !IS_ERR(shm_mnt))
+		SHMEM_SB(shm_mnt->mnt_sb)->huge = shmem_huge;
+	return count;
+}
+
+struct kobj_attribute shmem_enabled_attr =
+	__ATTR(shmem_enabled, 0644, shmem_enabled_show, shmem_enabled_store);
+#endif /* CONFIG_SYSFS */
+
+#ifdef CONFIG_NUMA
+static struct page *shmem_alloc_hugepage(gfp_t gfp,
+			struct shmem_inode_info *info, unsigned long idx)
+{
+	struct vm_area_struct pvma;
+
+	/* Create a pseudo vma that just contains the policy */
+	pvma.vm_start = 0;
+	pvma.vm_pgoff = idx;
+	pvma.vm_ops = NULL;
+	pvma.vm_policy = mpol_shared_policy_lookup(&info->policy, idx);
+
+	/*
+	 * alloc_pages_vma() will drop the shared policy reference
+	 */
+	return alloc_pages_vma(gfp, HPAGE_PMD_ORDER, &pvma, 0);
+}
+#else /* !CONFIG_NUMA */
+static inline struct page *shmem_alloc_hugepage(gfp_t gfp,
+			struct shmem_inode_info *info, unsigned long idx)
+{
+	return alloc_pages(gfp, HPAGE_PMD_ORDER);
+}
+#endif /* CONFIG_NUMA */
+
+static inline gfp_t shmem_hugepage_gfp(struct address_space *mapping)
+{
+	/* Not worth reclaiming hard for: the small pages will do */
+	return mapping_gfp_mask(mapping) | __GFP_NORETRY | __GFP_NOWARN;
+}
+
+/*
+ * Populate the naturally aligned extent around @idx, none of which is in
+ * the page cache yet, with the pages of one huge page allocation.  This
+ * is only an optimization: what is left is allocated by shmem_getpage.
+ */
+static void shmem_alloc_huge(struct inode *inode, unsigned long idx,
+			     enum sgp_type sgp)
+{
+	struct address_space *mapping = inode->i_mapping;
+	unsigned long base = idx & ~(HPAGE_PMD_NR - 1UL);
+	struct page *extent, *page;
+	int i;
+
+	if (base + HPAGE_PMD_NR > SHMEM_MAX_INDEX)
+		return;
+	if (sgp != SGP_WRITE && ((loff_t)(base + HPAGE_PMD_NR) <<
+				 PAGE_CACHE_SHIFT) > i_size_read(inode))
+		return;
+	if (find_get_pages(mapping, base, 1, &page)) {
+		bool present = page->index < base + HPAGE_PMD_NR;
+
+		page_cache_release(page);
+		if (present)
+			return;
+	}
+
+	extent = shmem_alloc_hugepage(shmem_hugepage_gfp(mapping),
+				      SHMEM_I(inode), base);
+	if (!extent)
+		return;
+	split_page(extent, HPAGE_PMD_ORDER);
+
+	for (i = 0; i < HPAGE_PMD_NR; i++) {
+		if (mem_cgroup_cache_charge(extent + i, current->mm,
+					    GFP_KERNEL))
+			break;
+		page = NULL;
+		if (__shmem_getpage(inode, base + i, &page, sgp, NULL,
+				    extent + i)) {
+			i++;
+			break;
+		}
+		unlock_page(page);
+		page_cache_release(page);
+	}
+	while (i < HPAGE_PMD_NR)
+		__free_page(extent + i++);
+}
+
+/*
+ * Lock the pages following the locked @page, head of its extent, if they
+ * are its physically contiguous successors and uptodate; with references.
+ */
+static bool shmem_lock_extent(struct address_space *mapping, struct page *page)
+{
+	struct page *sub = NULL;
+	int i;
+
+	if (page_to_pfn(page) & (HPAGE_PMD_NR - 1))
+		return false;
+
+	for (i = 1; i < HPAGE_PMD_NR; i++) {
+		sub = find_get_page(mapping, page->index + i);
+		if (sub != page + i)
+			goto out_put;
+		if (!trylock_page(sub))
+			goto out_put;
+		if (sub->mapping != mapping || !PageUptodate(sub)) {
+			unlock_page(sub);
+			goto out_put;
+		}
+	}
+	return true;
+
+out_put:
+	if (sub)
+		page_cache_release(sub);
+	while (--i > 0) {
+		unlock_page(page + i);
+		page_cache_release(page + i);
+	}
+	return false;
+}
+
+static int shmem_pmd_fault(struct vm_area_struct *vma, unsigned long address,
+			   pmd_t *pmd, unsigned int flags)
+{
+	struct inode *inode = vma->vm_file->f_path.dentry->d_inode;
+	unsigned long haddr = address & HPAGE_PMD_MASK;
+	unsigned long idx;
+	struct page *page = NULL;
+	int error, ret, i;
+
+	if (!(vma->vm_flags & VM_SHARED) || (vma->vm_flags & VM_NONLINEAR))
+		return VM_FAULT_FALLBACK;
+	if (haddr < vma->vm_start || haddr + HPAGE_PMD_SIZE > vma->vm_end)
+		return VM_FAULT_FALLBACK;
+	idx = linear_page_index(vma, haddr);
+	if (idx & (HPAGE_PMD_NR - 1))
+		return VM_FAULT_FALLBACK;
+	if (!shmem_huge_wanted(inode, idx, vma))
+		return VM_FAULT_FALLBACK;
+	if (((loff_t)(idx + HPAGE_PMD_NR) << PAGE_CACHE_SHIFT) >
+	    i_size_read(inode))
+		return VM_FAULT_FALLBACK;
+
+	/* for khugepaged to collapse whatever falls back to small pages */
+	if (!test_bit(MMF_VM_HUGEPAGE, &vma->vm_mm->flags) &&
+	    unlikely(__khugepaged_enter(vma->vm_mm)))
+		return VM_FAULT_OOM;
+
+	shmem_alloc_huge(inode, idx, SGP_CACHE);
+	error = shmem_getpage(inode, idx, &page, SGP_CACHE, &ret);
+	if (error)
+		return VM_FAULT_FALLBACK;
+	if (!shmem_lock_extent(inode->i_mapping, page)) {
+		unlock_page(page);
+		page_cache_release(page);
+		return ret | VM_FAULT_FALLBACK;
+	}
+
+	/* Truncation takes the page locks after updating i_size */
+	if (((loff_t)(idx + HPAGE_PMD_NR) << PAGE_CACHE_SHIFT) >
+	    i_size_read(inode))
+		ret |= VM_FAULT_FALLBACK;
+	else
+		ret |= map_file_huge_pmd(vma, haddr, pmd, page, flags);
+
+	for (i = 0; i < HPAGE_PMD_NR; i++) {
+		unlock_page(page + i);
+		if (ret & VM_FAULT_FALLBACK)
+			page_cache_release(page + i);
+	}
+	return ret;
+}
+
+struct shmem_collapse_control {
+	struct page *extent;
+	DECLARE_BITMAP(used, HPAGE_PMD_NR);
+};
+
+static struct page *shmem_collapse_alloc(struct page *page,
+					 unsigned long private, int **result)
+{
+	struct shmem_collapse_control *cc = (void *)private;
+	int i = page->index & (HPAGE_PMD_NR - 1);
+
+	if (test_and_set_bit(i, cc->used))
+		return NULL;
+	return cc->extent + i;
+}
+
+static bool shmem_extent_contiguous(struct address_space *mapping,
+				    unsigned long idx)
+{
+	struct page *head, *page;
+	bool ret = false;
+	int i;
+
+	head = find_get_page(mapping, idx);
+	if (!head)
+		return false;
+	if (page_to_pfn(head) & (HPAGE_PMD_NR - 1))
+		goto out;
+	for (i = 1; i < HPAGE_PMD_NR; i++) {
+		page = find_get_page(mapping, idx + i);
+		if (page)
+			page_cache_release(page);
+		if (page != head + i)
+			goto out;
+	}
+	ret = true;
+out:
+	page_cache_release(head);
+	return ret;
+}
+
+/*
+ * Called by khugepaged on the extent around @index of a tmpfs file which
+ * is mapped by small pages: migrate its pages into one huge page
+ * allocation.  Returns true if the extent may now be mapped hugely.
+ */
+bool shmem_collapse_huge(struct file *file, pgoff_t index)
+{
+	struct inode *inode = file->f_path.dentry->d_inode;
+	struct address_space *mapping = inode->i_mapping;
+	struct shmem_collapse_control cc;
+	LIST_HEAD(pagelist);
+	struct page *page;
+	int i;
+
+	index &= ~(HPAGE_PMD_NR - 1UL);
+	if (shmem_huge == SHMEM_HUGE_DENY)
+		return false;
+	if (((loff_t)(index + HPAGE_PMD_NR) << PAGE_CACHE_SHIFT) >
+	    i_size_read(inode))
+		return false;
+	if (shmem_extent_contiguous(mapping, index))
+		return true;
+
+	/* The whole extent is to be mapped: fill in any holes first */
+	for (i = 0; i < HPAGE_PMD_NR; i++) {
+		page = NULL;
+		if (shmem_getpage(inode, index + i, &page, SGP_CACHE, NULL))
+			return false;
+		unlock_page(page);
+		page_cache_release(page);
+	}
+
+	cc.extent = shmem_alloc_hugepage(shmem_hugepage_gfp(mapping),
+					 SHMEM_I(inode), index);
+	if (!cc.extent)
+		return false;
+	split_page(cc.extent, HPAGE_PMD_ORDER);
+	bitmap_zero(cc.used, HPAGE_PMD_NR);
+
+	migrate_prep();
+	for (i = 0; i < HPAGE_PMD_NR; i++) {
+		page = find_get_page(mapping, index + i);
+		if (!page)
+			break;
+		if (isolate_lru_page(page)) {
+			page_cache_release(page);
+			break;
+		}
+		inc_zone_page_state(page, NR_ISOLATED_ANON +
+				    page_is_file_cache(page));
+		list_add_tail(&page->lru, &pagelist);
+		page_cache_release(page);
+	}
+	if (i == HPAGE_PMD_NR)
+		migrate_pages(&pagelist, shmem_collapse_alloc,
+			      (unsigned long)&cc, false, true);
+	putback_lru_pages(&pagelist);
+
+	for (i = 0; i < HPAGE_PMD_NR; i++)
+		if (!test_bit(i, cc.used))
+			__free_page(cc.extent + i);
+
+	return shmem_extent_contiguous(mapping, index);
+}
+
+/*
+ * Align mappings of tmpfs to their offset in the file modulo the huge
+ * page size, so that the extents can be mapped with huge pmds.
+ */
+unsigned long shmem_get_unmapped_area(struct file *file,
+		unsigned long uaddr, unsigned long len, unsigned long pgoff,
+		unsigned long flags)
+{
+	unsigned long (*get_area)(struct file *, unsigned long,
+				  unsigned long, unsigned long, unsigned long);
+	unsigned long addr, offset, inflated_len;
+	unsigned long inflated_addr, inflated_offset;
+	struct super_block *sb;
+
+	if (len > TASK_SIZE)
+		return -ENOMEM;
+
+	get_area = current->mm->get_unmapped_area;
+	addr = get_area(file, uaddr, len, pgoff, flags);
+
+	if (IS_ERR_VALUE(addr) || (addr & ~PAGE_MASK))
+		return addr;
+	if (addr > TASK_SIZE - len)
+		return addr;
+
+	/* Only shared mappings are mapped hugely; respect any hint */
+	if (shmem_huge == SHMEM_HUGE_DENY || !(flags & MAP_SHARED))
+		return addr;
+	if (len < HPAGE_PMD_SIZE || uaddr || (flags & MAP_FIXED))
+		return addr;
+
+	if (shmem_huge != SHMEM_HUGE_FORCE) {
+		if (file)
+			sb = file->f_path.dentry->d_inode->i_sb;
+		else if (!IS_ERR(shm_mnt))
+			/* shared anonymous memory, see shmem_zero_setup */
+			sb = shm_mnt->mnt_sb;
+		else
+			return addr;
+		if (SHMEM_SB(sb)->huge == SHMEM_HUGE_NEVER)
+			return addr;
+	}
+
+	offset = (pgoff << PAGE_SHIFT) & (HPAGE_PMD_SIZE - 1);
+	if (offset && offset + len < 2 * HPAGE_PMD_SIZE)
+		return addr;
+	if ((addr & (HPAGE_PMD_SIZE - 1)) == offset)
+		return addr;
+
+	inflated_len = len + HPAGE_PMD_SIZE - PAGE_SIZE;
+	if (inflated_len > TASK_SIZE || inflated_len < len)
+		return addr;
+
+	inflated_addr = get_area(NULL, 0, inflated_len, 0, flags);
+	if (IS_ERR_VALUE(inflated_addr) || (inflated_addr & ~PAGE_MASK))
+		return addr;
+
+	inflated_offset = inflated_addr & (HPAGE_PMD_SIZE - 1);
+	inflated_addr += offset - inflated_offset;
+	if (inflated_offset > offset)
+		inflated_addr += HPAGE_PMD_SIZE;
+
+	if (inflated_addr > TASK_SIZE - len)
+		return addr;
+	return inflated_addr;
+}
+#else /* !CONFIG_TRANSPARENT_HUGEPAGE */
+static inline bool shmem_huge_wanted(struct inode *inode, unsigned long idx,
+				     struct vm_area_struct *vma)
+{
+	return false;
+}
+
+static inline void shmem_alloc_huge(struct inode *inode, unsigned long idx,
+				    enum sgp_type sgp)
+{
+}
+#endif /* CONFIG_TRANSPARENT_HUGEPAGE */
+
 static int shmem_fault(struct vm_area_struct *vma, struct vm_fault *vmf)
 {
 	struct inode *inode = vma->vm_file->f_path.dentry->d_inode;
@@ -1656,6 +2177,8 @@ shmem_write_begin(struct file *file, struct address_space *mapping,
 	struct inode *inode = mapping->host;
 	pgoff_t index = pos >> PAGE_CACHE_SHIFT;
 	*pagep = NULL;
+	if (shmem_huge_wanted(inode, index, NULL))
+		shmem_alloc_huge(inode, index, SGP_WRITE);
 	return shmem_getpage(inode, index, pagep, SGP_WRITE, NULL);
 }
 
@@ -2250,6 +2773,13 @@ static int shmem_parse_options(char *options, struct shmem_sb_info *sbinfo,
 		} else if (!strcmp(this_char,"mpol")) {
 			if (mpol_parse_str(value, &sbinfo->mpol, 1))
 				goto bad_val;
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+		} else if (!strcmp(this_char,"huge")) {
+			int huge = shmem_parse_huge(value);
+			if (huge < SHMEM_HUGE_NEVER)
+				goto bad_val;
+			sbinfo->huge = huge;
+#endif
 		} else {
 			printk(KERN_ERR "tmpfs: Bad mount option %s\n",
 			       this_char);
@@ -2296,6 +2826,7 @@ static int shmem_remount_fs(struct super_block *sb, int *flags, char *data)
 	sbinfo->max_blocks  = config.max_blocks;
 	sbinfo->max_inodes  = config.max_inodes;
 	sbinfo->free_inodes = config.max_inodes - inodes;
+	sbinfo->huge = config.huge;
 
 	mpol_put(sbinfo->mpol);
 	sbinfo->mpol        = config.mpol;	/* transfers initial ref */
@@ -2320,6 +2851,10 @@ static int shmem_show_options(struct seq_file *seq, struct vfsmount *vfs)
 	if (sbinfo->gid != 0)
 		seq_printf(seq, ",gid=%u", sbinfo->gid);
 	shmem_show_mpol(seq, sbinfo->mpol);
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+	if (sbinfo->huge)
+		seq_printf(seq, ",huge=%s", shmem_format_huge(sbinfo->huge));
+#endif
 	return 0;
 }
 #endif /* CONFIG_TMPFS */
@@ -2349,6 +2884,11 @@ int shmem_fill_super(struct super_block *sb, void *data, int silent)
 	sbinfo->mode = S_IRWXUGO | S_ISVTX;
 	sbinfo->uid = current_fsuid();
 	sbinfo->gid = current_fsgid();
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+	/* the internal mount follows shmem_enabled */
+	if ((sb->s_flags & MS_NOUSER) && shmem_huge >= SHMEM_HUGE_NEVER)
+		sbinfo->huge = shmem_huge;
+#endif
 	sb->s_fs_info = sbinfo;
 
 #ifdef CONFIG_TMPFS
@@ -2465,6 +3005,9 @@ static const struct address_space_operations shmem_aops = {
 
 static const struct file_operations shmem_file_operations = {
 	.mmap		= shmem_mmap,
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+	.get_unmapped_area = shmem_get_unmapped_area,
+#endif
 #ifdef CONFIG_TMPFS
 	.llseek		= generic_file_llseek,
 	.read		= do_sync_read,
@@ -2538,6 +3081,9 @@ static const struct super_operations shmem_ops = {
 
 static const struct vm_operations_struct shmem_vm_ops = {
 	.fault		= shmem_fault,
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+	.pmd_fault	= shmem_pmd_fault,
+#endif
 #ifdef CONFIG_NUMA
 	.set_policy     = shmem_set_policy,
 	.get_policy     = shmem_get_policy,
@@ -2674,6 +3220,15 @@ int shmem_lock(struct file *file, int lock, struct user_struct *user)
 	return 0;
 }
 
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+unsigned long shmem_get_unmapped_area(struct file *file,
+		unsigned long addr, unsigned long len, unsigned long pgoff,
+		unsigned long flags)
+{
+	return current->mm->get_unmapped_area(file, addr, len, pgoff, flags);
+}
+#endif
+
 #ifdef CONFIG_CGROUP_MEM_RES_CTLR
 /**
  * mem_cgroup_get_shmem_target - find a page or entry assigned to the shmem file
@@ -27,6 +27,7 @@
 #include <linux/memory.h>
 #include <linux/math64.h>
 #include <linux/fault-inject.h>
+#include <linux/uaccess.h>
 
 #include <trace/events/kmem.h>
 
@@ -67,14 +68,24 @@
  *   a partial slab. A new slab has noone operating on it and thus there is
  *   no danger of cacheline contention.
  *
- *   Interrupts are disabled during allocation and deallocation in order to
- *   make the slab allocator safe to use in the context of an irq. In addition
- *   interrupts are disabled to ensure that the processor does not change
- *   while handling per_cpu slabs, due to kernel preemption.
+ *   Interrupts are disabled in the slow paths of allocation and
+ *   deallocation in order to make the slab allocator safe to use in the
+ *   context of an irq. The fast paths only disable preemption, so that the
+ *   processor does not change while handling per_cpu slabs. They update
+ *   the cpu freelist with a single cmpxchg of the freelist and of a
+ *   transaction id (tid) that the slow paths bump whenever they change the
+ *   cpu slab, so an interrupt that ran in between makes the cmpxchg fail
+ *   and the fast path is simply retried.
  *
  * SLUB assigns one slab for allocation to each processor.
  * Allocations only occur from these slabs called cpu slabs.
  *
+ * In addition each processor keeps a short list of frozen partial slabs,
+ * which become its cpu slab once the current one is used up. Frees to a
+ * full slab and refills from the node partial list move slabs onto it,
+ * and it goes back to the node lists in one go when it grows too long,
+ * so most operations on partial slabs avoid the list_lock.
+ *
  * Slabs with free elements are kept on a partial list and during regular
  * operations no list for full slabs is used. If an object in a full slab is
  * freed then the slab will show up again on the partial lists.
@@ -101,7 +112,8 @@
  * 			slab. The cpu slab may be equipped with an additional
  * 			freelist that allows lockless access to
  * 			free objects in addition to the regular freelist
- * 			that requires the slab lock.
+ * 			that requires the slab lock. Slabs on the per cpu
+ * 			partial lists are frozen as well.
  *
  * PageError		Slab requires special handling due to debug
  * 			options set. This moves	slab handling out of
@@ -261,6 +273,24 @@ static inline void *get_freepointer(struct kmem_cache *s, void *object)
 	return *(void **)(object + s->offset);
 }
 
+/*
+ * The lockless fastpath reads the free pointer of an object that an
+ * interrupt may have allocated, and whose slab may even have been freed,
+ * in the meantime. The cmpxchg then fails, but with DEBUG_PAGEALLOC the
+ * read itself could fault.
+ */
+static inline void *get_freepointer_safe(struct kmem_cache *s, void *object)
+{
+	void *p;
+
+#ifdef CONFIG_DEBUG_PAGEALLOC
+	probe_kernel_read(&p, (void **)(object + s->offset), sizeof(p));
+#else
+	p = get_freepointer(s, object);
+#endif
+	return p;
+}
+
 static inline void set_freepointer(struct kmem_cache *s, void *object, void *fp)
 {
 	*(void **)(object + s->offset) = fp;
@@ -807,14 +837,23 @@ static inline void slab_post_alloc_hook(struct kmem_cache *s, gfp_t flags, void
 static inline void slab_free_hook(struct kmem_cache *s, void *x)
 {
 	kmemleak_free_recursive(x, s->flags);
-}
 
-static inline void slab_free_hook_irq(struct kmem_cache *s, void *object)
-{
-	kmemcheck_slab_free(s, object, s->objsize);
-	debug_check_no_locks_freed(object, s->objsize);
+	/*
+	 * The free fastpath no longer disables interrupts, but these
+	 * checks expect them to be disabled.
+	 */
+#if defined(CONFIG_KMEMCHECK) || defined(CONFIG_LOCKDEP)
+	{
+		unsigned long flags;
+
+		local_irq_save(flags);
+		kmemcheck_slab_free(s, x, s->objsize);
+		debug_check_no_locks_freed(x, s->objsize);
+		local_irq_restore(flags);
+	}
+#endif
 	if (!(s->flags & SLAB_DEBUG_OBJECTS))
-		debug_check_no_obj_freed(object, s->objsize);
+		debug_check_no_obj_freed(x, s->objsize);
 }
 
 /*
@@ -1101,9 +1140,6 @@ static inline void slab_post_alloc_hook(struct kmem_cache *s, gfp_t flags,
 
 static inline void slab_free_hook(struct kmem_cache *s, void *x) {}
 
-static inline void slab_free_hook_irq(struct kmem_cache *s,
-		void *object) {}
-
 #endif /* CONFIG_SLUB_DEBUG */
 
 /*
@@ -1344,12 +1380,21 @@ static inline int lock_and_freeze_slab(struct kmem_cache_node *n,
 	return 0;
 }
 
+static inline int kmem_cache_has_cpu_partial(struct kmem_cache *s)
+{
+	return !kmem_cache_debug(s) && s->cpu_partial;
+}
+
 /*
  * Try to allocate a partial slab from a specific node.
+ *
+ * While we hold the list_lock anyway, also move a few more slabs onto
+ * the cpu partial list so that the next refills do not need it.
  */
-static struct page *get_partial_node(struct kmem_cache_node *n)
+static struct page *get_partial_node(struct kmem_cache *s,
+		struct kmem_cache_node *n, struct kmem_cache_cpu *c)
 {
-	struct page *page;
+	struct page *page, *page2, *first = NULL;
 
 	/*
 	 * Racy check. If we mistakenly see no partial slabs then we
@@ -1361,19 +1406,33 @@ static struct page *get_partial_node(struct kmem_cache_node *n)
 		return NULL;
 
 	spin_lock(&n->list_lock);
-	list_for_each_entry(page, &n->partial, lru)
-		if (lock_and_freeze_slab(n, page))
-			goto out;
-	page = NULL;
-out:
+	list_for_each_entry_safe(page, page2, &n->partial, lru) {
+		if (!lock_and_freeze_slab(n, page))
+			continue;
+
+		if (!first) {
+			/* Stays locked for the caller */
+			first = page;
+			if (!kmem_cache_has_cpu_partial(s))
+				break;
+		} else {
+			slab_unlock(page);
+			list_add_tail(&page->lru, &c->partial);
+			c->nr_partial++;
+			stat(s, CPU_PARTIAL_NODE);
+		}
+		if (c->nr_partial >= s->cpu_partial / 2)
+			break;
+	}
 	spin_unlock(&n->list_lock);
-	return page;
+	return first;
 }
 
 /*
  * Get a page from somewhere. Search in increasing NUMA distances.
  */
-static struct page *get_any_partial(struct kmem_cache *s, gfp_t flags)
+static struct page *get_any_partial(struct kmem_cache *s, gfp_t flags,
+				    struct kmem_cache_cpu *c)
 {
 #ifdef CONFIG_NUMA
 	struct zonelist *zonelist;
@@ -1413,7 +1472,7 @@ static struct page *get_any_partial(struct kmem_cache *s, gfp_t flags)
 
 		if (n && cpuset_zone_allowed_hardwall(zone, flags) &&
 				n->nr_partial > s->min_partial) {
-			page = get_partial_node(n);
+			page = get_partial_node(s, n, c);
 			if (page) {
 				put_mems_allowed();
 				return page;
@@ -1428,16 +1487,17 @@ static struct page *get_any_partial(struct kmem_cache *s, gfp_t flags)
 /*
  * Get a partial page, lock it and return it.
  */
-static struct page *get_partial(struct kmem_cache *s, gfp_t flags, int node)
+static struct page *get_partial(struct kmem_cache *s, gfp_t flags, int node,
+				struct kmem_cache_cpu *c)
 {
 	struct page *page;
 	int searchnode = (node == NUMA_NO_NODE) ? numa_node_id() : node;
 
-	page = get_partial_node(get_node(s, searchnode));
+	page = get_partial_node(s, get_node(s, searchnode), c);
 	if (page || node != -1)
 		return page;
 
-	return get_any_partial(s, flags);
+	return get_any_partial(s, flags, c);
 }
 
 /*
@@ -1487,6 +1547,16 @@ static void unfreeze_slab(struct kmem_cache *s, struct page *page, int tail)
 	}
 }
 
+/*
+ * Transaction ids let the lockless fastpaths notice that an interrupt
+ * changed the cpu slab under them: whoever changes the cpu freelist or
+ * page with interrupts disabled must also bump the tid.
+ */
+static inline unsigned long next_tid(unsigned long tid)
+{
+	return tid + 1;
+}
+
 /*
  * Remove the cpu slab
  */
@@ -1518,9 +1588,105 @@ static void deactivate_slab(struct kmem_cache *s, struct kmem_cache_cpu *c)
 		page->inuse--;
 	}
 	c->page = NULL;
+	c->tid = next_tid(c->tid);
 	unfreeze_slab(s, page, tail);
 }
 
+/*
+ * Return the slabs on the cpu partial list to their node partial lists,
+ * or to the page allocator if they became empty meanwhile. Consecutive
+ * slabs from the same node are moved under a single list_lock.
+ *
+ * Called with interrupts disabled.
+ */
+static void unfreeze_partials(struct kmem_cache *s, struct kmem_cache_cpu *c)
+{
+	struct kmem_cache_node *n = NULL;
+	struct page *page;
+	LIST_HEAD(discard);
+
+	while (!list_empty(&c->partial)) {
+		page = list_first_entry(&c->partial, struct page, lru);
+		list_del(&page->lru);
+		c->nr_partial--;
+
+		if (n != get_node(s, page_to_nid(page))) {
+			if (n)
+				spin_unlock(&n->list_lock);
+			n = get_node(s, page_to_nid(page));
+			spin_lock(&n->list_lock);
+		}
+
+		/*
+		 * This inverts the lock order, so only trylock the slab. If
+		 * frees are in progress, take the slow way round for it.
+		 */
+		if (!slab_trylock(page)) {
+			spin_unlock(&n->list_lock);
+			n = NULL;
+			slab_lock(page);
+			unfreeze_slab(s, page, 1);
+			continue;
+		}
+
+		__ClearPageSlubFrozen(page);
+		if (!page->inuse && n->nr_partial >= s->min_partial) {
+			list_add(&page->lru, &discard);
+		} else {
+			n->nr_partial++;
+			list_add_tail(&page->lru, &n->partial);
+		}
+		slab_unlock(page);
+	}
+	if (n)
+		spin_unlock(&n->list_lock);
+
+	while (!list_empty(&discard)) {
+		page = list_first_entry(&discard, struct page, lru);
+		list_del(&page->lru);
+		stat(s, DEACTIVATE_EMPTY);
+		stat(s, FREE_SLAB);
+		discard_slab(s, page);
+	}
+}
+
+/*
+ * Put a frozen slab that is not the cpu slab onto the cpu partial list.
+ * Once the list grows longer than s->cpu_partial it is drained.
+ *
+ * Called with interrupts disabled.
+ */
+static void put_cpu_partial(struct kmem_cache *s, struct kmem_cache_cpu *c,
+			    struct page *page)
+{
+	list_add(&page->lru, &c->partial);
+	if (++c->nr_partial > s->cpu_partial) {
+		unfreeze_partials(s, c);
+		stat(s, CPU_PARTIAL_DRAIN);
+	}
+}
+
+/*
+ * Take the first slab off the cpu partial list, if it fits the node
+ * the caller asked for, and lock it.
+ */
+static struct page *get_cpu_partial(struct kmem_cache_cpu *c, int node)
+{
+	struct page *page;
+
+	if (list_empty(&c->partial))
+		return NULL;
+
+	page = list_first_entry(&c->partial, struct page, lru);
+	if (node != NUMA_NO_NODE && page_to_nid(page) != node)
+		return NULL;
+
+	list_del(&page->lru);
+	c->nr_partial--;
+	slab_lock(page);
+	return page;
+}
+
 static inline void flush_slab(struct kmem_cache *s, struct kmem_cache_cpu *c)
 {
 	stat(s, CPUSLAB_FLUSH);
@@ -1539,6 +1705,8 @@ static inline void __flush_cpu_slab(struct kmem_cache *s, int cpu)
 
 	if (likely(c && c->page))
 		flush_slab(s, c);
+	if (c)
+		unfreeze_partials(s, c);
 }
 
 static void flush_cpu_slab(void *d)
@@ -1648,10 +1816,19 @@ slab_out_of_memory(struct kmem_cache *s, gfp_t gfpflags, int nid)
  * a call to the page allocator and the setup of a new slab.
  */
 static void *__slab_alloc(struct kmem_cache *s, gfp_t gfpflags, int node,
-			  unsigned long addr, struct kmem_cache_cpu *c)
+			  unsigned long addr)
 {
 	void **object;
 	struct page *new;
+	struct kmem_cache_cpu *c;
+	unsigned long flags;
+
+	local_irq_save(flags);
+	/*
+	 * The fastpath ran with preemption enabled on return, so we may be
+	 * on another cpu by now.
+	 */
+	c = __this_cpu_ptr(s->cpu_slab);
 
 	/* We handle __GFP_ZERO in the caller */
 	gfpflags &= ~__GFP_ZERO;
@@ -1677,15 +1854,24 @@ load_freelist:
 	c->page->freelist = NULL;
 	c->node = page_to_nid(c->page);
 unlock_out:
+	c->tid = next_tid(c->tid);
 	slab_unlock(c->page);
 	stat(s, ALLOC_SLOWPATH);
+	local_irq_restore(flags);
 	return object;
 
 another_slab:
 	deactivate_slab(s, c);
 
 new_slab:
-	new = get_partial(s, gfpflags, node);
+	new = get_cpu_partial(c, node);
+	if (new) {
+		c->page = new;
+		stat(s, CPU_PARTIAL_ALLOC);
+		goto load_freelist;
+	}
+
+	new = get_partial(s, gfpflags, node, c);
 	if (new) {
 		c->page = new;
 		stat(s, ALLOC_FROM_PARTIAL);
@@ -1713,6 +1899,7 @@ new_slab:
 	}
 	if (!(gfpflags & __GFP_NOWARN) && printk_ratelimit())
 		slab_out_of_memory(s, gfpflags, node);
+	local_irq_restore(flags);
 	return NULL;
 debug:
 	if (!alloc_debug_processing(s, c->page, object, addr))
@@ -1724,6 +1911,33 @@ debug:
 	goto unlock_out;
 }
 
+/*
+ * Replace the cpu freelist @old by @new, unless the freelist or the cpu
+ * slab changed since @tid was read. Called with preemption disabled, so
+ * only interrupts on this cpu can race with us and a cmpxchg that is not
+ * locked against other processors is enough.
+ */
+static __always_inline int cpu_freelist_cmpxchg(struct kmem_cache_cpu *c,
+		void *old, unsigned long tid, void *new)
+{
+	unsigned long flags;
+	int ret = 0;
+
+#ifdef CONFIG_HAVE_CMPXCHG_DOUBLE
+	if (likely(system_has_cmpxchg_double()))
+		return cmpxchg_double_local(&c->freelist, &c->tid,
+					    old, tid, new, next_tid(tid));
+#endif
+	local_irq_save(flags);
+	if (c->freelist == old && c->tid == tid) {
+		c->freelist = new;
+		c->tid = next_tid(tid);
+		ret = 1;
+	}
+	local_irq_restore(flags);
+	return ret;
+}
+
 /*
  * Inlined fastpath so that allocation functions (kmalloc, kmem_cache_alloc)
  * have the fastpath folded into their functions. So no function call
@@ -1732,30 +1946,44 @@ debug:
  * The fastpath works by first checking if the lockless freelist can be used.
  * If not then __slab_alloc is called for slow processing.
  *
- * Otherwise we can simply pick the next object from the lockless free list.
+ * Otherwise we can simply pick the next object from the lockless free list,
+ * retrying if an interrupt got there first.
  */
 static __always_inline void *slab_alloc(struct kmem_cache *s,
 		gfp_t gfpflags, int node, unsigned long addr)
 {
 	void **object;
 	struct kmem_cache_cpu *c;
-	unsigned long flags;
+	unsigned long tid;
 
 	if (slab_pre_alloc_hook(s, gfpflags))
 		return NULL;
 
-	local_irq_save(flags);
+redo:
+	preempt_disable();
 	c = __this_cpu_ptr(s->cpu_slab);
-	object = c->freelist;
-	if (unlikely(!object || !node_match(c, node)))
+	/*
+	 * Read the tid before the freelist: an interrupt that changes the
+	 * freelist after this point also bumps the tid.
+	 */
+	tid = c->tid;
+	barrier();
 
-		object = __slab_alloc(s, gfpflags, node, addr, c);
+	object = c->freelist;
+	if (unlikely(!object || !node_match(c, node))) {
+		preempt_enable();
+		object = __slab_alloc(s, gfpflags, node, addr);
+	} else {
+		void *next = get_freepointer_safe(s, object);
 
-	else {
-		c->freelist = get_freepointer(s, object);
+		if (unlikely(!cpu_freelist_cmpxchg(c, object, tid, next))) {
+			stat(s, CMPXCHG_DOUBLE_CPU_FAIL);
+			preempt_enable();
+			goto redo;
+		}
 		stat(s, ALLOC_FASTPATH);
+		preempt_enable();
 	}
-	local_irq_restore(flags);
 
 	if (unlikely(gfpflags & __GFP_ZERO) && object)
 		memset(object, 0, s->objsize);
@@ -1833,7 +2061,9 @@ static void __slab_free(struct kmem_cache *s, struct page *page,
 {
 	void *prior;
 	void **object = (void *)x;
+	unsigned long flags;
 
+	local_irq_save(flags);
 	stat(s, FREE_SLOWPATH);
 	slab_lock(page);
 
@@ -1856,15 +2086,25 @@ checks_ok:
 
 	/*
 	 * Objects left in the slab. If it was not on the partial list before
-	 * then add it.
+	 * then add it: preferably to our cpu partial list, which does not
+	 * need the list_lock.
 	 */
 	if (unlikely(!prior)) {
+		if (kmem_cache_has_cpu_partial(s)) {
+			__SetPageSlubFrozen(page);
+			slab_unlock(page);
+			put_cpu_partial(s, __this_cpu_ptr(s->cpu_slab), page);
+			stat(s, CPU_PARTIAL_FREE);
+			local_irq_restore(flags);
+			return;
+		}
 		add_partial(get_node(s, page_to_nid(page)), page, 1);
 		stat(s, FREE_ADD_PARTIAL);
 	}
 
 out_unlock:
 	slab_unlock(page);
+	local_irq_restore(flags);
 	return;
 
 slab_empty:
@@ -1877,6 +2117,7 @@ slab_empty:
 	}
 	slab_unlock(page);
 	stat(s, FREE_SLAB);
+	local_irq_restore(flags);
 	discard_slab(s, page);
 	return;
 
@@ -1902,23 +2143,32 @@ static __always_inline void slab_free(struct kmem_cache *s,
 {
 	void **object = (void *)x;
 	struct kmem_cache_cpu *c;
-	unsigned long flags;
+	unsigned long tid;
 
 	slab_free_hook(s, x);
 
-	local_irq_save(flags);
+redo:
+	preempt_disable();
 	c = __this_cpu_ptr(s->cpu_slab);
-
-	slab_free_hook_irq(s, x);
+	/* Read the tid before the cpu slab, see slab_alloc() */
+	tid = c->tid;
+	barrier();
 
 	if (likely(page == c->page && c->node != NUMA_NO_NODE)) {
-		set_freepointer(s, object, c->freelist);
-		c->freelist = object;
+		void **freelist = c->freelist;
+
+		set_freepointer(s, object, freelist);
+		if (unlikely(!cpu_freelist_cmpxchg(c, freelist, tid, object))) {
+			stat(s, CMPXCHG_DOUBLE_CPU_FAIL);
+			preempt_enable();
+			goto redo;
+		}
 		stat(s, FREE_FASTPATH);
-	} else
+		preempt_enable();
+	} else {
+		preempt_enable();
 		__slab_free(s, page, x, addr);
-
-	local_irq_restore(flags);
+	}
 }
 
 void kmem_cache_free(struct kmem_cache *s, void *x)
@@ -2107,12 +2357,23 @@ init_kmem_cache_node(struct kmem_cache_node *n, struct kmem_cache *s)
 
 static inline int alloc_kmem_cache_cpus(struct kmem_cache *s)
 {
+	int cpu;
+
 	BUILD_BUG_ON(PERCPU_DYNAMIC_EARLY_SIZE <
 			SLUB_PAGE_SHIFT * sizeof(struct kmem_cache_cpu));
 
-	s->cpu_slab = alloc_percpu(struct kmem_cache_cpu);
+	/*
+	 * Must align to double word boundary for the cmpxchg of the
+	 * freelist and tid.
+	 */
+	s->cpu_slab = __alloc_percpu(sizeof(struct kmem_cache_cpu),
+				     2 * sizeof(void *));
+	if (!s->cpu_slab)
+		return 0;
 
-	return s->cpu_slab != NULL;
+	for_each_possible_cpu(cpu)
+		INIT_LIST_HEAD(&per_cpu_ptr(s->cpu_slab, cpu)->partial);
+	return 1;
 }
 
 static struct kmem_cache *kmem_cache_node;
@@ -2370,6 +2631,23 @@ static int kmem_cache_open(struct kmem_cache *s,
 	 * list to avoid pounding the page allocator excessively.
 	 */
 	set_min_partial(s, ilog2(s->size));
+
+	/*
+	 * The cpu partial lists trade some memory held per cpu for fewer
+	 * trips to the list_lock. Keep fewer of the larger slabs. Debug
+	 * caches need the node lists to track full slabs.
+	 */
+	if (kmem_cache_debug(s))
+		s->cpu_partial = 0;
+	else if (s->size >= PAGE_SIZE)
+		s->cpu_partial = 2;
+	else if (s->size >= 1024)
+		s->cpu_partial = 4;
+	else if (s->size >= 256)
+		s->cpu_partial = 6;
+	else
+		s->cpu_partial = 8;
+
 	s->refcount = 1;
 #ifdef CONFIG_NUMA
 	s->remote_node_defrag_ratio = 1000;
@@ -2967,6 +3245,9 @@ static void __init kmem_cache_bootstrap_fixup(struct kmem_cache *s)
 		if (n) {
 			list_for_each_entry(p, &n->partial, lru)
 				p->slab = s;
+			list_for_each_entry(p,
+				&__this_cpu_ptr(s->cpu_slab)->partial, lru)
+				p->slab = s;
 
 #ifdef CONFIG_SLAB_DEBUG
 			list_for_each_entry(p, &n->full, lru)
@@ -3944,6 +4225,29 @@ static ssize_t min_partial_store(struct kmem_cache *s, const char *buf,
 }
 SLAB_ATTR(min_partial);
 
+static ssize_t cpu_partial_show(struct kmem_cache *s, char *buf)
+{
+	return sprintf(buf, "%d\n", s->cpu_partial);
+}
+
+static ssize_t cpu_partial_store(struct kmem_cache *s, const char *buf,
+				 size_t length)
+{
+	unsigned long slabs;
+	int err;
+
+	err = strict_strtoul(buf, 10, &slabs);
+	if (err)
+		return err;
+	if (slabs > INT_MAX || (slabs && kmem_cache_debug(s)))
+		return -EINVAL;
+
+	s->cpu_partial = slabs;
+	flush_all(s);
+	return length;
+}
+SLAB_ATTR(cpu_partial);
+
 static ssize_t ctor_show(struct kmem_cache *s, char *buf)
 {
 	if (!s->ctor)
@@ -3970,6 +4274,29 @@ static ssize_t cpu_slabs_show(struct kmem_cache *s, char *buf)
 }
 SLAB_ATTR_RO(cpu_slabs);
 
+static ssize_t slabs_cpu_partial_show(struct kmem_cache *s, char *buf)
+{
+	unsigned long sum = 0;
+	int cpu;
+	int len;
+
+	for_each_online_cpu(cpu)
+		sum += per_cpu_ptr(s->cpu_slab, cpu)->nr_partial;
+
+	len = sprintf(buf, "%lu", sum);
+
+#ifdef CONFIG_SMP
+	for_each_online_cpu(cpu) {
+		int nr = per_cpu_ptr(s->cpu_slab, cpu)->nr_partial;
+
+		if (nr && len < PAGE_SIZE - 20)
+			len += sprintf(buf + len, " C%d=%d", cpu, nr);
+	}
+#endif
+	return len + sprintf(buf + len, "\n");
+}
+SLAB_ATTR_RO(slabs_cpu_partial);
+
 static ssize_t objects_show(struct kmem_cache *s, char *buf)
 {
 	return show_slab_objects(s, buf, SO_ALL|SO_OBJECTS);
@@ -4284,6 +4611,11 @@ STAT_ATTR(DEACTIVATE_TO_HEAD, deactivate_to_head);
 STAT_ATTR(DEACTIVATE_TO_TAIL, deactivate_to_tail);
 STAT_ATTR(DEACTIVATE_REMOTE_FREES, deactivate_remote_frees);
 STAT_ATTR(ORDER_FALLBACK, order_fallback);
+STAT_ATTR(CMPXCHG_DOUBLE_CPU_FAIL, cmpxchg_double_cpu_fail);
+STAT_ATTR(CPU_PARTIAL_ALLOC, cpu_partial_alloc);
+STAT_ATTR(CPU_PARTIAL_FREE, cpu_partial_free);
+STAT_ATTR(CPU_PARTIAL_NODE, cpu_partial_node);
+STAT_ATTR(CPU_PARTIAL_DRAIN, cpu_partial_drain);
 #endif
 
 static struct attribute *slab_attrs[] = {
@@ -4292,10 +4624,12 @@ static struct attribute *slab_attrs[] = {
 	&objs_per_slab_attr.attr,
 	&order_attr.attr,
 	&min_partial_attr.attr,
+	&cpu_partial_attr.attr,
 	&objects_attr.attr,
 	&objects_partial_attr.attr,
 	&partial_attr.attr,
 	&cpu_slabs_attr.attr,
+	&slabs_cpu_partial_attr.attr,
 	&ctor_attr.attr,
 	&aliases_attr.attr,
 	&align_attr.attr,
@@ -4340,6 +4674,11 @@ static struct attribute *slab_attrs[] = {
 	&deactivate_to_tail_attr.attr,
 	&deactivate_remote_frees_attr.attr,
 	&order_fallback_attr.attr,
+	&cmpxchg_double_cpu_fail_attr.attr,
+	&cpu_partial_alloc_attr.attr,
+	&cpu_partial_free_attr.attr,
+	&cpu_partial_node_attr.attr,
+	&cpu_partial_drain_attr.attr,
 #endif
 #ifdef CONFIG_FAILSLAB
 	&failslab_attr.attr,
@@ -1476,6 +1476,8 @@ void *vmap(struct page **pages, unsigned int count,
 }
 EXPORT_SYMBOL(vmap);
 
+#define VMALLOC_BULK_BATCH	100U	/* pages per bulk allocation */
+
 static void *__vmalloc_node(unsigned long size, unsigned long align,
 			    gfp_t gfp_mask, pgprot_t prot,
 			    int node, void *caller);
@@ -1506,20 +1508,29 @@ static void *__vmalloc_area_node(struct vm_struct *area, gfp_t gfp_mask,
 		return NULL;
 	}
 
-	for (i = 0; i < area->nr_pages; i++) {
-		struct page *page;
+	/*
+	 * The array is zeroed: the bulk allocator fills it from the start.
+	 * It runs with interrupts disabled, so ask for a bounded batch of
+	 * pages at a time.
+	 */
+	for (i = 0; i < area->nr_pages; ) {
+		unsigned int nr, nr_request;
 
+		nr_request = min(area->nr_pages - i, VMALLOC_BULK_BATCH);
 		if (node < 0)
-			page = alloc_page(gfp_mask);
+			nr = alloc_pages_bulk(gfp_mask, nr_request,
+					      NULL, area->pages + i);
 		else
-			page = alloc_pages_node(node, gfp_mask, 0);
+			nr = alloc_pages_bulk_node(node, gfp_mask,
+						   nr_request, NULL,
+						   area->pages + i);
 
-		if (unlikely(!page)) {
+		if (unlikely(!nr)) {
 			/* Successfully allocated i pages, free them in __vunmap() */
 			area->nr_pages = i;
 			goto fail;
 		}
-		area->pages[i] = page;
+		i += nr;
 	}
 
 	if (map_vm_area(area, prot, &pages))
@@ -41,6 +41,7 @@
 #include <linux/memcontrol.h>
 #include <linux/delayacct.h>
 #include <linux/sysctl.h>
+#include <linux/ksm.h>
 
 #include <asm/tlbflush.h>
 #include <asm/div64.h>
@@ -514,6 +515,7 @@ static int __remove_mapping(struct address_space *mapping, struct page *page)
 
 		freepage = mapping->a_ops->freepage;
 
+		workingset_eviction(mapping, page);
 		__remove_from_page_cache(page);
 		spin_unlock_irq(&mapping->tree_lock);
 		mem_cgroup_uncharge_cache_page(page);
@@ -719,6 +721,7 @@ static unsigned long shrink_page_list(struct list_head *page_list,
 		struct address_space *mapping;
 		struct page *page;
 		int may_enter_fs;
+		int lazyfree = 0;
 
 		cond_resched();
 
@@ -778,13 +781,24 @@ static unsigned long shrink_page_list(struct list_head *page_list,
 		/*
 		 * Anonymous process memory has backing store?
 		 * Try to allocate it some swap space here.
+		 *
+		 * Not if MADV_FREE said its contents can go and it has not
+		 * been dirtied since: it is dropped without any I/O, unless
+		 * a pte shows that it was written to again.  A page that was
+		 * is swapped out as usual from now on.
 		 */
 		if (PageAnon(page) && !PageSwapCache(page)) {
-			if (!(sc->gfp_mask & __GFP_IO))
-				goto keep_locked;
-			if (!add_to_swap(page))
-				goto activate_locked;
-			may_enter_fs = 1;
+			if (PageLazyFree(page) && !PageDirty(page) &&
+			    !PageKsm(page) && !PageTransHuge(page)) {
+				lazyfree = 1;
+			} else {
+				ClearPageLazyFree(page);
+				if (!(sc->gfp_mask & __GFP_IO))
+					goto keep_locked;
+				if (!add_to_swap(page))
+					goto activate_locked;
+				may_enter_fs = 1;
+			}
 		}
 
 		mapping = page_mapping(page);
@@ -793,8 +807,13 @@ static unsigned long shrink_page_list(struct list_head *page_list,
 		 * The page is mapped into the page tables of one or more
 		 * processes. Try to unmap it here.
 		 */
-		if (page_mapped(page) && mapping) {
-			switch (try_to_unmap(page, TTU_UNMAP)) {
+		if (page_mapped(page) && (mapping || lazyfree)) {
+			enum ttu_flags ttu = TTU_UNMAP | TTU_BATCH_FLUSH;
+
+			if (lazyfree)
+				ttu |= TTU_LAZYFREE;
+
+			switch (try_to_unmap(page, ttu)) {
 			case SWAP_FAIL:
 				goto activate_locked;
 			case SWAP_AGAIN:
@@ -806,6 +825,22 @@ static unsigned long shrink_page_list(struct list_head *page_list,
 			}
 		}
 
+		if (lazyfree) {
+			/*
+			 * Unmapped and not in the swap cache, nobody can find
+			 * the page now: follow __remove_mapping() to make sure
+			 * nobody else holds a reference either.
+			 */
+			if (!page_freeze_refs(page, 1))
+				goto keep_locked;
+			if (PageDirty(page)) {
+				page_unfreeze_refs(page, 1);
+				goto keep_locked;
+			}
+			count_vm_event(PGLAZYFREED);
+			goto free_locked;
+		}
+
 		if (PageDirty(page)) {
 			nr_dirty++;
 
@@ -816,7 +851,13 @@ static unsigned long shrink_page_list(struct list_head *page_list,
 			if (!sc->may_writepage)
 				goto keep_locked;
 
-			/* Page is dirty, try to write it out here */
+			/*
+			 * Page is dirty, try to write it out here. Flush the
+			 * TLBs first if ptes were dirty when unmapped: a CPU
+			 * could still write to the page through one while
+			 * it is under writeback.
+			 */
+			try_to_unmap_flush_dirty();
 			switch (pageout(page, mapping, sc)) {
 			case PAGE_KEEP:
 				nr_congested++;
@@ -895,6 +936,7 @@ static unsigned long shrink_page_list(struct list_head *page_list,
 		 * we obviously don't have to worry about waking up a process
 		 * waiting on the page lock, because there are no references.
 		 */
+free_locked:
 		__clear_page_locked(page);
 free_it:
 		nr_reclaimed++;
@@ -939,6 +981,7 @@ keep_lumpy:
 	if (nr_dirty == nr_congested && nr_dirty != 0)
 		zone_set_flag(zone, ZONE_CONGESTED);
 
+	try_to_unmap_flush();
 	free_page_list(&free_pages);
 
 	list_splice(&ret_pages, page_list);
@@ -2597,6 +2640,13 @@ static void kswapd_try_to_sleep(pg_data_t *pgdat, int order, int classzone_idx)
 		 * them before going back to sleep.
 		 */
 		set_pgdat_percpu_threshold(pgdat, calculate_normal_threshold);
+
+		/*
+		 * Reclaim is done for this order, leave it to kcompactd to
+		 * turn the free pages into free blocks of that order.
+		 */
+		wakeup_kcompactd(pgdat, order, classzone_idx);
+
 		schedule();
 		set_pgdat_percpu_threshold(pgdat, calculate_pressure_threshold);
 	} else {
@@ -0,0 +1,237 @@
+/*
+ * mm/workingset.c
+ *
+ * Workingset detection: tell thrashing refaults of file pages from
+ * cold reads.
+ *
+ * File pages enter the inactive list and have to be referenced twice
+ * there to get activated.  When the working set is just a bit larger
+ * than the inactive list, its pages are evicted before their second
+ * reference, read back in, put on the inactive list again, and so on:
+ * the working set thrashes, while the active list may hold pages that
+ * are not used anymore.
+ *
+ * Each zone keeps a clock, zone->inactive_age, that advances with every
+ * page that leaves its inactive list, evicted or activated.  When a page
+ * is evicted, the time of the eviction is recorded; when the page is read
+ * back in, the difference between the time of the refault and that of
+ * the eviction, the refault distance, is how many more inactive list
+ * slots the page would have needed to still be cached.
+ *
+ * The active list is the only memory the inactive list could take those
+ * slots from.  So if the refault distance is no larger than the active
+ * list, the page is activated right away and gets to compete with the
+ * pages there, instead of being evicted again before it can be used.
+ *
+ * The eviction records are kept in a hash table of fixed size, indexed
+ * by mapping and index, with three records for every four pages of
+ * lowmem.  Each bucket holds a few records and recycles the oldest one,
+ * so that records are forgotten roughly when their refault distance
+ * would be too large to matter.  Records are not removed when a file
+ * is truncated or its inode freed: a stale record can at worst activate
+ * a page that did not deserve it, which reclaim will correct.
+ */
+#include <linux/mm.h>
+#include <linux/swap.h>
+#include <linux/fs.h>
+#include <linux/bootmem.h>
+#include <linux/hash.h>
+#include <linux/jhash.h>
+#include <linux/vmstat.h>
+#include <linux/init.h>
+
+/*
+ * A record packs the eviction time, the zone of the page and a cookie
+ * identifying the page within its bucket.
+ */
+#define WORKINGSET_COOKIE_BITS	16
+#define EVICTION_SHIFT	(WORKINGSET_COOKIE_BITS + NODES_SHIFT + ZONES_SHIFT)
+#define EVICTION_BITS	(64 - EVICTION_SHIFT)
+#if EVICTION_BITS < BITS_PER_LONG
+#define EVICTION_MASK	((1UL << EVICTION_BITS) - 1)
+#else
+#define EVICTION_MASK	(~0UL)
+#endif
+
+#define WORKINGSET_BUCKET_SLOTS	6
+
+struct workingset_bucket {
+	spinlock_t lock;
+	unsigned int hand;
+	u64 slots[WORKINGSET_BUCKET_SLOTS];
+};
+
+static struct workingset_bucket *workingset_table __read_mostly;
+static unsigned int workingset_hash_shift __read_mostly;
+
+static struct workingset_bucket *workingset_bucket(
+		struct address_space *mapping, pgoff_t index, u64 *cookie)
+{
+	u32 key;
+
+	key = jhash_3words(hash_ptr(mapping, 32), (u32)index,
+			   (u32)((u64)index >> 32), 0);
+
+	/* A zero slot is empty */
+	*cookie = key & ((1U << WORKINGSET_COOKIE_BITS) - 1);
+	if (!*cookie)
+		*cookie = 1;
+
+	return &workingset_table[hash_32(key, workingset_hash_shift)];
+}
+
+static u64 pack_record(struct zone *zone, unsigned long eviction, u64 cookie)
+{
+	u64 record;
+
+	record = (u64)(eviction & EVICTION_MASK);
+	record = (record << NODES_SHIFT) | zone_to_nid(zone);
+	record = (record << ZONES_SHIFT) | zone_idx(zone);
+	record = (record << WORKINGSET_COOKIE_BITS) | cookie;
+
+	return record;
+}
+
+static void unpack_record(u64 record, struct zone **zone,
+			  unsigned long *eviction)
+{
+	int zid, nid;
+
+	record >>= WORKINGSET_COOKIE_BITS;
+	zid = record & ((1UL << ZONES_SHIFT) - 1);
+	record >>= ZONES_SHIFT;
+	nid = record & ((1UL << NODES_SHIFT) - 1);
+	record >>= NODES_SHIFT;
+
+	*zone = NODE_DATA(nid)->node_zones + zid;
+	*eviction = record;
+}
+
+/**
+ * workingset_eviction - record the eviction of a page cache page
+ * @mapping: address space the page was backing
+ * @page: the page being evicted
+ *
+ * Called by reclaim with the mapping's tree_lock held, when @page is
+ * removed from the page cache.
+ */
+void workingset_eviction(struct address_space *mapping, struct page *page)
+{
+	struct zone *zone = page_zone(page);
+	struct workingset_bucket *bucket;
+	unsigned long eviction;
+	u64 cookie;
+
+	if (!workingset_table)
+		return;
+
+	eviction = atomic_long_inc_return(&zone->inactive_age);
+	bucket = workingset_bucket(mapping, page->index, &cookie);
+
+	spin_lock(&bucket->lock);
+	bucket->slots[bucket->hand] = pack_record(zone, eviction, cookie);
+	if (++bucket->hand == WORKINGSET_BUCKET_SLOTS)
+		bucket->hand = 0;
+	spin_unlock(&bucket->lock);
+}
+
+/**
+ * workingset_refault - evaluate the refault of a previously evicted page
+ * @mapping: address space the page is being read into
+ * @index: offset of the page in @mapping
+ *
+ * Consumes the eviction record of the page, if there is one, and
+ * returns %true if the page should be activated right away.
+ */
+bool workingset_refault(struct address_space *mapping, pgoff_t index)
+{
+	struct workingset_bucket *bucket;
+	unsigned long refault, eviction;
+	struct zone *zone;
+	u64 record = 0;
+	u64 cookie;
+	int i;
+
+	if (!workingset_table)
+		return false;
+
+	bucket = workingset_bucket(mapping, index, &cookie);
+
+	/*
+	 * The bucket lock nests inside tree_lock in workingset_eviction(),
+	 * and tree_lock is taken from interrupts at the end of writeback.
+	 */
+	spin_lock_irq(&bucket->lock);
+	for (i = 0; i < WORKINGSET_BUCKET_SLOTS; i++) {
+		u64 slot = bucket->slots[i];
+
+		if ((slot & ((1U << WORKINGSET_COOKIE_BITS) - 1)) == cookie) {
+			bucket->slots[i] = 0;
+			record = slot;
+			break;
+		}
+	}
+	spin_unlock_irq(&bucket->lock);
+
+	if (!record)
+		return false;
+
+	unpack_record(record, &zone, &eviction);
+	refault = atomic_long_read(&zone->inactive_age);
+
+	inc_zone_state(zone, WORKINGSET_REFAULT);
+
+	if (((refault - eviction) & EVICTION_MASK) <=
+	    zone_page_state(zone, NR_ACTIVE_FILE)) {
+		inc_zone_state(zone, WORKINGSET_ACTIVATE);
+		return true;
+	}
+	return false;
+}
+
+/**
+ * workingset_activation - note a page activation
+ * @page: page that is being activated
+ */
+void workingset_activation(struct page *page)
+{
+	atomic_long_inc(&page_zone(page)->inactive_age);
+}
+
+static __initdata unsigned long workingset_entries;
+static int __init set_workingset_entries(char *str)
+{
+	if (!str)
+		return 0;
+	workingset_entries = simple_strtoul(str, &str, 0);
+	return 1;
+}
+__setup("workingset_entries=", set_workingset_entries);
+
+static int __init workingset_init(void)
+{
+	struct workingset_bucket *table;
+	unsigned int mask;
+	int loop;
+
+	/* One bucket, i.e. 6 records, for every 8 pages of memory */
+	table = alloc_large_system_hash("Workingset",
+					sizeof(struct workingset_bucket),
+					workingset_entries,
+					PAGE_SHIFT + 3,
+					0,
+					&workingset_hash_shift,
+					&mask,
+					0);
+
+	for (loop = 0; loop < (1 << workingset_hash_shift); loop++) {
+		spin_lock_init(&table[loop].lock);
+		table[loop].hand = 0;
+		memset(table[loop].slots, 0, sizeof(table[loop].slots));
+	}
+
+	smp_wmb();
+	workingset_table = table;
+	return 0;
+}
+module_init(workingset_init)
@@ -0,0 +1,569 @@
+/*
+ *  linux/mm/zcache.c
+ *
+ *  Compressed cache for clean page cache pages.
+ *
+ *  zcache is a cleancache backend: clean pages evicted from the page cache
+ *  of a filesystem that opted in are LZO compressed into a RAM pool, and
+ *  a later read of the same page is served from there without any I/O.
+ *  The pages are clean, so the pool simply drops its least recently
+ *  stored pages when it reaches its size limit.
+ *
+ *  All the cleancache hooks may be called with the mapping's tree_lock
+ *  held and interrupts disabled, so nothing here sleeps, allocations are
+ *  atomic and zcache_lock is taken irqsave.
+ *
+ *  See Documentation/vm/cleancache.txt.
+ *
+ *  This work is licensed under the terms of the GNU GPL, version 2.
+ */
+
+#include <linux/module.h>
+#include <linux/cpu.h>
+#include <linux/highmem.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/types.h>
+#include <linux/cleancache.h>
+#include <linux/rbtree.h>
+#include <linux/swap.h>
+#include <linux/lzo.h>
+#include <linux/debugfs.h>
+
+/* Same reasoning as for zswap: bigger objects would not save memory */
+#define ZCACHE_MAX_STORED_SIZE	(PAGE_SIZE / 2)
+
+/* Number of filesystems that can use the cache at the same time */
+#define ZCACHE_MAX_POOLS	32
+
+/*
+ * Pages are stored from the page cache eviction path, with interrupts
+ * off: never wait and never touch the emergency reserves.
+ */
+#define ZCACHE_GFP	(GFP_NOWAIT | __GFP_NORETRY | __GFP_NOWARN | \
+			 __GFP_NOMEMALLOC)
+
+/* Enable/disable storing new pages, pages already stored are kept */
+static int zcache_enabled __read_mostly = 1;
+module_param_named(enabled, zcache_enabled, bool, 0644);
+
+/* Maximum size of the pool, in percent of RAM */
+static unsigned int zcache_max_pool_percent = 10;
+module_param_named(max_pool_percent, zcache_max_pool_percent, uint, 0644);
+
+/*
+ * Statistics, reported in debugfs.  Only the pool size and stored page
+ * count are exact, the others are updated without locking.
+ */
+static u64 zcache_pool_total_size;	/* bytes of compressed data */
+static u64 zcache_stored_pages;
+static u64 zcache_evicted_pages;
+static u64 zcache_succ_gets;
+static u64 zcache_failed_gets;
+static u64 zcache_reject_compress_poor;
+static u64 zcache_reject_alloc_fail;
+
+/* One compressed page, owned by the tree it is in */
+struct zcache_entry {
+	struct rb_node rbnode;
+	struct list_head lru;
+	int pool;
+	struct cleancache_filekey key;
+	pgoff_t index;
+	unsigned int length;
+	void *data;
+};
+
+static struct kmem_cache *zcache_entry_cache;
+
+/*
+ * zcache_lock protects the pools, the LRU list and the exact statistics.
+ * Each pool is a tree sorted by file and then by index, so the pages of
+ * one file are next to each other.  Compression and decompression are
+ * done outside of the lock.
+ */
+static DEFINE_SPINLOCK(zcache_lock);
+static struct rb_root zcache_pools[ZCACHE_MAX_POOLS];
+static DECLARE_BITMAP(zcache_pools_used, ZCACHE_MAX_POOLS);
+static LIST_HEAD(zcache_lru);		/* most recently stored first */
+
+/* Per-cpu LZO work memory and destination buffer */
+static DEFINE_PER_CPU(void *, zcache_wrkmem);
+static DEFINE_PER_CPU(u8 *, zcache_dstmem);
+
+static bool zcache_is_full(unsigned long extra)
+{
+	return zcache_pool_total_size + extra >
+		((u64)totalram_pages * zcache_max_pool_percent / 100)
+			<< PAGE_SHIFT;
+}
+
+/*********************************
+* entries and the trees
+**********************************/
+static int zcache_cmp(struct cleancache_filekey *key, pgoff_t index,
+		      struct zcache_entry *entry)
+{
+	int ret = memcmp(key, &entry->key, sizeof(*key));
+
+	if (ret)
+		return ret;
+	if (index < entry->index)
+		return -1;
+	return index > entry->index;
+}
+
+static struct zcache_entry *zcache_rb_search(struct rb_root *root,
+					     struct cleancache_filekey *key,
+					     pgoff_t index)
+{
+	struct rb_node *node = root->rb_node;
+	struct zcache_entry *entry;
+	int cmp;
+
+	while (node) {
+		entry = rb_entry(node, struct zcache_entry, rbnode);
+		cmp = zcache_cmp(key, index, entry);
+		if (cmp < 0)
+			node = node->rb_left;
+		else if (cmp > 0)
+			node = node->rb_right;
+		else
+			return entry;
+	}
+	return NULL;
+}
+
+/* Return the first entry of file @key in @root, if any */
+static struct zcache_entry *zcache_rb_first_of(struct rb_root *root,
+					       struct cleancache_filekey *key)
+{
+	struct rb_node *node = root->rb_node;
+	struct zcache_entry *entry, *first = NULL;
+
+	while (node) {
+		entry = rb_entry(node, struct zcache_entry, rbnode);
+		if (zcache_cmp(key, 0, entry) <= 0) {
+			first = entry;
+			node = node->rb_left;
+		} else
+			node = node->rb_right;
+	}
+	if (first && memcmp(key, &first->key, sizeof(*key)))
+		return NULL;
+	return first;
+}
+
+/*
+ * Insert @entry into @root, or return -EEXIST with the entry already
+ * there for the same page in *@dupentry.
+ */
+static int zcache_rb_insert(struct rb_root *root, struct zcache_entry *entry,
+			    struct zcache_entry **dupentry)
+{
+	struct rb_node **link = &root->rb_node, *parent = NULL;
+	struct zcache_entry *myentry;
+	int cmp;
+
+	while (*link) {
+		parent = *link;
+		myentry = rb_entry(parent, struct zcache_entry, rbnode);
+		cmp = zcache_cmp(&entry->key, entry->index, myentry);
+		if (cmp < 0)
+			link = &parent->rb_left;
+		else if (cmp > 0)
+			link = &parent->rb_right;
+		else {
+			*dupentry = myentry;
+			return -EEXIST;
+		}
+	}
+	rb_link_node(&entry->rbnode, parent, link);
+	rb_insert_color(&entry->rbnode, root);
+	return 0;
+}
+
+static void zcache_entry_free(struct zcache_entry *entry)
+{
+	kfree(entry->data);
+	kmem_cache_free(zcache_entry_cache, entry);
+}
+
+/*
+ * Drop @entry from its tree and the LRU, the caller frees it once
+ * zcache_lock is released.  Called with zcache_lock held.
+ */
+static void zcache_entry_erase(struct zcache_entry *entry)
+{
+	rb_erase(&entry->rbnode, &zcache_pools[entry->pool]);
+	list_del(&entry->lru);
+	zcache_pool_total_size -= ksize(entry->data);
+	zcache_stored_pages--;
+}
+
+/*
+ * Move the least recently stored entries to @list until @extra more
+ * bytes fit into the pool.  Called with zcache_lock held.
+ */
+static void zcache_evict(unsigned long extra, struct list_head *list)
+{
+	struct zcache_entry *entry;
+
+	while (zcache_is_full(extra) && !list_empty(&zcache_lru)) {
+		entry = list_entry(zcache_lru.prev, struct zcache_entry, lru);
+		zcache_entry_erase(entry);
+		list_add(&entry->lru, list);
+		zcache_evicted_pages++;
+	}
+}
+
+static void zcache_free_list(struct list_head *list)
+{
+	struct zcache_entry *entry, *tmp;
+
+	list_for_each_entry_safe(entry, tmp, list, lru)
+		zcache_entry_free(entry);
+}
+
+/*********************************
+* cleancache hooks
+**********************************/
+static void zcache_put_page(int pool, struct cleancache_filekey key,
+			    pgoff_t index, struct page *page)
+{
+	struct zcache_entry *entry, *dupentry;
+	unsigned long flags;
+	LIST_HEAD(freelist);
+	size_t dlen;
+	void *data;
+	u8 *src, *dst;
+	int ret;
+
+	if (!zcache_enabled || pool < 0 || pool >= ZCACHE_MAX_POOLS)
+		return;
+
+	entry = kmem_cache_alloc(zcache_entry_cache, ZCACHE_GFP);
+	if (!entry) {
+		zcache_reject_alloc_fail++;
+		goto invalidate;
+	}
+
+	dst = get_cpu_var(zcache_dstmem);
+	src = kmap_atomic(page, KM_USER0);
+	ret = lzo1x_1_compress(src, PAGE_SIZE, dst, &dlen,
+			       __get_cpu_var(zcache_wrkmem));
+	kunmap_atomic(src, KM_USER0);
+	if (ret != LZO_E_OK || dlen > ZCACHE_MAX_STORED_SIZE) {
+		put_cpu_var(zcache_dstmem);
+		zcache_reject_compress_poor++;
+		goto reject;
+	}
+	data = kmalloc(dlen, ZCACHE_GFP);
+	if (!data) {
+		put_cpu_var(zcache_dstmem);
+		zcache_reject_alloc_fail++;
+		goto reject;
+	}
+	memcpy(data, dst, dlen);
+	put_cpu_var(zcache_dstmem);
+
+	entry->pool = pool;
+	entry->key = key;
+	entry->index = index;
+	entry->length = dlen;
+	entry->data = data;
+
+	spin_lock_irqsave(&zcache_lock, flags);
+	if (!test_bit(pool, zcache_pools_used)) {
+		/* The filesystem went away meanwhile */
+		spin_unlock_irqrestore(&zcache_lock, flags);
+		zcache_entry_free(entry);
+		return;
+	}
+	zcache_evict(ksize(data), &freelist);
+	while (zcache_rb_insert(&zcache_pools[pool], entry, &dupentry)) {
+		zcache_entry_erase(dupentry);
+		list_add(&dupentry->lru, &freelist);
+	}
+	list_add(&entry->lru, &zcache_lru);
+	zcache_pool_total_size += ksize(data);
+	zcache_stored_pages++;
+	spin_unlock_irqrestore(&zcache_lock, flags);
+
+	zcache_free_list(&freelist);
+	return;
+
+reject:
+	kmem_cache_free(zcache_entry_cache, entry);
+invalidate:
+	/* An older copy of the page must not survive a failed store */
+	spin_lock_irqsave(&zcache_lock, flags);
+	dupentry = zcache_rb_search(&zcache_pools[pool], &key, index);
+	if (dupentry)
+		zcache_entry_erase(dupentry);
+	spin_unlock_irqrestore(&zcache_lock, flags);
+	if (dupentry)
+		zcache_entry_free(dupentry);
+}
+
+/*
+ * Reads are exclusive: the page goes back into the page cache, and is
+ * stored again the next time it is evicted.
+ */
+static int zcache_get_page(int pool, struct cleancache_filekey key,
+			   pgoff_t index, struct page *page)
+{
+	struct zcache_entry *entry = NULL;
+	unsigned long flags;
+	size_t dlen = PAGE_SIZE;
+	u8 *dst;
+	int ret;
+
+	if (pool < 0 || pool >= ZCACHE_MAX_POOLS)
+		return -1;
+
+	spin_lock_irqsave(&zcache_lock, flags);
+	if (test_bit(pool, zcache_pools_used)) {
+		entry = zcache_rb_search(&zcache_pools[pool], &key, index);
+		if (entry)
+			zcache_entry_erase(entry);
+	}
+	spin_unlock_irqrestore(&zcache_lock, flags);
+
+	if (!entry) {
+		zcache_failed_gets++;
+		return -1;
+	}
+
+	dst = kmap_atomic(page, KM_USER0);
+	ret = lzo1x_decompress_safe(entry->data, entry->length, dst, &dlen);
+	kunmap_atomic(dst, KM_USER0);
+	BUG_ON(ret != LZO_E_OK || dlen != PAGE_SIZE);
+	flush_dcache_page(page);
+
+	zcache_entry_free(entry);
+	zcache_succ_gets++;
+	return 0;
+}
+
+static void zcache_invalidate_page(int pool, struct cleancache_filekey key,
+				   pgoff_t index)
+{
+	struct zcache_entry *entry = NULL;
+	unsigned long flags;
+
+	if (pool < 0 || pool >= ZCACHE_MAX_POOLS)
+		return;
+
+	spin_lock_irqsave(&zcache_lock, flags);
+	if (test_bit(pool, zcache_pools_used)) {
+		entry = zcache_rb_search(&zcache_pools[pool], &key, index);
+		if (entry)
+			zcache_entry_erase(entry);
+	}
+	spin_unlock_irqrestore(&zcache_lock, flags);
+
+	if (entry)
+		zcache_entry_free(entry);
+}
+
+static void zcache_invalidate_inode(int pool, struct cleancache_filekey key)
+{
+	struct zcache_entry *entry, *next;
+	struct rb_node *node;
+	unsigned long flags;
+	LIST_HEAD(freelist);
+
+	if (pool < 0 || pool >= ZCACHE_MAX_POOLS)
+		return;
+
+	spin_lock_irqsave(&zcache_lock, flags);
+	if (test_bit(pool, zcache_pools_used)) {
+		entry = zcache_rb_first_of(&zcache_pools[pool], &key);
+		while (entry) {
+			node = rb_next(&entry->rbnode);
+			next = node ? rb_entry(node, struct zcache_entry,
+					       rbnode) : NULL;
+			if (next && memcmp(&key, &next->key, sizeof(key)))
+				next = NULL;
+			zcache_entry_erase(entry);
+			list_add(&entry->lru, &freelist);
+			entry = next;
+		}
+	}
+	spin_unlock_irqrestore(&zcache_lock, flags);
+
+	zcache_free_list(&freelist);
+}
+
+static void zcache_invalidate_fs(int pool)
+{
+	struct zcache_entry *entry;
+	struct rb_node *node;
+	unsigned long flags;
+	LIST_HEAD(freelist);
+
+	if (pool < 0 || pool >= ZCACHE_MAX_POOLS)
+		return;
+
+	spin_lock_irqsave(&zcache_lock, flags);
+	while ((node = rb_first(&zcache_pools[pool])) != NULL) {
+		entry = rb_entry(node, struct zcache_entry, rbnode);
+		zcache_entry_erase(entry);
+		list_add(&entry->lru, &freelist);
+	}
+	clear_bit(pool, zcache_pools_used);
+	spin_unlock_irqrestore(&zcache_lock, flags);
+
+	zcache_free_list(&freelist);
+}
+
+static int zcache_init_fs(size_t pagesize)
+{
+	unsigned long flags;
+	int pool;
+
+	if (pagesize != PAGE_SIZE)
+		return -1;
+
+	spin_lock_irqsave(&zcache_lock, flags);
+	pool = find_first_zero_bit(zcache_pools_used, ZCACHE_MAX_POOLS);
+	if (pool < ZCACHE_MAX_POOLS) {
+		zcache_pools[pool] = RB_ROOT;
+		set_bit(pool, zcache_pools_used);
+	} else
+		pool = -1;
+	spin_unlock_irqrestore(&zcache_lock, flags);
+
+	return pool;
+}
+
+static struct cleancache_ops zcache_cleancache_ops = {
+	.init_fs		= zcache_init_fs,
+	.get_page		= zcache_get_page,
+	.put_page		= zcache_put_page,
+	.invalidate_page	= zcache_invalidate_page,
+	.invalidate_inode	= zcache_invalidate_inode,
+	.invalidate_fs		= zcache_invalidate_fs,
+};
+
+/*********************************
+* per-cpu buffers
+**********************************/
+static int __zcache_cpu_notifier(unsigned long action, unsigned long cpu)
+{
+	void *wrkmem;
+	u8 *dst;
+
+	switch (action) {
+	case CPU_UP_PREPARE:
+	case CPU_UP_PREPARE_FROZEN:
+		wrkmem = kmalloc_node(LZO1X_MEM_COMPRESS, GFP_KERNEL,
+				      cpu_to_node(cpu));
+		/* LZO may expand incompressible data a little */
+		dst = kmalloc_node(PAGE_SIZE * 2, GFP_KERNEL,
+				   cpu_to_node(cpu));
+		if (!wrkmem || !dst) {
+			kfree(wrkmem);
+			kfree(dst);
+			return NOTIFY_BAD;
+		}
+		per_cpu(zcache_wrkmem, cpu) = wrkmem;
+		per_cpu(zcache_dstmem, cpu) = dst;
+		break;
+	case CPU_DEAD:
+	case CPU_DEAD_FROZEN:
+	case CPU_UP_CANCELED:
+	case CPU_UP_CANCELED_FROZEN:
+		kfree(per_cpu(zcache_wrkmem, cpu));
+		per_cpu(zcache_wrkmem, cpu) = NULL;
+		kfree(per_cpu(zcache_dstmem, cpu));
+		per_cpu(zcache_dstmem, cpu) = NULL;
+		break;
+	}
+	return NOTIFY_OK;
+}
+
+static int zcache_cpu_notifier(struct notifier_block *nb,
+			       unsigned long action, void *pcpu)
+{
+	return __zcache_cpu_notifier(action, (unsigned long)pcpu);
+}
+
+static struct notifier_block zcache_cpu_notifier_block = {
+	.notifier_call = zcache_cpu_notifier
+};
+
+static int __init zcache_cpu_init(void)
+{
+	unsigned long cpu;
+
+	get_online_cpus();
+	for_each_online_cpu(cpu)
+		if (__zcache_cpu_notifier(CPU_UP_PREPARE, cpu) != NOTIFY_OK)
+			goto cleanup;
+	register_cpu_notifier(&zcache_cpu_notifier_block);
+	put_online_cpus();
+	return 0;
+
+cleanup:
+	for_each_online_cpu(cpu)
+		__zcache_cpu_notifier(CPU_UP_CANCELED, cpu);
+	put_online_cpus();
+	return -ENOMEM;
+}
+
+/*********************************
+* debugfs
+**********************************/
+#ifdef CONFIG_DEBUG_FS
+static int __init zcache_debugfs_init(void)
+{
+	struct dentry *root = debugfs_create_dir("zcache", NULL);
+
+	if (!root)
+		return -ENOMEM;
+
+	debugfs_create_u64("evicted_pages", S_IRUGO, root,
+			   &zcache_evicted_pages);
+	debugfs_create_u64("succ_gets", S_IRUGO, root, &zcache_succ_gets);
+	debugfs_create_u64("failed_gets", S_IRUGO, root,
+			   &zcache_failed_gets);
+	debugfs_create_u64("reject_compress_poor", S_IRUGO, root,
+			   &zcache_reject_compress_poor);
+	debugfs_create_u64("reject_alloc_fail", S_IRUGO, root,
+			   &zcache_reject_alloc_fail);
+	debugfs_create_u64("pool_total_size", S_IRUGO, root,
+			   &zcache_pool_total_size);
+	debugfs_create_u64("stored_pages", S_IRUGO, root,
+			   &zcache_stored_pages);
+	return 0;
+}
+#else
+static int __init zcache_debugfs_init(void)
+{
+	return 0;
+}
+#endif
+
+static int __init zcache_init(void)
+{
+	zcache_entry_cache = KMEM_CACHE(zcache_entry, 0);
+	if (!zcache_entry_cache)
+		goto error;
+	if (zcache_cpu_init())
+		goto cachefail;
+
+	cleancache_register_ops(&zcache_cleancache_ops);
+	zcache_debugfs_init();
+	printk(KERN_INFO "zcache: compressed page cache, pool limit %u%% of RAM\n",
+	       zcache_max_pool_percent);
+	return 0;
+
+cachefail:
+	kmem_cache_destroy(zcache_entry_cache);
+error:
+	printk(KERN_ERR "zcache: initialization failed, disabled\n");
+	return -ENOMEM;
+}
+late_initcall(zcache_init);
@@ -0,0 +1,552 @@
+/*
+ *  linux/mm/zswap.c
+ *
+ *  Compressed cache for swap pages.
+ *
+ *  zswap is a frontswap backend: anonymous pages on their way to the swap
+ *  device are LZO compressed into a RAM pool instead, and faulted back in
+ *  from there without any I/O.  The swap slot of each page stays reserved
+ *  on the real swap device, so when the pool reaches its size limit the
+ *  least recently stored pages are decompressed into the swap cache and
+ *  written back to the device to make room.
+ *
+ *  See Documentation/vm/zswap.txt.
+ *
+ *  This work is licensed under the terms of the GNU GPL, version 2.
+ */
+
+#include <linux/module.h>
+#include <linux/cpu.h>
+#include <linux/highmem.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/types.h>
+#include <linux/frontswap.h>
+#include <linux/rbtree.h>
+#include <linux/swap.h>
+#include <linux/swapops.h>
+#include <linux/writeback.h>
+#include <linux/pagemap.h>
+#include <linux/lzo.h>
+#include <linux/debugfs.h>
+
+/*
+ * Pages that compress to more than this are rejected and go to the swap
+ * device: the compressed copies live in kmalloc() objects, and anything
+ * bigger would not save memory once rounded up to a size class.
+ */
+#define ZSWAP_MAX_STORED_SIZE	(PAGE_SIZE / 2)
+
+/* How many entries a full pool writes back before giving up on a store */
+#define ZSWAP_WRITEBACK_BATCH	16
+
+/*
+ * The pool is allocated from in the swap writeout path, so never wait,
+ * never retry and never touch the emergency reserves the I/O needs.
+ */
+#define ZSWAP_GFP	(__GFP_NORETRY | __GFP_NOWARN | __GFP_NOMEMALLOC)
+
+/* Enable/disable storing new pages, pages already stored are kept */
+static int zswap_enabled __read_mostly = 1;
+module_param_named(enabled, zswap_enabled, bool, 0644);
+
+/* Maximum size of the pool, in percent of RAM */
+static unsigned int zswap_max_pool_percent = 20;
+module_param_named(max_pool_percent, zswap_max_pool_percent, uint, 0644);
+
+/*
+ * Statistics, reported in debugfs.  Only the pool size and stored page
+ * count are exact, the others are updated without locking.
+ */
+static u64 zswap_pool_total_size;	/* bytes of compressed data */
+static u64 zswap_stored_pages;
+static u64 zswap_pool_limit_hit;
+static u64 zswap_written_back_pages;
+static u64 zswap_reject_compress_poor;
+static u64 zswap_reject_alloc_fail;
+static u64 zswap_duplicate_entry;
+
+/*
+ * One compressed page.  An entry is referenced by the tree while it is
+ * in it and by writeback while that works on it; it is freed with the
+ * last reference.
+ */
+struct zswap_entry {
+	struct rb_node rbnode;
+	struct list_head lru;
+	unsigned type;
+	pgoff_t offset;
+	int refcount;
+	unsigned int length;
+	void *data;
+};
+
+static struct kmem_cache *zswap_entry_cache;
+
+/*
+ * zswap_lock protects the trees of all swap types, the LRU list, the
+ * entry reference counts and the exact statistics.  Compression and
+ * decompression are done outside of it.
+ */
+static DEFINE_SPINLOCK(zswap_lock);
+static struct rb_root zswap_trees[MAX_SWAPFILES];
+static LIST_HEAD(zswap_lru);		/* most recently stored first */
+
+/* Per-cpu LZO work memory and destination buffer */
+static DEFINE_PER_CPU(void *, zswap_wrkmem);
+static DEFINE_PER_CPU(u8 *, zswap_dstmem);
+
+static bool zswap_is_full(void)
+{
+	return zswap_pool_total_size >
+		((u64)totalram_pages * zswap_max_pool_percent / 100)
+			<< PAGE_SHIFT;
+}
+
+/*********************************
+* entries and the tree
+**********************************/
+static struct zswap_entry *zswap_rb_search(struct rb_root *root,
+					   pgoff_t offset)
+{
+	struct rb_node *node = root->rb_node;
+	struct zswap_entry *entry;
+
+	while (node) {
+		entry = rb_entry(node, struct zswap_entry, rbnode);
+		if (offset < entry->offset)
+			node = node->rb_left;
+		else if (offset > entry->offset)
+			node = node->rb_right;
+		else
+			return entry;
+	}
+	return NULL;
+}
+
+/*
+ * Insert @entry into @root, or return -EEXIST with the entry already
+ * there for the same offset in *@dupentry.
+ */
+static int zswap_rb_insert(struct rb_root *root, struct zswap_entry *entry,
+			   struct zswap_entry **dupentry)
+{
+	struct rb_node **link = &root->rb_node, *parent = NULL;
+	struct zswap_entry *myentry;
+
+	while (*link) {
+		parent = *link;
+		myentry = rb_entry(parent, struct zswap_entry, rbnode);
+		if (entry->offset < myentry->offset)
+			link = &parent->rb_left;
+		else if (entry->offset > myentry->offset)
+			link = &parent->rb_right;
+		else {
+			*dupentry = myentry;
+			return -EEXIST;
+		}
+	}
+	rb_link_node(&entry->rbnode, parent, link);
+	rb_insert_color(&entry->rbnode, root);
+	return 0;
+}
+
+static void zswap_entry_free(struct zswap_entry *entry)
+{
+	zswap_pool_total_size -= ksize(entry->data);
+	zswap_stored_pages--;
+	kfree(entry->data);
+	kmem_cache_free(zswap_entry_cache, entry);
+}
+
+/* Called with zswap_lock held */
+static void zswap_entry_put(struct zswap_entry *entry)
+{
+	BUG_ON(entry->refcount <= 0);
+	if (--entry->refcount == 0)
+		zswap_entry_free(entry);
+}
+
+/* Drop @entry from its tree and the LRU. Called with zswap_lock held */
+static void zswap_entry_erase(struct zswap_entry *entry)
+{
+	rb_erase(&entry->rbnode, &zswap_trees[entry->type]);
+	RB_CLEAR_NODE(&entry->rbnode);
+	list_del_init(&entry->lru);
+	zswap_entry_put(entry);
+}
+
+/*********************************
+* compression
+**********************************/
+static int zswap_compress(struct page *page, u8 *dst, size_t *dlen,
+			  void *wrkmem)
+{
+	u8 *src;
+	int ret;
+
+	src = kmap_atomic(page, KM_USER0);
+	ret = lzo1x_1_compress(src, PAGE_SIZE, dst, dlen, wrkmem);
+	kunmap_atomic(src, KM_USER0);
+
+	return ret == LZO_E_OK ? 0 : -EINVAL;
+}
+
+static void zswap_decompress(struct zswap_entry *entry, struct page *page)
+{
+	size_t dlen = PAGE_SIZE;
+	u8 *dst;
+	int ret;
+
+	dst = kmap_atomic(page, KM_USER0);
+	ret = lzo1x_decompress_safe(entry->data, entry->length, dst, &dlen);
+	kunmap_atomic(dst, KM_USER0);
+
+	BUG_ON(ret != LZO_E_OK || dlen != PAGE_SIZE);
+}
+
+/*********************************
+* writeback
+**********************************/
+/*
+ * Write the least recently stored entry back to the swap device, by
+ * decompressing it into a new swap cache page and submitting that for
+ * write.  Returns 0 if an entry left the pool.
+ */
+static int zswap_writeback_entry(void)
+{
+	struct writeback_control wbc = {
+		.sync_mode = WB_SYNC_NONE,
+	};
+	struct zswap_entry *entry;
+	struct page *page;
+	bool new_page;
+	int ret = 0;
+
+	spin_lock(&zswap_lock);
+	if (list_empty(&zswap_lru)) {
+		spin_unlock(&zswap_lock);
+		return -ENOENT;
+	}
+	entry = list_entry(zswap_lru.prev, struct zswap_entry, lru);
+	/* If this one cannot be written back, the next call tries another */
+	list_move(&entry->lru, &zswap_lru);
+	entry->refcount++;
+	spin_unlock(&zswap_lock);
+
+	page = __read_swap_cache_async(swp_entry(entry->type, entry->offset),
+				       GFP_NOIO, NULL, 0, &new_page);
+	if (!page) {
+		/* Out of memory, or the swap slot was just freed */
+		ret = -ENOMEM;
+		goto out;
+	}
+	if (!new_page) {
+		/*
+		 * The page is already in the swap cache: it is being swapped
+		 * in or out right now and will take care of this entry.
+		 */
+		page_cache_release(page);
+		ret = -EEXIST;
+		goto out;
+	}
+
+	/*
+	 * The slot may have been freed and used again before the swap
+	 * cache page was added: then this entry's data no longer belongs
+	 * there.  Now the page holds the slot, it cannot change anymore.
+	 */
+	spin_lock(&zswap_lock);
+	if (zswap_rb_search(&zswap_trees[entry->type],
+			    entry->offset) != entry) {
+		spin_unlock(&zswap_lock);
+		delete_from_swap_cache(page);
+		unlock_page(page);
+		page_cache_release(page);
+		ret = -ENOENT;
+		goto out;
+	}
+	spin_unlock(&zswap_lock);
+
+	zswap_decompress(entry, page);
+	SetPageUptodate(page);
+
+	/* Move it to the tail of the inactive list once written */
+	SetPageReclaim(page);
+	__swap_writepage(page, &wbc);
+	page_cache_release(page);
+	zswap_written_back_pages++;
+
+	spin_lock(&zswap_lock);
+	/*
+	 * The slot may have been freed or stored again meanwhile, so only
+	 * drop the entry from the tree if it is still the one there.
+	 */
+	if (zswap_rb_search(&zswap_trees[entry->type], entry->offset) == entry)
+		zswap_entry_erase(entry);
+	zswap_entry_put(entry);
+	spin_unlock(&zswap_lock);
+	return 0;
+
+out:
+	spin_lock(&zswap_lock);
+	zswap_entry_put(entry);
+	spin_unlock(&zswap_lock);
+	return ret;
+}
+
+/*********************************
+* frontswap hooks
+**********************************/
+static int zswap_frontswap_store(unsigned type, pgoff_t offset,
+				 struct page *page)
+{
+	struct zswap_entry *entry, *dupentry;
+	size_t dlen;
+	void *data;
+	u8 *dst;
+	int i, ret;
+
+	if (!zswap_enabled)
+		return -1;
+
+	if (zswap_is_full()) {
+		zswap_pool_limit_hit++;
+		for (i = 0; i < ZSWAP_WRITEBACK_BATCH && zswap_is_full(); i++)
+			zswap_writeback_entry();
+		if (zswap_is_full())
+			return -1;
+	}
+
+	entry = kmem_cache_alloc(zswap_entry_cache, ZSWAP_GFP);
+	if (!entry) {
+		zswap_reject_alloc_fail++;
+		return -1;
+	}
+
+	dst = get_cpu_var(zswap_dstmem);
+	ret = zswap_compress(page, dst, &dlen,
+			     __get_cpu_var(zswap_wrkmem));
+	if (ret || dlen > ZSWAP_MAX_STORED_SIZE) {
+		put_cpu_var(zswap_dstmem);
+		zswap_reject_compress_poor++;
+		goto reject;
+	}
+	data = kmalloc(dlen, ZSWAP_GFP);
+	if (!data) {
+		put_cpu_var(zswap_dstmem);
+		zswap_reject_alloc_fail++;
+		goto reject;
+	}
+	memcpy(data, dst, dlen);
+	put_cpu_var(zswap_dstmem);
+
+	entry->type = type;
+	entry->offset = offset;
+	entry->refcount = 1;
+	entry->length = dlen;
+	entry->data = data;
+
+	spin_lock(&zswap_lock);
+	while (zswap_rb_insert(&zswap_trees[type], entry, &dupentry)) {
+		/* The page was stored before and dirtied since */
+		zswap_duplicate_entry++;
+		zswap_entry_erase(dupentry);
+	}
+	list_add(&entry->lru, &zswap_lru);
+	zswap_pool_total_size += ksize(data);
+	zswap_stored_pages++;
+	spin_unlock(&zswap_lock);
+
+	return 0;
+
+reject:
+	kmem_cache_free(zswap_entry_cache, entry);
+	return -1;
+}
+
+static int zswap_frontswap_load(unsigned type, pgoff_t offset,
+				struct page *page)
+{
+	struct zswap_entry *entry;
+
+	spin_lock(&zswap_lock);
+	entry = zswap_rb_search(&zswap_trees[type], offset);
+	if (!entry) {
+		/* Never stored, or written back to the swap device */
+		spin_unlock(&zswap_lock);
+		return -1;
+	}
+	entry->refcount++;
+	spin_unlock(&zswap_lock);
+
+	/*
+	 * The entry stays in the pool: the page is clean in the swap cache
+	 * now, and reclaim may drop it again without writing it.
+	 */
+	zswap_decompress(entry, page);
+
+	spin_lock(&zswap_lock);
+	zswap_entry_put(entry);
+	spin_unlock(&zswap_lock);
+
+	return 0;
+}
+
+static void zswap_frontswap_invalidate_page(unsigned type, pgoff_t offset)
+{
+	struct zswap_entry *entry;
+
+	spin_lock(&zswap_lock);
+	entry = zswap_rb_search(&zswap_trees[type], offset);
+	if (entry)
+		zswap_entry_erase(entry);
+	spin_unlock(&zswap_lock);
+}
+
+static void zswap_frontswap_invalidate_area(unsigned type)
+{
+	struct rb_node *node;
+
+	spin_lock(&zswap_lock);
+	while ((node = rb_first(&zswap_trees[type])) != NULL)
+		zswap_entry_erase(rb_entry(node, struct zswap_entry, rbnode));
+	spin_unlock(&zswap_lock);
+}
+
+static void zswap_frontswap_init(unsigned type)
+{
+	spin_lock(&zswap_lock);
+	zswap_trees[type] = RB_ROOT;
+	spin_unlock(&zswap_lock);
+}
+
+static struct frontswap_ops zswap_frontswap_ops = {
+	.init			= zswap_frontswap_init,
+	.store			= zswap_frontswap_store,
+	.load			= zswap_frontswap_load,
+	.invalidate_page	= zswap_frontswap_invalidate_page,
+	.invalidate_area	= zswap_frontswap_invalidate_area,
+};
+
+/*********************************
+* per-cpu buffers
+**********************************/
+static int __zswap_cpu_notifier(unsigned long action, unsigned long cpu)
+{
+	void *wrkmem;
+	u8 *dst;
+
+	switch (action) {
+	case CPU_UP_PREPARE:
+	case CPU_UP_PREPARE_FROZEN:
+		wrkmem = kmalloc_node(LZO1X_MEM_COMPRESS, GFP_KERNEL,
+				      cpu_to_node(cpu));
+		/* LZO may expand incompressible data a little */
+		dst = kmalloc_node(PAGE_SIZE * 2, GFP_KERNEL,
+				   cpu_to_node(cpu));
+		if (!wrkmem || !dst) {
+			kfree(wrkmem);
+			kfree(dst);
+			return NOTIFY_BAD;
+		}
+		per_cpu(zswap_wrkmem, cpu) = wrkmem;
+		per_cpu(zswap_dstmem, cpu) = dst;
+		break;
+	case CPU_DEAD:
+	case CPU_DEAD_FROZEN:
+	case CPU_UP_CANCELED:
+	case CPU_UP_CANCELED_FROZEN:
+		kfree(per_cpu(zswap_wrkmem, cpu));
+		per_cpu(zswap_wrkmem, cpu) = NULL;
+		kfree(per_cpu(zswap_dstmem, cpu));
+		per_cpu(zswap_dstmem, cpu) = NULL;
+		break;
+	}
+	return NOTIFY_OK;
+}
+
+static int zswap_cpu_notifier(struct notifier_block *nb,
+			      unsigned long action, void *pcpu)
+{
+	return __zswap_cpu_notifier(action, (unsigned long)pcpu);
+}
+
+static struct notifier_block zswap_cpu_notifier_block = {
+	.notifier_call = zswap_cpu_notifier
+};
+
+static int __init zswap_cpu_init(void)
+{
+	unsigned long cpu;
+
+	get_online_cpus();
+	for_each_online_cpu(cpu)
+		if (__zswap_cpu_notifier(CPU_UP_PREPARE, cpu) != NOTIFY_OK)
+			goto cleanup;
+	register_cpu_notifier(&zswap_cpu_notifier_block);
+	put_online_cpus();
+	return 0;
+
+cleanup:
+	for_each_online_cpu(cpu)
+		__zswap_cpu_notifier(CPU_UP_CANCELED, cpu);
+	put_online_cpus();
+	return -ENOMEM;
+}
+
+/*********************************
+* debugfs
+**********************************/
+#ifdef CONFIG_DEBUG_FS
+static int __init zswap_debugfs_init(void)
+{
+	struct dentry *root = debugfs_create_dir("zswap", NULL);
+
+	if (!root)
+		return -ENOMEM;
+
+	debugfs_create_u64("pool_limit_hit", S_IRUGO, root,
+			   &zswap_pool_limit_hit);
+	debugfs_create_u64("reject_compress_poor", S_IRUGO, root,
+			   &zswap_reject_compress_poor);
+	debugfs_create_u64("reject_alloc_fail", S_IRUGO, root,
+			   &zswap_reject_alloc_fail);
+	debugfs_create_u64("written_back_pages", S_IRUGO, root,
+			   &zswap_written_back_pages);
+	debugfs_create_u64("duplicate_entry", S_IRUGO, root,
+			   &zswap_duplicate_entry);
+	debugfs_create_u64("pool_total_size", S_IRUGO, root,
+			   &zswap_pool_total_size);
+	debugfs_create_u64("stored_pages", S_IRUGO, root,
+			   &zswap_stored_pages);
+	return 0;
+}
+#else
+static int __init zswap_debugfs_init(void)
+{
+	return 0;
+}
+#endif
+
+static int __init zswap_init(void)
+{
+	zswap_entry_cache = KMEM_CACHE(zswap_entry, 0);
+	if (!zswap_entry_cache)
+		goto error;
+	if (zswap_cpu_init())
+		goto cachefail;
+
+	frontswap_register_ops(&zswap_frontswap_ops);
+	zswap_debugfs_init();
+	printk(KERN_INFO "zswap: compressed swap cache, pool limit %u%% of RAM\n",
+	       zswap_max_pool_percent);
+	return 0;
+
+cachefail:
+	kmem_cache_destroy(zswap_entry_cache);
+error:
+	printk(KERN_ERR "zswap: initialization failed, disabled\n");
+	return -ENOMEM;
+}
+late_initcall(zswap_init);
@@ -18,6 +18,7 @@
 #include <linux/vmalloc.h>
 
 #include <net/request_sock.h>
+#include <net/tcp.h>
 
 /*
  * Maximum number of SYN_RECV sockets in queue per LISTEN socket.
@@ -129,3 +130,34 @@ void reqsk_queue_destroy(struct request_sock_queue *queue)
 		kfree(lopt);
 }
 
+
+/*
+ * Called once a TCP Fast Open child no longer needs its request_sock,
+ * i.e. when the 3WHS has either completed or been aborted.
+ *
+ * Without Fast Open a child socket is only created after the 3WHS, so it
+ * never looks at its request_sock. A Fast Open child is created on the
+ * SYN and keeps using the req, e.g. to retransmit the SYN-ACK, whether it
+ * has been accepted or not. If inet_csk_accept() already took the child
+ * (req->sk == NULL), the req is ours to free; otherwise accept() frees it
+ * once it sees the listener pointer cleared.
+ */
+void reqsk_fastopen_remove(struct sock *sk, struct request_sock *req)
+{
+	struct sock *lsk = tcp_rsk(req)->listener;
+	struct fastopen_queue *fastopenq =
+	    inet_csk(lsk)->icsk_accept_queue.fastopenq;
+
+	tcp_sk(sk)->fastopen_rsk = NULL;
+
+	spin_lock_bh(&fastopenq->lock);
+	fastopenq->qlen--;
+	tcp_rsk(req)->listener = NULL;
+	if (req->sk)	/* the child socket hasn't been accepted yet */
+		req = NULL;
+	spin_unlock_bh(&fastopenq->lock);
+
+	sock_put(lsk);
+	if (req)
+		reqsk_free(req);
+}
@@ -15,6 +15,8 @@
 #include <linux/init.h>
 #include <linux/slab.h>
 
+#include <linux/filter.h>
+
 #include <net/ip.h>
 #include <net/sock.h>
 
@@ -150,6 +152,15 @@ static struct ctl_table net_core_table[] = {
 		.mode		= 0644,
 		.proc_handler	= proc_dointvec
 	},
+#ifdef CONFIG_BPF_JIT
+	{
+		.procname	= "bpf_jit_enable",
+		.data		= &bpf_jit_enable,
+		.maxlen		= sizeof(int),
+		.mode		= 0644,
+		.proc_handler	= proc_dointvec
+	},
+#endif
 #ifdef CONFIG_RPS
 	{
 		.procname	= "rps_sock_flow_entries",
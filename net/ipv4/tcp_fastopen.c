@@ -0,0 +1,137 @@
+/*
+ * TCP Fast Open: carry data in the SYN of repeat connections.
+ *
+ * The server hands out a cookie, a MAC of the client's address keyed with
+ * a boot-time secret, in the SYN-ACK of a connection that asked for one.
+ * A client that presents a valid cookie in a later SYN gets the data in
+ * that SYN delivered to the listener right away, before the 3WHS ends.
+ * Clients remember the cookie of each server in the inetpeer cache.
+ *
+ *	This program is free software; you can redistribute it and/or
+ *	modify it under the terms of the GNU General Public License
+ *	as published by the Free Software Foundation; either version
+ *	2 of the License, or (at your option) any later version.
+ */
+
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/slab.h>
+#include <linux/random.h>
+#include <linux/cryptohash.h>
+#include <linux/seqlock.h>
+#include <linux/tcp.h>
+#include <net/inetpeer.h>
+#include <net/tcp.h>
+#if defined(CONFIG_IPV6) || defined(CONFIG_IPV6_MODULE)
+#include <net/ipv6.h>
+#endif
+
+int sysctl_tcp_fastopen __read_mostly;
+
+static __u32 fastopen_secret[16 - 1 + SHA_DIGEST_WORDS] __read_mostly;
+
+static DEFINE_PER_CPU(__u32 [16 + SHA_DIGEST_WORDS + SHA_WORKSPACE_WORDS],
+		      fastopen_cookie_scratch);
+
+/* Protects the Fast Open fields of struct inet_peer */
+static DEFINE_SEQLOCK(fastopen_seqlock);
+
+static int __init tcp_fastopen_init(void)
+{
+	get_random_bytes(fastopen_secret, sizeof(fastopen_secret));
+	return 0;
+}
+late_initcall(tcp_fastopen_init);
+
+/* Computes the Fast Open cookie of a client address. Called from BH
+ * context only (tcp_v4_conn_request()).
+ */
+void tcp_fastopen_cookie_gen(__be32 addr, struct tcp_fastopen_cookie *foc)
+{
+	__u32 *tmp = __get_cpu_var(fastopen_cookie_scratch);
+
+	memcpy(tmp + 1, fastopen_secret, sizeof(fastopen_secret));
+	tmp[0] = (__force u32)addr;
+	sha_transform(tmp + 16, (__u8 *)tmp, tmp + 16 + SHA_DIGEST_WORDS);
+
+	memcpy(foc->val, tmp + 16, TCP_FASTOPEN_COOKIE_SIZE);
+	foc->len = TCP_FASTOPEN_COOKIE_SIZE;
+}
+
+/* Allows up to @backlog children of the listener @sk to be pending in
+ * TCP_SYN_RECV with data from the SYN. 0 disables Fast Open again.
+ */
+int tcp_fastopen_init_queue(struct sock *sk, int backlog)
+{
+	struct request_sock_queue *queue = &inet_csk(sk)->icsk_accept_queue;
+
+	if (queue->fastopenq == NULL) {
+		queue->fastopenq = kzalloc(sizeof(struct fastopen_queue),
+					   sk->sk_allocation);
+		if (queue->fastopenq == NULL)
+			return -ENOMEM;
+		spin_lock_init(&queue->fastopenq->lock);
+	}
+	queue->fastopenq->max_qlen = backlog;
+	return 0;
+}
+
+static struct inet_peer *tcp_fastopen_get_peer(struct sock *sk)
+{
+#if defined(CONFIG_IPV6) || defined(CONFIG_IPV6_MODULE)
+	if (sk->sk_family == AF_INET6)
+		return inet_getpeer_v6(&inet6_sk(sk)->daddr, 1);
+#endif
+	return inet_getpeer_v4(inet_sk(sk)->inet_daddr, 1);
+}
+
+/* Fetches the cookie, MSS and SYN loss history cached for the peer of
+ * the connecting socket @sk. Outputs are left alone if there is none.
+ */
+void tcp_fastopen_cache_get(struct sock *sk, u16 *mss,
+			    struct tcp_fastopen_cookie *cookie,
+			    int *syn_loss, unsigned long *last_syn_loss)
+{
+	struct inet_peer *peer = tcp_fastopen_get_peer(sk);
+	unsigned int seq;
+
+	if (!peer)
+		return;
+
+	do {
+		seq = read_seqbegin(&fastopen_seqlock);
+		if (peer->tcp_fastopen_mss)
+			*mss = peer->tcp_fastopen_mss;
+		*cookie = peer->tcp_fastopen_cookie;
+		*syn_loss = peer->tcp_fastopen_syn_loss;
+		*last_syn_loss = *syn_loss ? peer->tcp_fastopen_syn_loss_ts : 0;
+	} while (read_seqretry(&fastopen_seqlock, seq));
+
+	inet_putpeer(peer);
+}
+
+/* Records what the SYN-ACK told us about Fast Open on this peer. A
+ * @syn_lost Fast Open SYN counts against the peer, so that a path that
+ * drops SYNs with data makes us back off to regular handshakes.
+ */
+void tcp_fastopen_cache_set(struct sock *sk, u16 mss,
+			    struct tcp_fastopen_cookie *cookie, bool syn_lost)
+{
+	struct inet_peer *peer = tcp_fastopen_get_peer(sk);
+
+	if (!peer)
+		return;
+
+	write_seqlock_bh(&fastopen_seqlock);
+	peer->tcp_fastopen_mss = mss;
+	if (cookie->len > 0)
+		peer->tcp_fastopen_cookie = *cookie;
+	if (syn_lost) {
+		++peer->tcp_fastopen_syn_loss;
+		peer->tcp_fastopen_syn_loss_ts = jiffies;
+	} else
+		peer->tcp_fastopen_syn_loss = 0;
+	write_sequnlock_bh(&fastopen_seqlock);
+
+	inet_putpeer(peer);
+}
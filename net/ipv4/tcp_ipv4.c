@@ -756,7 +756,8 @@ static void tcp_v4_reqsk_send_ack(struct sock *sk, struct sk_buff *skb,
  */
 static int tcp_v4_send_synack(struct sock *sk, struct dst_entry *dst,
 			      struct request_sock *req,
-			      struct request_values *rvp)
+			      struct request_values *rvp,
+			      struct tcp_fastopen_cookie *foc)
 {
 	const struct inet_request_sock *ireq = inet_rsk(req);
 	int err = -1;
@@ -766,7 +767,7 @@ static int tcp_v4_send_synack(struct sock *sk, struct dst_entry *dst,
 	if (!dst && (dst = inet_csk_route_req(sk, req)) == NULL)
 		return -1;
 
-	skb = tcp_make_synack(sk, dst, req, rvp);
+	skb = tcp_make_synack(sk, dst, req, rvp, foc);
 
 	if (skb) {
 		__tcp_v4_send_check(skb, ireq->loc_addr, ireq->rmt_addr);
@@ -785,7 +786,7 @@ static int tcp_v4_rtx_synack(struct sock *sk, struct request_sock *req,
 			      struct request_values *rvp)
 {
 	TCP_INC_STATS_BH(sock_net(sk), TCP_MIB_RETRANSSEGS);
-	return tcp_v4_send_synack(sk, NULL, req, rvp);
+	return tcp_v4_send_synack(sk, NULL, req, rvp, NULL);
 }
 
 /*
@@ -1210,6 +1211,125 @@ static const struct tcp_request_sock_ops tcp_request_sock_ipv4_ops = {
 };
 #endif
 
+/*
+ * Decide whether the SYN @skb may open a Fast Open connection. Fills in
+ * @valid_foc with the cookie to hand out in the SYN-ACK whenever the client
+ * asked for Fast Open but cannot use it right now.
+ */
+static bool tcp_fastopen_check(struct sock *sk, struct sk_buff *skb,
+			       struct request_sock *req,
+			       struct tcp_fastopen_cookie *foc,
+			       struct tcp_fastopen_cookie *valid_foc)
+{
+	struct fastopen_queue *fastopenq =
+		inet_csk(sk)->icsk_accept_queue.fastopenq;
+
+	if (foc->len < 0)
+		return false;
+
+	if (!(sysctl_tcp_fastopen & TFO_SERVER_ENABLE) ||
+	    fastopenq == NULL || fastopenq->max_qlen == 0)
+		return false;
+
+	tcp_fastopen_cookie_gen(ip_hdr(skb)->saddr, valid_foc);
+
+	if (foc->len == 0) {
+		NET_INC_STATS_BH(sock_net(sk), LINUX_MIB_TCPFASTOPENCOOKIEREQD);
+		return false;
+	}
+
+	if (foc->len != valid_foc->len ||
+	    memcmp(foc->val, valid_foc->val, foc->len) != 0) {
+		NET_INC_STATS_BH(sock_net(sk), LINUX_MIB_TCPFASTOPENPASSIVEFAIL);
+		return false;
+	}
+
+	/* The child does not go through the FIN processing of the 3WHS */
+	if (tcp_hdr(skb)->fin)
+		return false;
+
+	if (fastopenq->qlen >= fastopenq->max_qlen) {
+		NET_INC_STATS_BH(sock_net(sk),
+				 LINUX_MIB_TCPFASTOPENLISTENOVERFLOW);
+		return false;
+	}
+
+	tcp_rsk(req)->rcv_nxt = TCP_SKB_CB(skb)->end_seq;
+	valid_foc->len = -1;
+	NET_INC_STATS_BH(sock_net(sk), LINUX_MIB_TCPFASTOPENPASSIVE);
+	return true;
+}
+
+/*
+ * Create the child of a Fast Open SYN right away and queue it for accept()
+ * together with the data of the SYN. The child keeps the request_sock in
+ * ->fastopen_rsk, retransmits the SYN-ACK from its own timer and drops the
+ * request once the 3WHS completes.
+ */
+static int tcp_v4_conn_req_fastopen(struct sock *sk, struct sk_buff *skb,
+				    struct request_sock *req,
+				    struct dst_entry *dst,
+				    struct request_values *rvp)
+{
+	struct fastopen_queue *fastopenq =
+		inet_csk(sk)->icsk_accept_queue.fastopenq;
+	struct tcp_sock *tp;
+	struct sock *child;
+
+	req->retrans = 0;
+	req->sk = NULL;
+
+	child = inet_csk(sk)->icsk_af_ops->syn_recv_sock(sk, skb, req, dst);
+	if (child == NULL) {
+		NET_INC_STATS_BH(sock_net(sk), LINUX_MIB_TCPFASTOPENPASSIVEFAIL);
+		return -1;
+	}
+
+	/* A lost SYN-ACK is resent from the retransmit timer below */
+	tcp_v4_send_synack(child, NULL, req, rvp, NULL);
+
+	spin_lock(&fastopenq->lock);
+	fastopenq->qlen++;
+	spin_unlock(&fastopenq->lock);
+
+	tp = tcp_sk(child);
+	tp->fastopen_rsk = req;
+	/* The listener must outlive the request until the 3WHS is done,
+	 * see reqsk_fastopen_remove().
+	 */
+	sock_hold(sk);
+	tcp_rsk(req)->listener = sk;
+
+	/* The window of a SYN is never scaled */
+	tp->snd_wnd = ntohs(tcp_hdr(skb)->window);
+
+	inet_csk_reset_xmit_timer(child, ICSK_TIME_RETRANS,
+				  TCP_TIMEOUT_INIT, TCP_RTO_MAX);
+
+	inet_csk_reqsk_queue_add(sk, req, child);
+
+	/* What tcp_rcv_state_process() would do on the final ACK */
+	inet_csk(child)->icsk_af_ops->rebuild_header(child);
+	tcp_init_congestion_control(child);
+	tcp_mtup_init(child);
+	tcp_init_buffer_space(child);
+
+	if (TCP_SKB_CB(skb)->end_seq != TCP_SKB_CB(skb)->seq + 1) {
+		skb = skb_get(skb);
+		skb_dst_drop(skb);
+		__skb_pull(skb, tcp_hdr(skb)->doff * 4);
+		skb_set_owner_r(skb, child);
+		__skb_queue_tail(&child->sk_receive_queue, skb);
+		tp->syn_data_acked = 1;
+	}
+	tp->rcv_nxt = TCP_SKB_CB(skb)->end_seq;
+
+	sk->sk_data_ready(sk, 0);
+	bh_unlock_sock(child);
+	sock_put(child);
+	return 0;
+}
+
 int tcp_v4_conn_request(struct sock *sk, struct sk_buff *skb)
 {
 	struct tcp_extend_values tmp_ext;
@@ -1222,6 +1342,9 @@ int tcp_v4_conn_request(struct sock *sk, struct sk_buff *skb)
 	__be32 saddr = ip_hdr(skb)->saddr;
 	__be32 daddr = ip_hdr(skb)->daddr;
 	__u32 isn = TCP_SKB_CB(skb)->when;
+	struct tcp_fastopen_cookie foc = { .len = -1 };
+	struct tcp_fastopen_cookie valid_foc = { .len = -1 };
+	bool do_fastopen = false;
 #ifdef CONFIG_SYN_COOKIES
 	int want_cookie = 0;
 #else
@@ -1266,7 +1389,8 @@ int tcp_v4_conn_request(struct sock *sk, struct sk_buff *skb)
 	tcp_clear_options(&tmp_opt);
 	tmp_opt.mss_clamp = TCP_MSS_DEFAULT;
 	tmp_opt.user_mss  = tp->rx_opt.user_mss;
-	tcp_parse_options(skb, &tmp_opt, &hash_location, 0);
+	tcp_parse_options(skb, &tmp_opt, &hash_location, 0,
+			  want_cookie ? NULL : &foc);
 
 	if (tmp_opt.cookie_plus > 0 &&
 	    tmp_opt.saw_tstamp &&
@@ -1372,8 +1496,24 @@ int tcp_v4_conn_request(struct sock *sk, struct sk_buff *skb)
 	}
 	tcp_rsk(req)->snt_isn = isn;
 
+	if (!want_cookie)
+		do_fastopen = tcp_fastopen_check(sk, skb, req, &foc, &valid_foc);
+
+	if (do_fastopen) {
+		if (tcp_v4_conn_req_fastopen(sk, skb, req, dst,
+				(struct request_values *)&tmp_ext) == 0)
+			return 0;
+		/* Could not create the child: fall back to the 3WHS, the
+		 * SYN-ACK does not ack the data so the client resends it.
+		 * The failed attempt has consumed dst.
+		 */
+		dst = NULL;
+		tcp_rsk(req)->rcv_nxt = tcp_rsk(req)->rcv_isn + 1;
+	}
+
 	if (tcp_v4_send_synack(sk, dst, req,
-			       (struct request_values *)&tmp_ext) ||
+			       (struct request_values *)&tmp_ext,
+			       &valid_foc) ||
 	    want_cookie)
 		goto drop_and_free;
 
@@ -1737,6 +1877,7 @@ do_time_wait:
 	case TCP_TW_SYN: {
 		struct sock *sk2 = inet_lookup_listener(dev_net(skb->dev),
 							&tcp_hashinfo,
+							iph->saddr, th->source,
 							iph->daddr, th->dest,
 							inet_iif(skb));
 		if (sk2) {
@@ -1937,6 +2078,12 @@ void tcp_v4_destroy_sock(struct sock *sk)
 		tp->cookie_values = NULL;
 	}
 
+	/* A Fast Open child torn down before the 3WHS completed */
+	if (tp->fastopen_rsk != NULL)
+		reqsk_fastopen_remove(sk, tp->fastopen_rsk);
+
+	tcp_free_fastopen_req(tp);
+
 	percpu_counter_dec(&tcp_sockets_allocated);
 }
 EXPORT_SYMBOL(tcp_v4_destroy_sock);